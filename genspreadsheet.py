@@ -12,7 +12,11 @@ infilename = sys.argv[1]
 results = {}
 scanners = set()
 with open( infilename, "r" ) as filein:
-    headers = filein.readline().split(';')
+    # skip the '# key=value' measurement metadata in front of the header
+    line = filein.readline()
+    while line.startswith('#'):
+        line = filein.readline()
+    headers = line.split(';')
     headmap = {}
     for index,name in enumerate(headers):
         match = re.match('(.*\s)*\[ms\]',name)
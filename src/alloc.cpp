@@ -0,0 +1,273 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <atomic>
+#include <mutex>
+#include <new>
+
+#include "main.h"
+
+#define ALLOC_CHUNK         ((size_t)64 << 20)  /* chunks of the arenas and the pool */
+#define ALLOC_HUGE_PAGE     ((size_t)2 << 20)
+#define ALLOC_MAX_CHUNKS    4096
+#define ALLOC_MIN_CLASS     5                   /* 32 bytes including the header */
+#define ALLOC_CLASSES       48
+
+namespace {
+
+/* in front of every block, keeps the 16 byte alignment of malloc */
+struct Header {
+    uint32_t kind;
+    uint32_t size_class;    /* pool only */
+    uint64_t size;
+};
+static_assert(sizeof(Header) == 16, "header breaks the alignment");
+
+struct Chunk {
+    char * base;
+    size_t size;
+    size_t used;            /* bump offset, changed under the lock */
+    int kind;
+};
+
+/*
+ * Chunks are never unmapped and only appended, alloc_free() finds the owner
+ * of a block without the lock. Blocks outside all chunks came from malloc.
+ */
+Chunk chunks[ALLOC_MAX_CHUNKS];
+std::atomic<size_t> chunk_count(0);
+
+std::mutex lock;
+std::atomic<int> selected(ALLOC_SYSTEM);
+size_t live[ALLOC_HUGE + 1];                /* blocks of the arenas */
+Header * free_list[ALLOC_CLASSES];          /* pool, the link is stored in the block */
+
+static const Chunk * owner(const void * ptr)
+{
+    size_t const count = chunk_count.load(std::memory_order_acquire);
+    const char * const p = static_cast<const char *>(ptr);
+
+    for (size_t iter = 0; iter < count; iter++) {
+        if (p >= chunks[iter].base && p < chunks[iter].base + chunks[iter].size) {
+            return &chunks[iter];
+        }
+    }
+    return NULL;
+}
+
+/* huge pages: MAP_HUGETLB if pages are reserved, transparent huge pages otherwise */
+static Chunk * mapChunk(int kind, size_t min_size)
+{
+    size_t const count = chunk_count.load();
+    size_t const page = (kind == ALLOC_HUGE) ? ALLOC_HUGE_PAGE : 4096;
+    size_t size = min_size > ALLOC_CHUNK ? min_size : ALLOC_CHUNK;
+    void * mem = MAP_FAILED;
+    bool hugetlb = false;
+
+    if (count == ALLOC_MAX_CHUNKS) {
+        return NULL;
+    }
+
+    size = (size + page - 1) & ~(page - 1);
+    if (kind == ALLOC_HUGE) {
+        mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        hugetlb = mem != MAP_FAILED;
+    }
+    if (mem == MAP_FAILED) {
+        mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) {
+            return NULL;
+        }
+        if (kind == ALLOC_HUGE) {
+            madvise(mem, size, MADV_HUGEPAGE);
+        }
+    }
+
+    Chunk * const chunk = &chunks[count];
+    chunk->base = static_cast<char *>(mem);
+    chunk->size = size;
+    chunk->used = 0;
+    chunk->kind = hugetlb ? -ALLOC_HUGE : kind;
+    chunk_count.store(count + 1, std::memory_order_release);
+    return chunk;
+}
+
+static int chunkKind(const Chunk * chunk)
+{
+    return chunk->kind < 0 ? -chunk->kind : chunk->kind;
+}
+
+/* first fit over the chunks of the allocator, a new chunk if none has room */
+static Header * bump(int kind, size_t size)
+{
+    size_t const count = chunk_count.load();
+
+    for (size_t iter = 0; iter < count; iter++) {
+        Chunk * const chunk = &chunks[iter];
+        if (chunkKind(chunk) == kind && chunk->size - chunk->used >= size) {
+            Header * const header = reinterpret_cast<Header *>(chunk->base + chunk->used);
+            chunk->used += size;
+            return header;
+        }
+    }
+
+    Chunk * const chunk = mapChunk(kind, size);
+    if (!chunk) {
+        return NULL;
+    }
+    chunk->used = size;
+    return reinterpret_cast<Header *>(chunk->base);
+}
+
+static Header * poolAlloc(size_t size)
+{
+    unsigned size_class = ALLOC_MIN_CLASS;
+
+    while (((size_t)1 << size_class) < size) {
+        size_class++;
+    }
+    if (size_class >= ALLOC_CLASSES) {
+        return NULL;
+    }
+
+    Header * header = free_list[size_class];
+    if (header) {
+        free_list[size_class] = *reinterpret_cast<Header **>(header + 1);
+    } else {
+        header = bump(ALLOC_POOL, (size_t)1 << size_class);
+    }
+    if (header) {
+        header->size_class = size_class;
+    }
+    return header;
+}
+
+/* the arena is rewound when its last block is freed */
+static void rewind(int kind)
+{
+    size_t const count = chunk_count.load();
+
+    for (size_t iter = 0; iter < count; iter++) {
+        if (chunkKind(&chunks[iter]) == kind) {
+            chunks[iter].used = 0;
+        }
+    }
+}
+
+}  // namespace
+
+int alloc_parse(const char * name)
+{
+    for (int kind = ALLOC_SYSTEM; kind <= ALLOC_HUGE; kind++) {
+        if (strcmp(name, alloc_name(kind)) == 0) {
+            return kind;
+        }
+    }
+    return -1;
+}
+
+const char * alloc_name(int kind)
+{
+    switch (kind) {
+        case ALLOC_ARENA:   return "arena";
+        case ALLOC_POOL:    return "pool";
+        case ALLOC_HUGE:    return "huge";
+        default:            return "system";
+    }
+}
+
+void alloc_select(int kind)
+{
+    selected.store(kind);
+}
+
+void * alloc_malloc(size_t size)
+{
+    int const kind = selected.load(std::memory_order_relaxed);
+
+    if (kind == ALLOC_SYSTEM) {
+        return malloc(size);
+    }
+
+    size_t const total = (sizeof(Header) + size + 15) & ~(size_t)15;
+    Header * header;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        header = (kind == ALLOC_POOL) ? poolAlloc(total) : bump(kind, total);
+        if (header && kind != ALLOC_POOL) {
+            live[kind]++;
+        }
+    }
+
+    /* out of chunks, the block is freed with free() */
+    if (!header) {
+        return malloc(size);
+    }
+    header->kind = kind;
+    header->size = size;
+    return header + 1;
+}
+
+void alloc_free(void * ptr)
+{
+    if (!ptr) {
+        return;
+    }
+    if (!owner(ptr)) {
+        free(ptr);
+        return;
+    }
+
+    Header * const header = static_cast<Header *>(ptr) - 1;
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (header->kind == ALLOC_POOL) {
+        *reinterpret_cast<Header **>(ptr) = free_list[header->size_class];
+        free_list[header->size_class] = header;
+    } else if (--live[header->kind] == 0) {
+        rewind(header->kind);
+    }
+}
+
+void alloc_get_stats(struct alloc_stats * stats)
+{
+    size_t const count = chunk_count.load();
+
+    *stats = (struct alloc_stats){};
+    for (size_t iter = 0; iter < count; iter++) {
+        stats->chunks++;
+        stats->mapped += chunks[iter].size;
+        if (chunks[iter].kind == -ALLOC_HUGE) {
+            stats->hugetlb += chunks[iter].size;
+        } else if (chunks[iter].kind == ALLOC_HUGE) {
+            stats->thp += chunks[iter].size;
+        }
+    }
+}
+
+void * alloc_pcre2_malloc(size_t size, UNUSED void * data)
+{
+    return alloc_malloc(size);
+}
+
+void alloc_pcre2_free(void * ptr, UNUSED void * data)
+{
+    alloc_free(ptr);
+}
+
+/* RE2, Boost, C++ std and the wrappers allocate with new, libstdc++ forwards the other forms to these two */
+void * operator new(size_t size)
+{
+    void * const ptr = alloc_malloc(size ? size : 1);
+
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void * ptr) noexcept
+{
+    alloc_free(ptr);
+}
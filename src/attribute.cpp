@@ -0,0 +1,106 @@
+#include <math.h>
+
+#include "attribute.hpp"
+
+namespace {
+
+struct Context {
+    size_t rule_num;
+    const SetScanTime * scan_time;
+    AttributeResult * result;
+    double threshold;
+};
+
+/* scan time saved by leaving the group out of the full set */
+static bool saving_without(Context& ctx, const std::vector<size_t>& group, double * saving)
+{
+    std::vector<bool> left_out(ctx.rule_num, false);
+    std::vector<size_t> rest;
+
+    for (size_t id : group) {
+        left_out[id] = true;
+    }
+    for (size_t id = 0; id < ctx.rule_num; id++) {
+        if (!left_out[id]) {
+            rest.push_back(id);
+        }
+    }
+
+    double time = 0;
+    if (!rest.empty()) {
+        time = (*ctx.scan_time)(rest);
+        ctx.result->recompiles++;
+        if (time < 0) {
+            return false;
+        }
+    }
+
+    *saving = ctx.result->full_time - time;
+    return true;
+}
+
+static bool bisect(Context& ctx, const std::vector<size_t>& group)
+{
+    double saving;
+
+    if (!saving_without(ctx, group, &saving)) {
+        return false;
+    }
+
+    if (group.size() == 1 || saving <= ctx.threshold) {
+        for (size_t id : group) {
+            ctx.result->marginal[id] = saving / group.size();
+        }
+        return true;
+    }
+
+    size_t const half = group.size() / 2;
+    return bisect(ctx, std::vector<size_t>(group.begin(), group.begin() + half))
+        && bisect(ctx, std::vector<size_t>(group.begin() + half, group.end()));
+}
+
+}  // namespace
+
+bool attribute_rules(size_t rule_num, const SetScanTime& scan_time, AttributeMethod method, AttributeResult * result)
+{
+    std::vector<size_t> all;
+
+    for (size_t id = 0; id < rule_num; id++) {
+        all.push_back(id);
+    }
+
+    *result = AttributeResult();
+    result->marginal.assign(rule_num, 0);
+    if (rule_num == 0) {
+        return true;
+    }
+
+    double const first = scan_time(all);
+    double const second = scan_time(all);
+    result->recompiles += 2;
+    if (first < 0 || second < 0) {
+        return false;
+    }
+    result->full_time = first < second ? first : second;
+    result->noise = fabs(first - second);
+
+    /* savings below the noise or half a percent of the scan time are not split further */
+    double const floor = result->full_time * 0.005;
+    Context ctx = {rule_num, &scan_time, result, 2 * result->noise > floor ? 2 * result->noise : floor};
+
+    if (method == ATTRIBUTE_LOO) {
+        for (size_t id = 0; id < rule_num; id++) {
+            if (!saving_without(ctx, std::vector<size_t>(1, id), &result->marginal[id])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    size_t const half = rule_num / 2;
+    if (half == 0) {
+        return bisect(ctx, all);
+    }
+    return bisect(ctx, std::vector<size_t>(all.begin(), all.begin() + half))
+        && bisect(ctx, std::vector<size_t>(all.begin() + half, all.end()));
+}
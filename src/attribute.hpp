@@ -0,0 +1,33 @@
+#ifndef ATTRIBUTE_HPP
+#define ATTRIBUTE_HPP
+
+#include <stddef.h>
+#include <functional>
+#include <vector>
+
+/*
+ * Marginal scan cost of every rule of a multi-pattern database: the scan time
+ * of the complete set minus the scan time of the set without the rule. Leave-
+ * one-out recompiles the set once per rule. Group bisection leaves out halves
+ * of the set and only splits the groups whose removal saves more than the
+ * measurement noise, a few expensive rules are found with O(k log n)
+ * recompiles. The rules of a cheap group share its saving.
+ */
+enum AttributeMethod {
+    ATTRIBUTE_BISECT,
+    ATTRIBUTE_LOO,
+};
+
+/* scan time in ms of a set made of the given rules (indices into the full set), negative on errors */
+typedef std::function<double(const std::vector<size_t>& rules)> SetScanTime;
+
+struct AttributeResult {
+    std::vector<double> marginal;   /* ms per rule */
+    double full_time = 0;
+    double noise = 0;               /* ms, difference of two scans of the full set */
+    size_t recompiles = 0;
+};
+
+bool attribute_rules(size_t rule_num, const SetScanTime& scan_time, AttributeMethod method, AttributeResult * result);
+
+#endif // ATTRIBUTE_HPP
@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+#include "main.h"
+#include "regex_parser.hpp"
+#include "byte_class.hpp"
+
+/*
+ * Reference points for the regex engines on the same buffer: how fast the
+ * input can be read at all, and how fast the simplest searches a pattern
+ * could be reduced to run. They do not match the patterns, the counts are
+ * the hits of each search.
+ */
+enum Baseline {
+    BASELINE_MEMREAD,       /* reads every byte, the ceiling of all engines */
+    BASELINE_MEMCHR,        /* memchr() of the only byte a match can start with */
+    BASELINE_MEMMEM,        /* memmem() of a literal pattern, every occurrence */
+    BASELINE_CLASS,         /* bytes a match can start with, counted with ByteClass */
+};
+
+struct BaselineSearch {
+    Baseline kind;
+    std::string literal;
+    ByteClass start;
+};
+
+/* keeps the compiler from dropping the read sweep */
+static volatile uint64_t baseline_checksum;
+
+static uint64_t memread(const uint8_t * data, size_t len)
+{
+    uint64_t sum[8] = {0};
+    size_t pos = 0;
+
+    /* independent lanes, vectorized with -march=native */
+    for (; pos + sizeof(sum) <= len; pos += sizeof(sum)) {
+        uint64_t words[8];
+        memcpy(words, data + pos, sizeof(words));
+        for (int lane = 0; lane < 8; lane++) {
+            sum[lane] ^= words[lane];
+        }
+    }
+    for (; pos < len; pos++) {
+        sum[0] ^= data[pos];
+    }
+
+    uint64_t checksum = 0;
+    for (int lane = 0; lane < 8; lane++) {
+        checksum ^= sum[lane];
+    }
+    baseline_checksum = checksum;
+    return 0;
+}
+
+static uint64_t run_search(const BaselineSearch& search, const char * subject, size_t subject_len)
+{
+    const uint8_t * const data = (const uint8_t *)subject;
+    uint64_t found = 0;
+
+    switch (search.kind) {
+        case BASELINE_MEMREAD:
+            return memread(data, subject_len);
+        case BASELINE_MEMCHR: {
+            const char * pos = subject;
+            const char * const end = subject + subject_len;
+            while ((pos = (const char *)memchr(pos, search.literal[0], end - pos)) != NULL) {
+                found++;
+                if (regex_is_match) {
+                    break;
+                }
+                pos++;
+            }
+            return found;
+        }
+        case BASELINE_MEMMEM: {
+            const char * pos = subject;
+            const char * const end = subject + subject_len;
+            while ((pos = (const char *)memmem(pos, end - pos, search.literal.data(), search.literal.size())) != NULL) {
+                found++;
+                if (regex_is_match) {
+                    break;
+                }
+                pos++;
+            }
+            return found;
+        }
+        case BASELINE_CLASS:
+            if (regex_is_match) {
+                return search.start.find(data, 0, subject_len) < subject_len;
+            }
+            return search.start.count(data, subject_len);
+    }
+    return 0;
+}
+
+static bool prepare(const char * pattern, Baseline kind, BaselineSearch * search)
+{
+    RegexNode root;
+    std::bitset<256> first_chars;
+    std::string error;
+    bool caseless = false;
+
+    search->kind = kind;
+    if (kind == BASELINE_MEMREAD) {
+        return true;
+    }
+
+    std::string const source = (regex_caseless == CASE_NATIVE) ? std::string("(?i)") + pattern : std::string(pattern);
+    if (!regex_parse(source, &root, &error)) {
+        fprintf(stderr, "ERROR: Cannot parse '%s': %s\n", pattern, error.c_str());
+        return false;
+    }
+
+    switch (kind) {
+        case BASELINE_MEMCHR:
+            if (!regex_first_chars(root, &first_chars) || first_chars.count() != 1) {
+                return false;
+            }
+            for (int c = 0; c < 256; c++) {
+                if (first_chars[c]) {
+                    search->literal = std::string(1, (char)c);
+                }
+            }
+            return true;
+        case BASELINE_MEMMEM:
+            return regex_literal(root, &search->literal, &caseless) && !caseless;
+        case BASELINE_CLASS:
+            if (!regex_first_chars(root, &first_chars)) {
+                return false;
+            }
+            search->start.init(first_chars);
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* patterns without a matching search fail quietly, like an engine without support for them */
+static int baseline_find_all_common(const char* pattern, const char* subject, size_t subject_len,
+                                    const struct blocks * blocks, Baseline kind, int repeat, struct result * res)
+{
+    TIME_TYPE start, end;
+    BaselineSearch base;
+    uint64_t found = 0;
+
+    GET_TIME(start);
+    if (!prepare(pattern, kind, &base)) {
+        return -1;
+    }
+    GET_TIME(end);
+    double const pre_times = TIME_DIFF_IN_MS(start, end);
+
+    double * times = (double*) std::calloc(repeat, sizeof(double));
+    int const times_len = repeat;
+
+    do {
+        START_SCAN_TIME(start);
+        if (blocks) {
+            found = 0;
+            for (size_t iter = 0; iter < blocks->count; iter++) {
+                found += run_search(base, blocks->data[iter], blocks->len[iter]);
+            }
+        } else {
+            found = run_search(base, subject, subject_len);
+        }
+        STOP_SCAN_TIME(end);
+        times[repeat - 1] = TIME_DIFF_IN_MS(start, end);
+
+    } while (--repeat > 0);
+
+    res->matches = found;
+    get_mean_and_derivation(pre_times, times, times_len, res);
+
+    free(times);
+
+    return 0;
+}
+
+extern "C" int memread_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res)
+{
+    return baseline_find_all_common(pattern, subject, subject_len, NULL, BASELINE_MEMREAD, repeat, res);
+}
+
+extern "C" int memread_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res)
+{
+    return baseline_find_all_common(pattern, NULL, 0, blocks, BASELINE_MEMREAD, repeat, res);
+}
+
+extern "C" int memchr_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res)
+{
+    return baseline_find_all_common(pattern, subject, subject_len, NULL, BASELINE_MEMCHR, repeat, res);
+}
+
+extern "C" int memchr_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res)
+{
+    return baseline_find_all_common(pattern, NULL, 0, blocks, BASELINE_MEMCHR, repeat, res);
+}
+
+extern "C" int memmem_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res)
+{
+    return baseline_find_all_common(pattern, subject, subject_len, NULL, BASELINE_MEMMEM, repeat, res);
+}
+
+extern "C" int memmem_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res)
+{
+    return baseline_find_all_common(pattern, NULL, 0, blocks, BASELINE_MEMMEM, repeat, res);
+}
+
+extern "C" int classscan_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res)
+{
+    return baseline_find_all_common(pattern, subject, subject_len, NULL, BASELINE_CLASS, repeat, res);
+}
+
+extern "C" int classscan_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res)
+{
+    return baseline_find_all_common(pattern, NULL, 0, blocks, BASELINE_CLASS, repeat, res);
+}
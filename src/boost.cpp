@@ -5,36 +5,41 @@
 #include <boost/regex.hpp>
 
 
-static int search_all( boost::regex& rx, const std::string& text )
+static uint64_t search_all( boost::regex& rx, const std::string& text )
 {
+    if (regex_is_match) {
+        return boost::regex_search( text, rx );
+    }
+
     auto words_begin = boost::sregex_iterator( text.begin(), text.end(), rx );
     auto words_end = boost::sregex_iterator();
     return std::distance(words_begin, words_end);    
 }
 
-extern "C" int boost_find_all(char* pattern, char* subject, int subject_len, int repeat, struct result * res)
+extern "C" int boost_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res)
 {
     TIME_TYPE start, end = 0;
-    int found = 0;
+    uint64_t found = 0;
 
     try {
-        boost::regex rx(pattern,boost::regex::optimize );//|boost::regex::extended);
+        boost::regex::flag_type const icase = (regex_caseless == CASE_NATIVE) ? boost::regex::icase : boost::regex::normal;
+        boost::regex rx(pattern,boost::regex::optimize | icase);//|boost::regex::extended);
         std::string text( subject, subject_len );
 
         double * times = (double*) std::calloc(repeat, sizeof(double));
         int const times_len = repeat;
 
         do {
-            GET_TIME(start);
+            START_SCAN_TIME(start);
             found = search_all( rx, text );
-            GET_TIME(end);
+            STOP_SCAN_TIME(end);
             times[repeat - 1] = TIME_DIFF_IN_MS(start, end);
 
         } while (--repeat > 0);
 
 
         res->matches = found;
-        get_mean_and_derivation(times, times_len, res);
+        get_mean_and_derivation(0, times, times_len, res);
 
         free(times);
     } catch ( ... ) {
@@ -0,0 +1,110 @@
+#ifndef BYTE_CLASS_HPP
+#define BYTE_CLASS_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <bitset>
+
+#if defined(__AVX512BW__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/*
+ * Membership test of a set of bytes, 64 (AVX-512BW) or 32 (AVX2) bytes per
+ * step, truffle style: pshufb looks up the low nibble of every byte in one
+ * table per half of the byte range, the result holds one bit per high nibble.
+ * Without either extension the bytes are looked up one by one.
+ */
+struct ByteClass {
+    bool table[256];
+    /* pshufb looks up within 128 bit lanes, the tables are repeated for each of the 4 lanes */
+    uint8_t low[64];        /* bytes 0x00-0x7f: bit (c >> 4) of low[c & 15] */
+    uint8_t high[64];       /* bytes 0x80-0xff: bit (c >> 4) & 7 of high[c & 15] */
+    uint8_t bits[64];
+
+    void init(const std::bitset<256>& chars)
+    {
+        memset(low, 0, sizeof(low));
+        memset(high, 0, sizeof(high));
+        for (int c = 0; c < 256; c++) {
+            table[c] = chars[c];
+            if (chars[c]) {
+                (c < 0x80 ? low : high)[c & 15] |= 1 << ((c >> 4) & 7);
+            }
+        }
+        for (int iter = 0; iter < 64; iter++) {
+            low[iter] = low[iter & 15];
+            high[iter] = high[iter & 15];
+            bits[iter] = 1 << (iter & 7);
+        }
+    }
+
+#if defined(__AVX512BW__)
+    static const size_t width = 64;
+
+    uint64_t mask(const uint8_t * data) const
+    {
+        __m512i const v = _mm512_loadu_si512((const void *)data);
+        /* pshufb gives 0 for indices with the top bit set */
+        __m512i const found = _mm512_or_si512(_mm512_shuffle_epi8(_mm512_loadu_si512((const void *)low), v),
+                                              _mm512_shuffle_epi8(_mm512_loadu_si512((const void *)high),
+                                                                  _mm512_xor_si512(v, _mm512_set1_epi8((char)0x80))));
+        __m512i const bit = _mm512_shuffle_epi8(_mm512_loadu_si512((const void *)bits),
+                                                _mm512_and_si512(_mm512_srli_epi16(v, 4), _mm512_set1_epi8(0x0f)));
+        return _mm512_test_epi8_mask(found, bit);
+    }
+#elif defined(__AVX2__)
+    static const size_t width = 32;
+
+    uint64_t mask(const uint8_t * data) const
+    {
+        __m256i const v = _mm256_loadu_si256((const __m256i *)data);
+        /* pshufb gives 0 for indices with the top bit set */
+        __m256i const found = _mm256_or_si256(_mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)low), v),
+                                              _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)high),
+                                                                  _mm256_xor_si256(v, _mm256_set1_epi8((char)0x80))));
+        __m256i const bit = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)bits),
+                                                _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0f)));
+        uint32_t const misses = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(found, bit),
+                                                                       _mm256_setzero_si256()));
+        return (uint32_t)~misses;
+    }
+#endif
+
+    /* position of the next byte of the class from pos on, len if there is none */
+    size_t find(const uint8_t * data, size_t pos, size_t len) const
+    {
+#if defined(__AVX512BW__) || defined(__AVX2__)
+        for (; pos + width <= len; pos += width) {
+            uint64_t const hits = mask(data + pos);
+            if (hits) {
+                return pos + __builtin_ctzll(hits);
+            }
+        }
+#endif
+        while (pos < len && !table[data[pos]]) {
+            pos++;
+        }
+        return pos;
+    }
+
+    /* number of bytes of the class */
+    size_t count(const uint8_t * data, size_t len) const
+    {
+        size_t pos = 0;
+        size_t found = 0;
+
+#if defined(__AVX512BW__) || defined(__AVX2__)
+        for (; pos + width <= len; pos += width) {
+            found += __builtin_popcountll(mask(data + pos));
+        }
+#endif
+        for (; pos < len; pos++) {
+            found += table[data[pos]];
+        }
+        return found;
+    }
+};
+
+#endif // BYTE_CLASS_HPP
@@ -0,0 +1,334 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <map>
+#include <unordered_map>
+
+#include <pcap.h>
+
+#include "capture.hpp"
+
+namespace {
+
+#define ETHERTYPE_IPV4  0x0800
+#define ETHERTYPE_IPV6  0x86dd
+#define ETHERTYPE_VLAN  0x8100
+#define ETHERTYPE_QINQ  0x88a8
+
+#define PROTO_TCP       6
+#define PROTO_UDP       17
+
+#define TCP_FLAG_SYN    0x02
+
+static uint16_t get16(const unsigned char * ptr)
+{
+    return (uint16_t)((ptr[0] << 8) | ptr[1]);
+}
+
+static uint32_t get32(const unsigned char * ptr)
+{
+    return ((uint32_t)ptr[0] << 24) | ((uint32_t)ptr[1] << 16) | ((uint32_t)ptr[2] << 8) | ptr[3];
+}
+
+struct Packet {
+    std::string key;        /* addresses, ports and protocol of one direction */
+    uint8_t proto;
+    uint32_t seq;
+    uint8_t tcp_flags;
+    const unsigned char * payload;
+    size_t len;
+};
+
+/* returns the offset of the IP header or -1 for unsupported link layers */
+static long link_offset(int link_type, const unsigned char * data, size_t len, uint16_t * ethertype)
+{
+    switch (link_type) {
+        case DLT_EN10MB: {
+            size_t off = 14;
+            if (len < off) {
+                return -1;
+            }
+            *ethertype = get16(data + 12);
+            while ((*ethertype == ETHERTYPE_VLAN || *ethertype == ETHERTYPE_QINQ) && len >= off + 4) {
+                *ethertype = get16(data + off + 2);
+                off += 4;
+            }
+            return off;
+        }
+        case DLT_LINUX_SLL:
+            if (len < 16) {
+                return -1;
+            }
+            *ethertype = get16(data + 14);
+            return 16;
+        case DLT_NULL:
+        case DLT_LOOP:
+            if (len < 5) {
+                return -1;
+            }
+            *ethertype = ((data[4] >> 4) == 6) ? ETHERTYPE_IPV6 : ETHERTYPE_IPV4;
+            return 4;
+        case DLT_RAW:
+        case DLT_IPV4:
+        case DLT_IPV6:
+            if (len < 1) {
+                return -1;
+            }
+            *ethertype = ((data[0] >> 4) == 6) ? ETHERTYPE_IPV6 : ETHERTYPE_IPV4;
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+static bool parse_packet(int link_type, const unsigned char * data, size_t len, Packet * pkt)
+{
+    uint16_t ethertype = 0;
+    long off = link_offset(link_type, data, len, &ethertype);
+    const unsigned char * l4;
+    size_t l4_len;
+
+    if (off < 0) {
+        return false;
+    }
+    data += off;
+    len -= off;
+
+    if (ethertype == ETHERTYPE_IPV4) {
+        if (len < 20 || (data[0] >> 4) != 4) {
+            return false;
+        }
+        size_t ihl = (data[0] & 0x0f) * 4;
+        size_t total = get16(data + 2);
+        /* non-first fragments do not carry the transport header */
+        if ((get16(data + 6) & 0x1fff) != 0 || ihl < 20 || total < ihl) {
+            return false;
+        }
+        if (total < len) {
+            len = total;
+        }
+        if (len < ihl) {
+            return false;
+        }
+        pkt->proto = data[9];
+        pkt->key.assign((const char *)data + 12, 8);
+        l4 = data + ihl;
+        l4_len = len - ihl;
+    } else if (ethertype == ETHERTYPE_IPV6) {
+        if (len < 40) {
+            return false;
+        }
+        size_t payload_len = get16(data + 4);
+        uint8_t next = data[6];
+        size_t off6 = 40;
+
+        if (payload_len + 40 < len) {
+            len = payload_len + 40;
+        }
+
+        /* skip hop-by-hop, routing and destination options headers */
+        while ((next == 0 || next == 43 || next == 60) && len >= off6 + 8) {
+            next = data[off6];
+            off6 += (data[off6 + 1] + 1) * 8;
+        }
+        if (off6 > len) {
+            return false;
+        }
+        pkt->proto = next;
+        pkt->key.assign((const char *)data + 8, 32);
+        l4 = data + off6;
+        l4_len = len - off6;
+    } else {
+        return false;
+    }
+
+    if (pkt->proto == PROTO_TCP) {
+        if (l4_len < 20) {
+            return false;
+        }
+        size_t doff = (l4[12] >> 4) * 4;
+        if (doff < 20 || doff > l4_len) {
+            return false;
+        }
+        pkt->seq = get32(l4 + 4);
+        pkt->tcp_flags = l4[13];
+        pkt->payload = l4 + doff;
+        pkt->len = l4_len - doff;
+    } else if (pkt->proto == PROTO_UDP) {
+        if (l4_len < 8) {
+            return false;
+        }
+        pkt->payload = l4 + 8;
+        pkt->len = l4_len - 8;
+    } else {
+        return false;
+    }
+
+    pkt->key.append((const char *)l4, 4);
+    pkt->key.push_back(pkt->proto);
+    return true;
+}
+
+/*
+ * Per direction TCP state, out-of-order segments wait in pending until the gap
+ * is filled. pending is keyed by the offset from the first sequence number, so
+ * it stays in stream order when the sequence numbers wrap around.
+ */
+struct TcpStream {
+    bool synced = false;
+    uint32_t isn = 0;
+    uint32_t next_seq = 0;
+    std::map<uint32_t, std::string> pending;
+};
+
+}  // namespace
+
+void PacketTrace::addSegment(unsigned int flow, const char * data, size_t len)
+{
+    if (len == 0) {
+        return;
+    }
+
+    packet_offset.push_back(packet_data.size());
+    packet_len.push_back(len);
+    packet_flow.push_back(flow);
+    packet_data.append(data, len);
+
+    flow_data[flow].append(data, len);
+    payload_bytes += len;
+}
+
+bool PacketTrace::load(const char * file_name, bool reassemble)
+{
+    char errbuf[PCAP_ERRBUF_SIZE];
+    std::unordered_map<std::string, unsigned int> flow_ids;
+    std::vector<TcpStream> streams;
+    struct pcap_pkthdr * header;
+    const unsigned char * data;
+    int ret;
+
+    pcap_t * handle = pcap_open_offline(file_name, errbuf);
+    if (!handle) {
+        fprintf(stderr, "Cannot open '%s': %s\n", file_name, errbuf);
+        return false;
+    }
+
+    int const link_type = pcap_datalink(handle);
+
+    while ((ret = pcap_next_ex(handle, &header, &data)) == 1) {
+        Packet pkt;
+
+        captured_packets++;
+        if (!parse_packet(link_type, data, header->caplen, &pkt)) {
+            continue;
+        }
+
+        auto it = flow_ids.find(pkt.key);
+        if (it == flow_ids.end()) {
+            it = flow_ids.emplace(pkt.key, flow_data.size()).first;
+            flow_data.emplace_back();
+            streams.emplace_back();
+        }
+        unsigned int const flow = it->second;
+
+        if (!reassemble || pkt.proto != PROTO_TCP) {
+            addSegment(flow, (const char *)pkt.payload, pkt.len);
+            continue;
+        }
+
+        TcpStream& stream = streams[flow];
+        if (pkt.tcp_flags & TCP_FLAG_SYN) {
+            stream.synced = true;
+            stream.isn = pkt.seq + 1;
+            stream.next_seq = stream.isn;
+            continue;
+        }
+        if (!stream.synced) {
+            /* capture started in the middle of the connection */
+            stream.synced = true;
+            stream.isn = pkt.seq;
+            stream.next_seq = stream.isn;
+        }
+        if (pkt.len == 0) {
+            continue;
+        }
+
+        int32_t diff = (int32_t)(pkt.seq - stream.next_seq);
+        if (diff > 0) {
+            std::string& slot = stream.pending[pkt.seq - stream.isn];
+            if (slot.size() < pkt.len) {
+                slot.assign((const char *)pkt.payload, pkt.len);
+            }
+            continue;
+        }
+
+        /* retransmission, drop the bytes that were already delivered */
+        if ((size_t)-diff >= pkt.len) {
+            continue;
+        }
+        addSegment(flow, (const char *)pkt.payload - diff, pkt.len + diff);
+        stream.next_seq += pkt.len + diff;
+
+        while (!stream.pending.empty()) {
+            auto next = stream.pending.begin();
+            int32_t gap = (int32_t)(next->first - (stream.next_seq - stream.isn));
+
+            if (gap > 0) {
+                break;
+            }
+            if ((size_t)-gap < next->second.size()) {
+                addSegment(flow, next->second.data() - gap, next->second.size() + gap);
+                stream.next_seq += next->second.size() + gap;
+            }
+            stream.pending.erase(next);
+        }
+    }
+
+    if (ret == -1) {
+        fprintf(stderr, "Error reading '%s': %s\n", file_name, pcap_geterr(handle));
+        pcap_close(handle);
+        return false;
+    }
+    pcap_close(handle);
+
+    /* segments behind a gap that was never filled are delivered anyway */
+    for (size_t flow = 0; flow < streams.size(); flow++) {
+        for (const auto& seg : streams[flow].pending) {
+            addSegment(flow, seg.second.data(), seg.second.size());
+        }
+    }
+
+    finish();
+    return true;
+}
+
+void PacketTrace::finish()
+{
+    /* packet_data does not move any more, pointers are stable from here */
+    for (size_t iter = 0; iter < packet_offset.size(); iter++) {
+        packet_ptr.push_back(packet_data.data() + packet_offset[iter]);
+    }
+
+    for (size_t flow = 0; flow < flow_data.size(); flow++) {
+        if (flow_data[flow].empty()) {
+            continue;
+        }
+        flow_ptr.push_back(flow_data[flow].data());
+        flow_len.push_back(flow_data[flow].size());
+        flow_id.push_back(flow_ptr.size() - 1);
+    }
+
+    packet_blocks.data = packet_ptr.data();
+    packet_blocks.len = packet_len.data();
+    packet_blocks.flow = packet_flow.data();
+    packet_blocks.count = packet_ptr.size();
+    packet_blocks.flows = flow_data.size();
+    packet_blocks.bytes = payload_bytes;
+
+    flow_blocks.data = flow_ptr.data();
+    flow_blocks.len = flow_len.data();
+    flow_blocks.flow = flow_id.data();
+    flow_blocks.count = flow_ptr.size();
+    flow_blocks.flows = flow_ptr.size();
+    flow_blocks.bytes = payload_bytes;
+}
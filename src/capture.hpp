@@ -0,0 +1,50 @@
+#ifndef CAPTURE_HPP
+#define CAPTURE_HPP
+
+#include <string>
+#include <vector>
+
+#include "main.h"
+
+/*
+ * Payloads of a packet capture, read offline with libpcap. Every TCP/UDP payload
+ * is a packet segment tagged with the id of its flow (one id per direction of a
+ * 5-tuple). With reassembly enabled, TCP segments are put in sequence order and
+ * retransmitted bytes are dropped. The flows are additionally kept as contiguous
+ * buffers for block mode scanning per flow.
+ */
+class PacketTrace {
+ public:
+    bool load(const char * file_name, bool reassemble);
+
+    /* segments in delivery order, flow[] holds the stream id of each segment */
+    const struct blocks& packets() const { return packet_blocks; }
+    /* one contiguous buffer per flow */
+    const struct blocks& flows() const { return flow_blocks; }
+
+    size_t captured() const { return captured_packets; }
+    size_t payloadBytes() const { return payload_bytes; }
+
+ private:
+    void addSegment(unsigned int flow, const char * data, size_t len);
+    void finish();
+
+    std::string packet_data;
+    std::vector<size_t> packet_offset;
+    std::vector<size_t> packet_len;
+    std::vector<unsigned int> packet_flow;
+    std::vector<const char *> packet_ptr;
+
+    std::vector<std::string> flow_data;
+    std::vector<const char *> flow_ptr;
+    std::vector<size_t> flow_len;
+    std::vector<unsigned int> flow_id;
+
+    struct blocks packet_blocks = {};
+    struct blocks flow_blocks = {};
+
+    size_t captured_packets = 0;
+    size_t payload_bytes = 0;
+};
+
+#endif // CAPTURE_HPP
@@ -0,0 +1,45 @@
+#include <stddef.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "main.h"
+
+/*
+ * Shifts A-Z to the bottom of the signed byte range, so one signed compare
+ * finds the upper case letters: x + (0x80 - 'A') < -128 + 26. The mask then
+ * selects the 0x20 bit that is or'ed in.
+ */
+void fold_lower(char * data, size_t len)
+{
+    size_t iter = 0;
+
+#if defined(__AVX2__)
+    __m256i const shift = _mm256_set1_epi8((char)(0x80 - 'A'));
+    __m256i const limit = _mm256_set1_epi8((char)(-128 + 26));
+    __m256i const bit = _mm256_set1_epi8(0x20);
+
+    for (; iter + 32 <= len; iter += 32) {
+        __m256i const chars = _mm256_loadu_si256((const __m256i *)(data + iter));
+        __m256i const upper = _mm256_cmpgt_epi8(limit, _mm256_add_epi8(chars, shift));
+        _mm256_storeu_si256((__m256i *)(data + iter), _mm256_or_si256(chars, _mm256_and_si256(upper, bit)));
+    }
+#elif defined(__SSE2__)
+    __m128i const shift = _mm_set1_epi8((char)(0x80 - 'A'));
+    __m128i const limit = _mm_set1_epi8((char)(-128 + 26));
+    __m128i const bit = _mm_set1_epi8(0x20);
+
+    for (; iter + 16 <= len; iter += 16) {
+        __m128i const chars = _mm_loadu_si128((const __m128i *)(data + iter));
+        __m128i const upper = _mm_cmpgt_epi8(limit, _mm_add_epi8(chars, shift));
+        _mm_storeu_si128((__m128i *)(data + iter), _mm_or_si128(chars, _mm_and_si128(upper, bit)));
+    }
+#endif
+
+    for (; iter < len; iter++) {
+        if (data[iter] >= 'A' && data[iter] <= 'Z') {
+            data[iter] |= 0x20;
+        }
+    }
+}
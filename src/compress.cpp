@@ -0,0 +1,746 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <utility>
+
+#include "main.h"
+#include "corpus.hpp"
+#include "compress.hpp"
+#include "direct_io.hpp"
+#include "util.hpp"
+
+#ifdef INCLUDE_ZSTD
+#include <zstd.h>
+#endif
+
+#ifdef INCLUDE_LZ4
+#include <lz4frame.h>
+#endif
+
+#ifdef INCLUDE_HYPERSCAN
+#include "hyperscan.hpp"
+#endif
+
+#ifdef INCLUDE_PCRE2
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include <pcre2.h>
+#endif
+
+#define COMPRESS_READ_SIZE  ((size_t)1 << 20)
+
+namespace {
+
+class Plain : public Decompressor {
+public:
+    explicit Plain(FILE * file) : Decompressor(COMPRESS_NONE, file) {}
+
+protected:
+    bool step(const char * in, size_t in_len, char * out, size_t out_len, size_t * consumed, size_t * produced) override
+    {
+        size_t const len = std::min(in_len, out_len);
+
+        memcpy(out, in, len);
+        *consumed = *produced = len;
+        return true;
+    }
+};
+
+#ifdef INCLUDE_ZSTD
+class Zstd : public Decompressor {
+public:
+    explicit Zstd(FILE * file) : Decompressor(COMPRESS_ZSTD, file), stream(ZSTD_createDStream())
+    {
+        if (stream) {
+            ZSTD_initDStream(stream);
+        }
+    }
+
+    ~Zstd() override
+    {
+        ZSTD_freeDStream(stream);
+    }
+
+    bool valid() const { return stream != NULL; }
+
+protected:
+    bool step(const char * in, size_t in_len, char * out, size_t out_len, size_t * consumed, size_t * produced) override
+    {
+        ZSTD_inBuffer input = {in, in_len, 0};
+        ZSTD_outBuffer output = {out, out_len, 0};
+        size_t const ret = ZSTD_decompressStream(stream, &output, &input);
+
+        if (ZSTD_isError(ret)) {
+            fprintf(stderr, "ERROR: zstd: %s\n", ZSTD_getErrorName(ret));
+            return false;
+        }
+        *consumed = input.pos;
+        *produced = output.pos;
+        /* zero once a frame is complete and flushed; without input after a frame it is the size of the next header */
+        if (ret == 0 || input.pos > 0 || output.pos > 0) {
+            pending = ret != 0;
+        }
+        return true;
+    }
+
+    bool complete() const override { return !pending; }
+
+private:
+    ZSTD_DStream * stream;
+    bool pending = false;
+};
+#endif
+
+#ifdef INCLUDE_LZ4
+class Lz4 : public Decompressor {
+public:
+    explicit Lz4(FILE * file) : Decompressor(COMPRESS_LZ4, file)
+    {
+        if (LZ4F_isError(LZ4F_createDecompressionContext(&ctx, LZ4F_VERSION))) {
+            ctx = NULL;
+        }
+    }
+
+    ~Lz4() override
+    {
+        if (ctx) {
+            LZ4F_freeDecompressionContext(ctx);
+        }
+    }
+
+    bool valid() const { return ctx != NULL; }
+
+protected:
+    bool step(const char * in, size_t in_len, char * out, size_t out_len, size_t * consumed, size_t * produced) override
+    {
+        size_t src = in_len;
+        size_t dst = out_len;
+        size_t const ret = LZ4F_decompress(ctx, out, &dst, in, &src, NULL);
+
+        if (LZ4F_isError(ret)) {
+            fprintf(stderr, "ERROR: lz4: %s\n", LZ4F_getErrorName(ret));
+            return false;
+        }
+        *consumed = src;
+        *produced = dst;
+        /* a hint of the next input size, zero at the end of a frame; without input after a frame it is the next header */
+        if (ret == 0 || src > 0 || dst > 0) {
+            pending = ret != 0;
+        }
+        return true;
+    }
+
+    bool complete() const override { return !pending; }
+
+private:
+    LZ4F_dctx * ctx = NULL;
+    bool pending = false;
+};
+#endif
+
+struct Producer {
+    const char * file_name;
+    Decompressor * source;      /* buffered input only */
+    Ring * ring;
+    const PipelineOptions * opts;
+    PipelineResult * result;
+    bool ok;
+};
+
+static void decompress(Decompressor * source, Ring * ring, PipelineResult * result, bool * ok)
+{
+    while (true) {
+        Slot * const slot = ring->acquire(&result->producer_wait);
+        if (!slot) {
+            break;
+        }
+
+        Clock::time_point const start = Clock::now();
+        long const len = source->read(slot->fresh, ring->chunk());
+        result->input += since(start);
+
+        if (len <= 0) {
+            *ok = len == 0;
+            ring->release(slot);
+            break;
+        }
+        result->bytes += len;
+        result->chunks++;
+        ring->push(slot, len);
+    }
+
+    if (*ok) {
+        ring->finish();
+    } else {
+        ring->abort();
+    }
+}
+
+static void produce(Producer * producer)
+{
+    if (producer->opts->input == PipelineOptions::BUFFERED) {
+        decompress(producer->source, producer->ring, producer->result, &producer->ok);
+    } else {
+        producer->ok = direct_read(producer->file_name, producer->opts->input == PipelineOptions::URING,
+                                   producer->ring, producer->result);
+    }
+}
+
+/* the reference of the input stage, the buffers go back to the producer at once */
+static void drop(Ring * ring, PipelineResult * result)
+{
+    while (Slot * const slot = ring->pop(&result->scanner_wait)) {
+        ring->release(slot);
+    }
+}
+
+#ifdef INCLUDE_HYPERSCAN
+static int onMatch(UNUSED unsigned int id, UNUSED unsigned long long from, UNUSED unsigned long long to,
+                   UNUSED unsigned int flags, void * ctx)
+{
+    (*static_cast<uint64_t *>(ctx))++;
+    return 0;
+}
+
+/* one stream over all chunks, only the new bytes of a chunk are scanned */
+static bool scanHsStream(const std::vector<std::string>& rules, Ring * ring, PipelineResult * result)
+{
+    std::vector<const char *> patterns;
+    std::vector<unsigned> flags(rules.size(), HS_FLAG_DOTALL | HS_FLAG_MULTILINE | hs_option_flags());
+    std::vector<unsigned> ids;
+    hs_database_t * database = NULL;
+    hs_compile_error_t * compile_err = NULL;
+    hs_scratch_t * scratch = NULL;
+    hs_stream_t * stream = NULL;
+    bool ok = false;
+
+    for (size_t iter = 0; iter < rules.size(); iter++) {
+        patterns.push_back(rules[iter].c_str());
+        ids.push_back(iter);
+    }
+
+    if (hs_compile_multi(patterns.data(), flags.data(), ids.data(), patterns.size(), HS_MODE_STREAM, NULL,
+                         &database, &compile_err) != HS_SUCCESS) {
+        fprintf(stderr, "ERROR: Unable to compile patterns: %s\n", compile_err ? compile_err->message : "");
+        hs_free_compile_error(compile_err);
+    } else if (hs_alloc_scratch(database, &scratch) != HS_SUCCESS || hs_open_stream(database, 0, &stream) != HS_SUCCESS) {
+        fprintf(stderr, "ERROR: Unable to allocate scratch space.\n");
+    } else {
+        ok = true;
+    }
+
+    while (ok) {
+        Slot * const slot = ring->pop(&result->scanner_wait);
+        if (!slot) {
+            break;
+        }
+
+        Clock::time_point const start = Clock::now();
+        if (hs_scan_stream(stream, slot->fresh, slot->len - slot->overlap, 0, scratch, onMatch,
+                           &result->matches) != HS_SUCCESS) {
+            fprintf(stderr, "ERROR: Unable to scan input buffer.\n");
+            ok = false;
+        }
+        result->scan += since(start);
+        ring->release(slot);
+    }
+
+    if (stream) {
+        hs_close_stream(stream, scratch, onMatch, &result->matches);
+    }
+    if (!ok) {
+        ring->abort();
+    }
+    hs_free_scratch(scratch);
+    hs_free_database(database);
+    return ok;
+}
+#endif
+
+#ifdef INCLUDE_PCRE2
+struct Pcre2Scanner {
+    const std::vector<pcre2_code *> * codes;
+    Ring * ring;
+    double scan = 0;
+    double wait = 0;
+    uint64_t matches = 0;
+    bool ok = true;
+};
+
+/* the matches ending in the overlap were counted with the previous chunk */
+static void scanPcre2(Pcre2Scanner * scanner)
+{
+    pcre2_match_data * match_data = pcre2_match_data_create(1, NULL);
+    pcre2_match_context * match_ctx = pcre2_match_context_create(NULL);
+    pcre2_jit_stack * stack = pcre2_jit_stack_create(32 * 1024, 512 * 1024, NULL);
+
+    if (!match_data || !match_ctx || !stack) {
+        fprintf(stderr, "ERROR: Unable to allocate PCRE2 match data.\n");
+        scanner->ok = false;
+        scanner->ring->abort();
+    } else {
+        pcre2_jit_stack_assign(match_ctx, NULL, stack);
+    }
+
+    PCRE2_SIZE * ovector = match_data ? pcre2_get_ovector_pointer(match_data) : NULL;
+    while (scanner->ok) {
+        Slot * const slot = scanner->ring->pop(&scanner->wait);
+        if (!slot) {
+            break;
+        }
+
+        Clock::time_point const start = Clock::now();
+        PCRE2_SPTR8 const data = (PCRE2_SPTR8)slot->data();
+        for (pcre2_code * re : *scanner->codes) {
+            size_t pos = 0;
+
+            while (pos <= slot->len && scanner->ok) {
+                int const rc = pcre2_jit_match(re, data, slot->len, pos, 0, match_data, match_ctx);
+                if (rc == PCRE2_ERROR_NOMATCH) {
+                    break;
+                } else if (rc < 0) {
+                    fprintf(stderr, "ERROR: PCRE2 match failed with: %d\n", rc);
+                    scanner->ok = false;
+                    break;
+                }
+                if (ovector[1] > slot->overlap || slot->overlap == 0) {
+                    scanner->matches++;
+                }
+                pos = (ovector[1] > ovector[0]) ? ovector[1] : ovector[1] + 1;
+            }
+        }
+        scanner->scan += since(start);
+        scanner->ring->release(slot);
+        if (!scanner->ok) {
+            scanner->ring->abort();
+        }
+    }
+
+    pcre2_jit_stack_free(stack);
+    pcre2_match_context_free(match_ctx);
+    pcre2_match_data_free(match_data);
+}
+
+static bool scanPcre2Jit(const std::vector<std::string>& rules, Ring * ring, unsigned int threads,
+                         PipelineResult * result)
+{
+    std::vector<pcre2_code *> codes;
+    std::vector<Pcre2Scanner> scanners(threads);
+    std::vector<std::thread> workers;
+
+    bool ok = true;
+
+    for (size_t iter = 0; iter < rules.size() && ok; iter++) {
+        int err_code;
+        PCRE2_SIZE err_offset;
+        pcre2_code * re = pcre2_compile((PCRE2_SPTR8)rules[iter].c_str(), PCRE2_ZERO_TERMINATED,
+                                        pcre2_option_flags(), &err_code, &err_offset, NULL);
+
+        if (!re) {
+            fprintf(stderr, "ERROR: PCRE2 compilation of rule %zu failed at offset %d: [%d]\n", iter + 1,
+                    (int)err_offset, err_code);
+            ok = false;
+        } else if ((err_code = pcre2_jit_compile(re, PCRE2_JIT_COMPLETE)) != 0) {
+            fprintf(stderr, "ERROR: PCRE2 JIT compilation of rule %zu failed: [%d]\n", iter + 1, err_code);
+            pcre2_code_free(re);
+            ok = false;
+        } else {
+            codes.push_back(re);
+        }
+    }
+    if (!ok) {
+        ring->abort();
+        scanners.clear();
+    }
+
+    for (auto& scanner : scanners) {
+        scanner.codes = &codes;
+        scanner.ring = ring;
+        workers.emplace_back(scanPcre2, &scanner);
+    }
+    for (size_t iter = 0; iter < workers.size(); iter++) {
+        workers[iter].join();
+        result->scan += scanners[iter].scan;
+        result->scanner_wait += scanners[iter].wait;
+        result->matches += scanners[iter].matches;
+        ok &= scanners[iter].ok;
+    }
+
+    for (pcre2_code * re : codes) {
+        pcre2_code_free(re);
+    }
+    return ok;
+}
+#endif
+
+}  // namespace
+
+Decompressor::Decompressor(CompressFormat fmt, FILE * file) : fmt(fmt), file(file), in(COMPRESS_READ_SIZE) {}
+
+Decompressor::~Decompressor()
+{
+    fclose(file);
+}
+
+std::unique_ptr<Decompressor> Decompressor::open(const char * file_name)
+{
+    CompressFormat const fmt = compress_detect(file_name);
+    FILE * file = fopen(file_name, "rb");
+
+    if (!file) {
+        fprintf(stderr, "Cannot open '%s'!\n", file_name);
+        return nullptr;
+    }
+
+    switch (fmt) {
+#ifdef INCLUDE_ZSTD
+        case COMPRESS_ZSTD: {
+            std::unique_ptr<Zstd> zstd(new Zstd(file));
+            if (!zstd->valid()) {
+                fprintf(stderr, "ERROR: Unable to create the zstd stream.\n");
+                return nullptr;
+            }
+            return std::move(zstd);
+        }
+#endif
+#ifdef INCLUDE_LZ4
+        case COMPRESS_LZ4: {
+            std::unique_ptr<Lz4> lz4(new Lz4(file));
+            if (!lz4->valid()) {
+                fprintf(stderr, "ERROR: Unable to create the lz4 context.\n");
+                return nullptr;
+            }
+            return std::move(lz4);
+        }
+#endif
+        case COMPRESS_NONE:
+            return std::unique_ptr<Decompressor>(new Plain(file));
+        default:
+            fprintf(stderr, "'%s' is %s compressed, built without %s support.\n", file_name, compress_name(fmt),
+                    compress_name(fmt));
+            fclose(file);
+            return nullptr;
+    }
+}
+
+long Decompressor::read(char * out, size_t cap)
+{
+    size_t done = 0;
+
+    while (done < cap) {
+        if (in_pos == in_len && !eof) {
+            in_len = fread(in.data(), 1, in.size(), file);
+            if (ferror(file)) {
+                fprintf(stderr, "ERROR: Unable to read the input file: %s\n", strerror(errno));
+                return -1;
+            }
+            in_pos = 0;
+            in_total += in_len;
+            eof = in_len < in.size();
+        }
+
+        size_t consumed = 0, produced = 0;
+        if (!step(in.data() + in_pos, in_len - in_pos, out + done, cap - done, &consumed, &produced)) {
+            return -1;
+        }
+        in_pos += consumed;
+        done += produced;
+
+        /* the decoders flush their buffered output without input */
+        if (consumed == 0 && produced == 0 && in_pos == in_len && eof) {
+            if (!complete()) {
+                fprintf(stderr, "ERROR: %s input is truncated.\n", compress_name(fmt));
+                return -1;
+            }
+            break;
+        }
+    }
+    return done;
+}
+
+const char * compress_name(CompressFormat fmt)
+{
+    switch (fmt) {
+        case COMPRESS_ZSTD: return "zstd";
+        case COMPRESS_LZ4:  return "lz4";
+        default:            return "none";
+    }
+}
+
+CompressFormat compress_detect(const char * file_name)
+{
+    static const unsigned char zstd_magic[] = {0x28, 0xb5, 0x2f, 0xfd};
+    static const unsigned char lz4_magic[] = {0x04, 0x22, 0x4d, 0x18};
+    unsigned char magic[4];
+    FILE * file = fopen(file_name, "rb");
+    CompressFormat fmt = COMPRESS_NONE;
+
+    if (!file) {
+        return COMPRESS_NONE;
+    }
+    if (fread(magic, 1, sizeof(magic), file) == sizeof(magic)) {
+        if (memcmp(magic, zstd_magic, sizeof(magic)) == 0) {
+            fmt = COMPRESS_ZSTD;
+        } else if (memcmp(magic, lz4_magic, sizeof(magic)) == 0) {
+            fmt = COMPRESS_LZ4;
+        }
+    }
+    fclose(file);
+    return fmt;
+}
+
+bool decompress_file(const char * file_name, std::string * out)
+{
+    std::unique_ptr<Decompressor> source = Decompressor::open(file_name);
+    long len;
+
+    if (!source) {
+        return false;
+    }
+
+    out->clear();
+    do {
+        size_t const size = out->size();
+        out->resize(size + COMPRESS_READ_SIZE * 4);
+        len = source->read(&(*out)[size], COMPRESS_READ_SIZE * 4);
+        out->resize(size + std::max(len, 0L));
+    } while (len == (long)COMPRESS_READ_SIZE * 4);
+
+    return len >= 0;
+}
+
+namespace {
+
+#if defined(INCLUDE_ZSTD) || defined(INCLUDE_LZ4)
+static bool compressFrame(CompressFormat fmt, const char * data, size_t len, std::string * out)
+{
+    size_t const size = out->size();
+
+    switch (fmt) {
+#ifdef INCLUDE_ZSTD
+        case COMPRESS_ZSTD: {
+            out->resize(size + ZSTD_compressBound(len));
+            size_t const ret = ZSTD_compress(&(*out)[size], out->size() - size, data, len, 1);
+            if (ZSTD_isError(ret)) {
+                fprintf(stderr, "ERROR: zstd: %s\n", ZSTD_getErrorName(ret));
+                return false;
+            }
+            out->resize(size + ret);
+            return true;
+        }
+#endif
+#ifdef INCLUDE_LZ4
+        case COMPRESS_LZ4: {
+            out->resize(size + LZ4F_compressFrameBound(len, NULL));
+            size_t const ret = LZ4F_compressFrame(&(*out)[size], out->size() - size, data, len, NULL);
+            if (LZ4F_isError(ret)) {
+                fprintf(stderr, "ERROR: lz4: %s\n", LZ4F_getErrorName(ret));
+                return false;
+            }
+            out->resize(size + ret);
+            return true;
+        }
+#endif
+        default:
+            return false;
+    }
+}
+
+/* decompress_file() of the compressed frames, written to a temporary file */
+static bool decompressFrames(const std::string& compressed, std::string * out)
+{
+    char file_name[] = "/tmp/regex_perf_XXXXXX";
+    int const fd = mkstemp(file_name);
+    bool ok = false;
+
+    if (fd < 0) {
+        fprintf(stderr, "Cannot create a temporary file: %s\n", strerror(errno));
+        return false;
+    }
+    ok = write(fd, compressed.data(), compressed.size()) == (ssize_t)compressed.size();
+    close(fd);
+    ok = ok && decompress_file(file_name, out);
+    unlink(file_name);
+    return ok;
+}
+#endif
+
+}  // namespace
+
+bool compress_check()
+{
+    bool ok = true;
+
+#if defined(INCLUDE_ZSTD) || defined(INCLUDE_LZ4)
+    /* the sizes end on and off the read size, one frame and two concatenated frames */
+    static const size_t sizes[] = {COMPRESS_READ_SIZE * 4, COMPRESS_READ_SIZE * 12 + 12345};
+    std::vector<CompressFormat> formats;
+#ifdef INCLUDE_ZSTD
+    formats.push_back(COMPRESS_ZSTD);
+#endif
+#ifdef INCLUDE_LZ4
+    formats.push_back(COMPRESS_LZ4);
+#endif
+
+    for (CompressFormat fmt : formats) {
+        for (size_t len : sizes) {
+            for (int frames = 1; frames <= 2; frames++) {
+                std::string data(len, 0);
+                std::string compressed;
+                std::string decompressed;
+                uint32_t seed = len;
+
+                for (size_t iter = 0; iter < len; iter++) {
+                    seed = seed * 1103515245 + 12345;
+                    data[iter] = "etaoin shrdlu\n"[(seed >> 16) % 14];
+                }
+
+                size_t const split = (frames == 1) ? len : len / 3;
+                bool const written = compressFrame(fmt, data.data(), split, &compressed)
+                                     && (split == len || compressFrame(fmt, data.data() + split, len - split, &compressed));
+                bool const read = written && decompressFrames(compressed, &decompressed);
+                bool const same = read && decompressed == data;
+
+                fprintf(stdout, "[%10s] round trip of %zu bytes in %d frame(s): %s\n", compress_name(fmt), len, frames,
+                        same ? "ok" : "FAILED");
+
+                /* a file cut inside the last frame must fail */
+                if (same) {
+                    compressed.resize(compressed.size() - 8);
+                    fprintf(stdout, "[%10s] truncated file of %zu bytes is rejected: ", compress_name(fmt), len);
+                    fflush(stdout);
+                    bool const rejected = !decompressFrames(compressed, &decompressed);
+                    fprintf(stdout, "%s\n", rejected ? "ok" : "FAILED");
+                    ok = ok && rejected;
+                }
+                ok = ok && same;
+            }
+        }
+    }
+#else
+    fprintf(stdout, "Built without zstd and lz4 support.\n");
+#endif
+
+    return ok;
+}
+
+bool pipeline_parse_options(const char * spec, PipelineOptions * opts)
+{
+    return parse_options(spec, [opts](const std::string& key, const std::string& value) {
+        if (key == "input") {
+            if (value == "buffered") {
+                opts->input = PipelineOptions::BUFFERED;
+            } else if (value == "direct") {
+                opts->input = PipelineOptions::DIRECT;
+            } else if (value == "uring") {
+                opts->input = PipelineOptions::URING;
+            } else {
+                fprintf(stderr, "Unknown pipeline input '%s' (buffered, direct, uring)\n", value.c_str());
+                return false;
+            }
+        } else if (key == "chunk") {
+            if (!corpus_parse_size(value.c_str(), &opts->chunk) || opts->chunk == 0 || opts->chunk > ((size_t)1 << 30)) {
+                fprintf(stderr, "Invalid chunk size '%s' (up to 1G)\n", value.c_str());
+                return false;
+            }
+        } else if (key == "overlap") {
+            if (!corpus_parse_size(value.c_str(), &opts->overlap) || opts->overlap > ((size_t)1 << 30)) {
+                fprintf(stderr, "Invalid overlap '%s' (up to 1G)\n", value.c_str());
+                return false;
+            }
+        } else if (key == "ring") {
+            opts->ring = atoi(value.c_str());
+            if (opts->ring == 0) {
+                fprintf(stderr, "Invalid number of ring buffers '%s'\n", value.c_str());
+                return false;
+            }
+        } else if (key == "threads") {
+            opts->threads = atoi(value.c_str());
+            if (opts->threads == 0) {
+                fprintf(stderr, "Invalid number of threads '%s'\n", value.c_str());
+                return false;
+            }
+        } else {
+            fprintf(stderr, "Unknown pipeline option '%s'\n", key.c_str());
+            return false;
+        }
+        return true;
+    });
+}
+
+const char * pipeline_engine_name(PipelineEngine engine)
+{
+    switch (engine) {
+        case PIPELINE_HS_STREAM:    return "hs-stream";
+        case PIPELINE_PCRE2_JIT:    return "pcre2-jit";
+        case PIPELINE_READ_ONLY:    return "read-only";
+        default:                    return "none";
+    }
+}
+
+const char * pipeline_input_name(PipelineOptions::Input input)
+{
+    switch (input) {
+        case PipelineOptions::DIRECT:   return "direct";
+        case PipelineOptions::URING:    return "uring";
+        default:                        return "buffered";
+    }
+}
+
+bool pipeline_run(const char * file_name, const std::vector<std::string>& rules, PipelineEngine engine,
+                  const PipelineOptions& opts, PipelineResult * result)
+{
+    std::unique_ptr<Decompressor> source;
+    Ring ring(opts.chunk, opts.overlap, opts.ring);
+    bool ok = false;
+
+    *result = PipelineResult();
+    if (opts.input == PipelineOptions::BUFFERED) {
+        source = Decompressor::open(file_name);
+        if (!source) {
+            return false;
+        }
+    } else if (compress_detect(file_name) != COMPRESS_NONE) {
+        fprintf(stderr, "--pipeline input=%s needs an uncompressed file.\n", pipeline_input_name(opts.input));
+        return false;
+    }
+
+    Producer producer = {file_name, source.get(), &ring, &opts, result, true};
+    Clock::time_point const start = Clock::now();
+    std::thread thread(produce, &producer);
+
+    switch (engine) {
+#ifdef INCLUDE_HYPERSCAN
+        case PIPELINE_HS_STREAM:
+            result->threads = 1;
+            ok = scanHsStream(rules, &ring, result);
+            break;
+#endif
+#ifdef INCLUDE_PCRE2
+        case PIPELINE_PCRE2_JIT:
+            result->threads = opts.threads;
+            ok = scanPcre2Jit(rules, &ring, opts.threads, result);
+            break;
+#endif
+        case PIPELINE_READ_ONLY:
+            result->threads = 1;
+            drop(&ring, result);
+            ok = true;
+            break;
+        default:
+            fprintf(stderr, "Built without the %s pipeline engine.\n", pipeline_engine_name(engine));
+            ring.abort();
+            break;
+    }
+
+    thread.join();
+    result->total = since(start);
+    if (source) {
+        result->file_bytes = source->compressedBytes();
+    }
+    return ok && producer.ok;
+}
@@ -0,0 +1,113 @@
+#ifndef COMPRESS_HPP
+#define COMPRESS_HPP
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * Compressed input files (zstd, lz4 frame), detected by their magic number.
+ * The pipeline decompresses the file in a producer thread into a bounded ring
+ * of reusable chunk buffers while scanner threads consume the chunks, so a
+ * corpus larger than memory can be scanned and the decompression overlaps the
+ * scan. Each chunk starts with the last overlap bytes of the previous one: the
+ * block mode scanners only count the matches that end in the new part and miss
+ * matches longer than the overlap, the stream mode scanner keeps its state
+ * across the chunks and scans the new part only. A plain file can instead be
+ * read with O_DIRECT or io_uring past the page cache, see direct_io.hpp.
+ */
+enum CompressFormat {
+    COMPRESS_NONE,
+    COMPRESS_ZSTD,
+    COMPRESS_LZ4,
+};
+
+class Decompressor {
+public:
+    virtual ~Decompressor();
+
+    /* plain files are passed through, NULL and a message on stderr on errors */
+    static std::unique_ptr<Decompressor> open(const char * file_name);
+
+    /* fills up to cap bytes, less only at the end of the file; -1 on errors */
+    long read(char * out, size_t cap);
+
+    CompressFormat format() const { return fmt; }
+    uint64_t compressedBytes() const { return in_total; }
+
+protected:
+    Decompressor(CompressFormat fmt, FILE * file);
+
+    /* decompresses from in into out, false and a message on stderr on errors */
+    virtual bool step(const char * in, size_t in_len, char * out, size_t out_len, size_t * consumed, size_t * produced) = 0;
+
+    /* false if the file ends inside a frame */
+    virtual bool complete() const { return true; }
+
+private:
+    CompressFormat fmt;
+    FILE * file;
+    std::vector<char> in;
+    size_t in_pos = 0;
+    size_t in_len = 0;
+    uint64_t in_total = 0;
+    bool eof = false;
+};
+
+const char * compress_name(CompressFormat fmt);
+
+CompressFormat compress_detect(const char * file_name);
+
+/* decompresses the whole file, false and a message on stderr on errors */
+bool decompress_file(const char * file_name, std::string * out);
+
+/* compresses generated text with every built-in format and decompresses it again, see --check-compress */
+bool compress_check();
+
+struct PipelineOptions {
+    enum Input {
+        BUFFERED,   /* stdio, zstd and lz4 files are decompressed */
+        DIRECT,     /* O_DIRECT pread() */
+        URING,      /* O_DIRECT reads in flight with io_uring */
+    };
+
+    Input input = BUFFERED;
+    size_t chunk = 4 << 20;     /* decompressed bytes per chunk, rounded up to 4 KB */
+    unsigned int ring = 8;      /* chunk buffers */
+    unsigned int threads = 1;   /* block mode scanners */
+    size_t overlap = 16 << 10;  /* bytes of the previous chunk in front of each chunk */
+};
+
+enum PipelineEngine {
+    PIPELINE_HS_STREAM,     /* one multi-pattern Hyperscan stream, a single scanner */
+    PIPELINE_PCRE2_JIT,     /* every rule in block mode on every chunk */
+    PIPELINE_READ_ONLY,     /* the chunks are dropped unscanned, the reference of the input stage */
+};
+
+struct PipelineResult {
+    uint64_t file_bytes = 0;    /* read from the file, compressed */
+    uint64_t bytes = 0;         /* decompressed */
+    uint64_t chunks = 0;
+    uint64_t matches = 0;
+    double total = 0;           /* ms, wall clock of the whole pipeline */
+    double input = 0;           /* ms the producer spent reading and decompressing, or waiting for io_uring */
+    double scan = 0;            /* ms the scanners spent scanning, summed */
+    double producer_wait = 0;   /* ms the producer waited for a free buffer */
+    double scanner_wait = 0;    /* ms the scanners waited for a chunk, summed */
+    unsigned int threads = 0;
+};
+
+/* parses "input=uring,chunk=4M,ring=8,threads=2,overlap=16K" (buffered, direct, uring) */
+bool pipeline_parse_options(const char * spec, PipelineOptions * opts);
+
+const char * pipeline_engine_name(PipelineEngine engine);
+
+const char * pipeline_input_name(PipelineOptions::Input input);
+
+bool pipeline_run(const char * file_name, const std::vector<std::string>& rules, PipelineEngine engine,
+                  const PipelineOptions& opts, PipelineResult * result);
+
+#endif // COMPRESS_HPP
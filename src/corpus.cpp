@@ -0,0 +1,267 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "corpus.hpp"
+#include "regex_parser.hpp"
+#include "util.hpp"
+
+namespace {
+
+/* xorshift64*, fast and identical on every platform for a given seed */
+class Rng {
+ public:
+    explicit Rng(uint64_t seed) : state(seed ? seed : 0x9E3779B97F4A7C15ULL) {}
+
+    uint64_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1DULL;
+    }
+
+    uint64_t below(uint64_t n) { return n ? next() % n : 0; }
+
+ private:
+    uint64_t state;
+};
+
+/* upper bound of extra iterations for '*', '+' and large {n,m} */
+#define MAX_EXTRA_REPEAT 8
+
+static const char * const words[] = {
+    "the", "of", "and", "to", "in", "was", "he", "that", "it", "his", "her", "with", "as", "had",
+    "for", "you", "not", "be", "at", "on", "by", "said", "all", "they", "but", "from", "this",
+    "which", "were", "there", "river", "house", "morning", "would", "could", "little", "never",
+    "nothing", "something", "through", "before", "after", "again", "without", "everything",
+    "boy", "town", "water", "night", "people", "school", "island", "window", "letter", "money",
+};
+
+static const char * const methods[] = {"GET", "POST", "HEAD", "PUT", "OPTIONS", "DELETE"};
+static const char * const paths[] = {"/", "/index.html", "/login.php", "/api/v1/items", "/cgi-bin/search.cgi",
+                                     "/images/logo.png", "/static/app.js", "/admin/config"};
+static const char * const agents[] = {"Mozilla/5.0 (X11; Linux x86_64)", "curl/7.88.1",
+                                      "Mozilla/5.0 (Windows NT 10.0; Win64; x64)", "python-requests/2.31"};
+
+template <size_t N>
+static const char * pick(const char * const (&list)[N], Rng& rng)
+{
+    return list[rng.below(N)];
+}
+
+static void sample_node(const RegexNode& node, Rng& rng, std::string * out)
+{
+    switch (node.type) {
+        case RegexNode::EMPTY:
+            break;
+
+        case RegexNode::CLASS: {
+            /* prefer printable members, the injected strings should look like the background */
+            unsigned char candidates[256];
+            size_t count = 0;
+
+            for (int c = 0x20; c < 0x7f; c++) {
+                if (node.chars.test(c)) {
+                    candidates[count++] = c;
+                }
+            }
+            if (count == 0) {
+                for (int c = 0; c < 256; c++) {
+                    if (node.chars.test(c)) {
+                        candidates[count++] = c;
+                    }
+                }
+            }
+            if (count > 0) {
+                out->push_back(candidates[rng.below(count)]);
+            }
+            break;
+        }
+
+        case RegexNode::CONCAT:
+            for (const auto& child : node.children) {
+                sample_node(child, rng, out);
+            }
+            break;
+
+        case RegexNode::ALTERNATION:
+            sample_node(node.children[rng.below(node.children.size())], rng, out);
+            break;
+
+        case RegexNode::REPEAT: {
+            int extra = (node.max == -1) ? MAX_EXTRA_REPEAT : node.max - node.min;
+            if (extra > MAX_EXTRA_REPEAT) {
+                extra = MAX_EXTRA_REPEAT;
+            }
+
+            int count = node.min + rng.below(extra + 1);
+            for (int iter = 0; iter < count; iter++) {
+                sample_node(node.children[0], rng, out);
+            }
+            break;
+        }
+
+        case RegexNode::ASSERT:
+            /* line anchors are satisfied by a line break in multiline mode */
+            if (node.assertion == '^' || node.assertion == '$') {
+                out->push_back('\n');
+            } else if (node.assertion == 'b' && !out->empty() &&
+                       (isalnum((unsigned char)out->back()) || out->back() == '_')) {
+                out->push_back(' ');
+            }
+            break;
+    }
+}
+
+static void append_text(std::string * out, size_t len, Rng& rng)
+{
+    size_t const end = out->size() + len;
+
+    while (out->size() < end) {
+        out->append(pick(words, rng));
+
+        uint64_t sep = rng.below(16);
+        if (sep == 0) {
+            out->append(".\n");
+        } else if (sep == 1) {
+            out->append(", ");
+        } else {
+            out->push_back(' ');
+        }
+    }
+    out->resize(end);
+}
+
+static void append_binary(std::string * out, size_t len, Rng& rng)
+{
+    size_t const start = out->size();
+
+    out->resize(start + len);
+    for (size_t iter = 0; iter < len; iter += sizeof(uint64_t)) {
+        uint64_t value = rng.next();
+        memcpy(&(*out)[start + iter], &value, (len - iter) < sizeof(value) ? (len - iter) : sizeof(value));
+    }
+}
+
+static void append_http(std::string * out, size_t len, Rng& rng)
+{
+    size_t const end = out->size() + len;
+    char line[256];
+
+    while (out->size() < end) {
+        snprintf(line, sizeof(line), "%s %s?id=%u HTTP/1.1\r\nHost: www%u.example.com\r\nUser-Agent: %s\r\n"
+                                     "Accept: */*\r\nCookie: session=%016llx\r\nContent-Length: %u\r\n\r\n",
+                 pick(methods, rng), pick(paths, rng), (unsigned)rng.below(100000), (unsigned)rng.below(100),
+                 pick(agents, rng), (unsigned long long)rng.next(), (unsigned)rng.below(4096));
+        out->append(line);
+    }
+    out->resize(end);
+}
+
+}  // namespace
+
+bool corpus_parse_size(const char * value, size_t * size)
+{
+    char * end = NULL;
+    double number = strtod(value, &end);
+
+    if (end == value || number < 0) {
+        return false;
+    }
+
+    switch (*end) {
+        case 'k': case 'K': number *= 1024.0; end++; break;
+        case 'm': case 'M': number *= 1024.0 * 1024; end++; break;
+        case 'g': case 'G': number *= 1024.0 * 1024 * 1024; end++; break;
+        default: break;
+    }
+
+    if (*end != '\0') {
+        return false;
+    }
+
+    *size = (size_t)number;
+    return true;
+}
+
+bool corpus_parse_options(const char * spec, CorpusOptions * opts)
+{
+    return parse_options(spec, [opts](const std::string& key, const std::string& value) {
+        if (key == "size") {
+            if (!corpus_parse_size(value.c_str(), &opts->size) || opts->size == 0) {
+                fprintf(stderr, "Invalid corpus size '%s'\n", value.c_str());
+                return false;
+            }
+        } else if (key == "alphabet") {
+            if (value == "text") {
+                opts->alphabet = CorpusOptions::TEXT;
+            } else if (value == "binary") {
+                opts->alphabet = CorpusOptions::BINARY;
+            } else if (value == "http") {
+                opts->alphabet = CorpusOptions::HTTP;
+            } else {
+                fprintf(stderr, "Unknown corpus alphabet '%s' (text, binary, http)\n", value.c_str());
+                return false;
+            }
+        } else if (key == "rate") {
+            opts->rate = atof(value.c_str());
+        } else if (key == "seed") {
+            opts->seed = strtoull(value.c_str(), NULL, 0);
+        } else {
+            fprintf(stderr, "Unknown corpus option '%s'\n", key.c_str());
+            return false;
+        }
+        return true;
+    });
+}
+
+std::string corpus_generate(const CorpusOptions& opts, const std::vector<std::string>& regexes, CorpusStats * stats)
+{
+    Rng rng(opts.seed);
+    std::vector<RegexNode> rules;
+    std::string out;
+
+    for (const auto& regex : regexes) {
+        RegexNode node;
+        if (regex_parse(regex, &node, NULL)) {
+            rules.push_back(std::move(node));
+        }
+    }
+
+    stats->sampleable_rules = rules.size();
+    stats->injected = 0;
+
+    if (opts.rate > 0 && rules.empty()) {
+        fprintf(stderr, "WARNING: no rule can be sampled, the corpus contains no injected matches\n");
+    }
+
+    /* average distance between two injected matches */
+    double const gap = (opts.rate > 0 && !rules.empty()) ? 1024.0 / opts.rate : (double)opts.size;
+
+    out.reserve(opts.size + 4096);
+
+    while (out.size() < opts.size) {
+        size_t len = (size_t)(rng.below((uint64_t)(2 * gap) + 1));
+        if (len > opts.size - out.size()) {
+            len = opts.size - out.size();
+        }
+
+        switch (opts.alphabet) {
+            case CorpusOptions::TEXT:   append_text(&out, len, rng); break;
+            case CorpusOptions::BINARY: append_binary(&out, len, rng); break;
+            case CorpusOptions::HTTP:   append_http(&out, len, rng); break;
+        }
+
+        if (out.size() < opts.size && opts.rate > 0 && !rules.empty()) {
+            sample_node(rules[rng.below(rules.size())], rng, &out);
+            /* the last string may be cut off by the final resize, it is no match then */
+            if (out.size() <= opts.size) {
+                stats->injected++;
+            }
+        }
+    }
+
+    out.resize(opts.size);
+    return out;
+}
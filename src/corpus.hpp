@@ -0,0 +1,39 @@
+#ifndef CORPUS_HPP
+#define CORPUS_HPP
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/*
+ * Deterministic synthetic input data. A background of the selected alphabet is
+ * generated and strings sampled from the loaded rules are injected at random
+ * positions, so throughput can be measured as a function of the match density.
+ */
+struct CorpusOptions {
+    enum Alphabet {
+        TEXT,
+        BINARY,
+        HTTP,
+    };
+
+    size_t size = 16 << 20;
+    Alphabet alphabet = TEXT;
+    double rate = 0;        /* injected matches per KB */
+    uint64_t seed = 1;
+};
+
+struct CorpusStats {
+    size_t injected = 0;
+    size_t sampleable_rules = 0;
+};
+
+/* parses "512k", "64M", "1G" */
+bool corpus_parse_size(const char * value, size_t * size);
+
+/* parses "size=64M,alphabet=http,rate=0.5,seed=7" */
+bool corpus_parse_options(const char * spec, CorpusOptions * opts);
+
+std::string corpus_generate(const CorpusOptions& opts, const std::vector<std::string>& regexes, CorpusStats * stats);
+
+#endif // CORPUS_HPP
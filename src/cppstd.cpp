@@ -6,36 +6,43 @@
 #include <iostream>
 
 
-static int search_all( std::regex& rx, const std::string& text )
+static uint64_t search_all( std::regex& rx, const std::string& text )
 {
+    if (regex_is_match) {
+        return std::regex_search( text, rx );
+    }
+
     auto words_begin = std::sregex_iterator( text.begin(), text.end(), rx );
     auto words_end = std::sregex_iterator();
     return std::distance(words_begin, words_end);    
 }
 
-extern "C" int cppstd_find_all(char* pattern, char* subject, int subject_len, int repeat, struct result * res)
+extern "C" int cppstd_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res)
 {
     TIME_TYPE start, end = 0;
-    int found = 0;
+    uint64_t found = 0;
 
     try {
-        std::regex rx(pattern,std::regex::optimize);//|std::regex::extended);
+        /* ECMAScript has no inline flags, a leading "(?i)" becomes icase like the YARA nocase modifier */
+        bool const leading_i = strncmp(pattern, "(?i)", 4) == 0;
+        std::regex::flag_type const icase = (regex_caseless == CASE_NATIVE || leading_i) ? std::regex::icase : std::regex::flag_type();
+        std::regex rx(leading_i ? pattern + 4 : pattern,std::regex::optimize | icase);//|std::regex::extended);
         std::string text( subject, subject_len );
 
         double * times = (double*) std::calloc(repeat, sizeof(double));
         int const times_len = repeat;
 
         do {
-            GET_TIME(start);
+            START_SCAN_TIME(start);
             found = search_all( rx, text );
-            GET_TIME(end);
+            STOP_SCAN_TIME(end);
             times[repeat - 1] = TIME_DIFF_IN_MS(start, end);
 
         } while (--repeat > 0);
 
 
         res->matches = found;
-        get_mean_and_derivation(times, times_len, res);
+        get_mean_and_derivation(0, times, times_len, res);
 
         free(times);
     } catch ( std::exception& ex ) {
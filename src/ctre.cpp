@@ -7,15 +7,17 @@
 #include "main.h"
 #include <ctre.hpp>
 
-using RegexFn = std::function<int(const std::string_view &)>;
+using RegexFn = std::function<uint64_t(const std::string_view &)>;
 using RegexMap = std::unordered_map<std::string, RegexFn>;
 
 #define ENTRY(STR)                                  \
     {                                               \
         STR,                                        \
-            [](const std::string_view &sv) -> int   \
+            [](const std::string_view &sv) -> uint64_t \
         {                                           \
-            int cnt = 0;                            \
+            if (regex_is_match)                     \
+                return bool(ctre::search<STR>(sv)); \
+            uint64_t cnt = 0;                       \
             for (auto match : ctre::range<STR>(sv)) \
                 cnt++;                              \
             return cnt;                             \
@@ -44,10 +46,10 @@ RegexMap remap = {
     // ENTRY("\\p{Sm}")
 };
 
-extern "C" int ctre_find_all(char *pattern, char *subject, int subject_len, int repeat, struct result *res)
+extern "C" int ctre_find_all(const char *pattern, const char *subject, size_t subject_len, int repeat, struct result *res)
 {
     TIME_TYPE start, end = 0;
-    int found = 0;
+    uint64_t found = 0;
 
     std::string text(subject, subject_len);
     RegexMap::const_iterator it = remap.find(pattern);
@@ -59,15 +61,15 @@ extern "C" int ctre_find_all(char *pattern, char *subject, int subject_len, int
 
         do
         {
-            GET_TIME(start);
+            START_SCAN_TIME(start);
             found = it->second(text);
-            GET_TIME(end);
+            STOP_SCAN_TIME(end);
             times[repeat - 1] = TIME_DIFF_IN_MS(start, end);
 
         } while (--repeat > 0);
 
         res->matches = found;
-        get_mean_and_derivation(times, times_len, res);
+        get_mean_and_derivation(0, times, times_len, res);
 
         free(times);
     }
@@ -0,0 +1,179 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <chrono>
+#include <deque>
+
+#include "direct_io.hpp"
+#include "util.hpp"
+
+#ifdef INCLUDE_URING
+#include <liburing.h>
+#endif
+
+namespace {
+
+static bool readSync(int fd, uint64_t size, Ring * ring, PipelineResult * result)
+{
+    uint64_t offset = 0;
+
+    while (offset < size) {
+        Slot * const slot = ring->acquire(&result->producer_wait);
+        if (!slot) {
+            return true;
+        }
+
+        Clock::time_point const start = Clock::now();
+        ssize_t const len = pread(fd, slot->fresh, ring->chunk(), offset);
+        result->input += since(start);
+
+        if (len <= 0) {
+            fprintf(stderr, "ERROR: Read failed at offset %llu: %s\n", (unsigned long long)offset,
+                    len < 0 ? strerror(errno) : "unexpected end of file");
+            ring->release(slot);
+            return false;
+        }
+        offset += len;
+        result->bytes += len;
+        result->chunks++;
+        ring->push(slot, len);
+    }
+    return true;
+}
+
+#ifdef INCLUDE_URING
+struct Read {
+    Slot * slot;
+    uint64_t offset;
+    int res;
+    bool done;
+};
+
+/* the reads complete in any order, a chunk is queued once all chunks before it are */
+static bool readUring(int fd, uint64_t size, Ring * ring, PipelineResult * result)
+{
+    struct io_uring uring;
+    std::deque<Read> inflight;      /* push_back and pop_front keep the other elements in place */
+    uint64_t offset = 0;
+    bool ok = true;
+
+    int const err = io_uring_queue_init(ring->size(), &uring, 0);
+    if (err < 0) {
+        fprintf(stderr, "ERROR: io_uring_queue_init() failed: %s\n", strerror(-err));
+        return false;
+    }
+
+    while (true) {
+        unsigned int queued = 0;
+
+        while (ok && offset < size && inflight.size() < ring->size()) {
+            Slot * const slot = inflight.empty() ? ring->acquire(&result->producer_wait) : ring->tryAcquire();
+            if (!slot) {
+                break;
+            }
+
+            struct io_uring_sqe * const sqe = io_uring_get_sqe(&uring);
+            io_uring_prep_read(sqe, fd, slot->fresh, ring->chunk(), offset);
+            inflight.push_back({slot, offset, 0, false});
+            io_uring_sqe_set_data(sqe, &inflight.back());
+            offset += ring->chunk();
+            queued++;
+        }
+        if (queued > 0) {
+            io_uring_submit(&uring);
+        }
+        if (inflight.empty()) {
+            break;
+        }
+
+        struct io_uring_cqe * cqe = NULL;
+        Clock::time_point const start = Clock::now();
+        int const wait = io_uring_wait_cqe(&uring, &cqe);
+        result->input += since(start);
+        if (wait < 0) {
+            fprintf(stderr, "ERROR: io_uring_wait_cqe() failed: %s\n", strerror(-wait));
+            ok = false;
+            break;
+        }
+        Read * const read = static_cast<Read *>(io_uring_cqe_get_data(cqe));
+        read->res = cqe->res;
+        read->done = true;
+        io_uring_cqe_seen(&uring, cqe);
+
+        while (!inflight.empty() && inflight.front().done) {
+            Read const done = inflight.front();
+            inflight.pop_front();
+
+            /* only the last chunk may be short */
+            bool const complete = done.res > 0 && ((size_t)done.res == ring->chunk() || done.offset + done.res == size);
+            if (ok && !complete) {
+                fprintf(stderr, "ERROR: Read failed at offset %llu: %s\n", (unsigned long long)done.offset,
+                        done.res < 0 ? strerror(-done.res) : "short read");
+                ok = false;
+            }
+            if (!ok || ring->aborted()) {
+                ring->release(done.slot);
+                continue;
+            }
+            result->bytes += done.res;
+            result->chunks++;
+            ring->push(done.slot, done.res);
+        }
+    }
+
+    /* the buffers of the reads still in flight must not be reused */
+    while (!inflight.empty()) {
+        struct io_uring_cqe * cqe = NULL;
+        if (io_uring_wait_cqe(&uring, &cqe) < 0) {
+            break;
+        }
+        static_cast<Read *>(io_uring_cqe_get_data(cqe))->done = true;
+        io_uring_cqe_seen(&uring, cqe);
+        while (!inflight.empty() && inflight.front().done) {
+            ring->release(inflight.front().slot);
+            inflight.pop_front();
+        }
+    }
+
+    io_uring_queue_exit(&uring);
+    return ok;
+}
+#endif
+
+}  // namespace
+
+bool direct_read(const char * file_name, bool uring, Ring * ring, PipelineResult * result)
+{
+    struct stat st;
+    bool ok = false;
+
+    int const fd = open(file_name, O_RDONLY | O_DIRECT);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open '%s' with O_DIRECT: %s\n", file_name, strerror(errno));
+    } else if (fstat(fd, &st) != 0) {
+        fprintf(stderr, "Cannot stat '%s': %s\n", file_name, strerror(errno));
+    } else if (uring) {
+#ifdef INCLUDE_URING
+        result->file_bytes = st.st_size;
+        ok = readUring(fd, st.st_size, ring, result);
+#else
+        fprintf(stderr, "Built without io_uring support.\n");
+#endif
+    } else {
+        result->file_bytes = st.st_size;
+        ok = readSync(fd, st.st_size, ring, result);
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (ok) {
+        ring->finish();
+    } else {
+        ring->abort();
+    }
+    return ok;
+}
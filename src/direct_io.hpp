@@ -0,0 +1,17 @@
+#ifndef DIRECT_IO_HPP
+#define DIRECT_IO_HPP
+
+#include "compress.hpp"
+#include "ring.hpp"
+
+/*
+ * Producer of an input pipeline that reads a plain file with O_DIRECT, so a
+ * corpus larger than memory neither goes through nor evicts the page cache.
+ * Without io_uring the producer reads one chunk at a time with pread() while
+ * the scanners work on the chunks already queued. With io_uring every free
+ * buffer of the ring gets a read in flight, the completions are queued in file
+ * order. Runs in the calling thread, finishes or aborts the ring at the end.
+ */
+bool direct_read(const char * file_name, bool uring, Ring * ring, PipelineResult * result);
+
+#endif // DIRECT_IO_HPP
@@ -0,0 +1,210 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#include "main.h"
+
+#define SIBLING_SAMPLE_US   200000
+#define SIBLING_LOAD_LIMIT  0.05
+
+static int read_sysfs(const char * path, char * buf, size_t buf_len)
+{
+    FILE * f = fopen(path, "r");
+    if (!f) {
+        return -1;
+    }
+
+    if (!fgets(buf, buf_len, f)) {
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+
+    buf[strcspn(buf, "\n")] = '\0';
+    return 0;
+}
+
+/* reads busy and total jiffies of one cpu from /proc/stat */
+static int read_cpu_jiffies(int cpu, unsigned long long * busy, unsigned long long * total)
+{
+    char line[256];
+    char name[16];
+    int found = -1;
+
+    FILE * f = fopen("/proc/stat", "r");
+    if (!f) {
+        return -1;
+    }
+
+    snprintf(name, sizeof(name), "cpu%d ", cpu);
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long long user, nice, sys, idle, iowait, irq, softirq, steal;
+
+        if (strncmp(line, name, strlen(name)) != 0) {
+            continue;
+        }
+
+        if (sscanf(line + strlen(name), "%llu %llu %llu %llu %llu %llu %llu %llu",
+                   &user, &nice, &sys, &idle, &iowait, &irq, &softirq, &steal) == 8) {
+            *busy = user + nice + sys + irq + softirq + steal;
+            *total = *busy + idle + iowait;
+            found = 0;
+        }
+        break;
+    }
+
+    fclose(f);
+    return found;
+}
+
+/* parses a sysfs cpu list like "0,64" or "0-1" into cpus[] */
+static int parse_cpu_list(const char * list, int * cpus, int max_cpus)
+{
+    int count = 0;
+    const char * ptr = list;
+
+    while (*ptr && count < max_cpus) {
+        int first, last, len;
+
+        if (sscanf(ptr, "%d-%d%n", &first, &last, &len) != 2) {
+            if (sscanf(ptr, "%d%n", &first, &len) != 1) {
+                break;
+            }
+            last = first;
+        }
+
+        for (int cpu = first; cpu <= last && count < max_cpus; cpu++) {
+            cpus[count++] = cpu;
+        }
+
+        ptr += len;
+        if (*ptr == ',') {
+            ptr++;
+        }
+    }
+
+    return count;
+}
+
+int env_pin_cpu(int cpu)
+{
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        perror("sched_setaffinity");
+        return -1;
+    }
+
+    return 0;
+}
+
+int env_set_fifo(int priority)
+{
+    struct sched_param param = {0};
+
+    param.sched_priority = priority;
+    if (sched_setscheduler(0, SCHED_FIFO, &param) != 0) {
+        perror("sched_setscheduler(SCHED_FIFO)");
+        return -1;
+    }
+
+    return 0;
+}
+
+int env_lock_memory(void)
+{
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        perror("mlockall");
+        return -1;
+    }
+
+    return 0;
+}
+
+void env_check(struct env_info * env)
+{
+    char path[128];
+    char buf[128];
+    int cpu = env->cpu >= 0 ? env->cpu : sched_getcpu();
+
+    /* frequency scaling */
+    strcpy(env->governor, "unknown");
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_governor", cpu);
+    if (read_sysfs(path, buf, sizeof(buf)) == 0) {
+        snprintf(env->governor, sizeof(env->governor), "%.31s", buf);
+        if (strcmp(buf, "performance") != 0) {
+            fprintf(stderr, "WARNING: cpu%d uses frequency governor '%s', results may vary. Use 'performance'.\n", cpu, buf);
+        }
+    }
+
+    /* turbo / boost */
+    env->turbo = -1;
+    if (read_sysfs("/sys/devices/system/cpu/intel_pstate/no_turbo", buf, sizeof(buf)) == 0) {
+        env->turbo = (atoi(buf) == 0);
+    } else if (read_sysfs("/sys/devices/system/cpu/cpufreq/boost", buf, sizeof(buf)) == 0) {
+        env->turbo = (atoi(buf) != 0);
+    }
+    if (env->turbo == 1) {
+        fprintf(stderr, "WARNING: turbo/boost is enabled, results may vary.\n");
+    }
+
+    /* load on SMT siblings sharing the core with the benchmark thread */
+    env->smt_siblings = 0;
+    env->sibling_load = 0;
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+    if (read_sysfs(path, buf, sizeof(buf)) == 0) {
+        int siblings[16];
+        unsigned long long busy[16] = {0}, total[16] = {0};
+        int count = parse_cpu_list(buf, siblings, 16);
+
+        for (int iter = 0; iter < count; iter++) {
+            read_cpu_jiffies(siblings[iter], &busy[iter], &total[iter]);
+        }
+
+        usleep(SIBLING_SAMPLE_US);
+
+        for (int iter = 0; iter < count; iter++) {
+            unsigned long long busy_now = 0, total_now = 0;
+
+            if (siblings[iter] == cpu || read_cpu_jiffies(siblings[iter], &busy_now, &total_now) != 0) {
+                continue;
+            }
+
+            env->smt_siblings++;
+            if (total_now > total[iter]) {
+                double load = (double)(busy_now - busy[iter]) / (total_now - total[iter]);
+                if (load > env->sibling_load) {
+                    env->sibling_load = load;
+                }
+            }
+        }
+
+        if (env->sibling_load > SIBLING_LOAD_LIMIT) {
+            fprintf(stderr, "WARNING: SMT sibling of cpu%d is %.0f %% busy, results may vary.\n", cpu, env->sibling_load * 100);
+        }
+    }
+
+    env->trusted = env->cpu >= 0 &&
+                   (strcmp(env->governor, "performance") == 0 || strcmp(env->governor, "unknown") == 0) &&
+                   env->turbo != 1 &&
+                   env->sibling_load <= SIBLING_LOAD_LIMIT;
+}
+
+void env_print(FILE * f, const struct env_info * env, const char * prefix)
+{
+    fprintf(f, "%senv.cpu=%d\n", prefix, env->cpu);
+    fprintf(f, "%senv.fifo_priority=%d\n", prefix, env->fifo_priority);
+    fprintf(f, "%senv.mlock=%d\n", prefix, env->mlocked);
+    fprintf(f, "%senv.interleave=%d\n", prefix, env->interleaved);
+    fprintf(f, "%senv.governor=%s\n", prefix, env->governor);
+    fprintf(f, "%senv.turbo=%d\n", prefix, env->turbo);
+    fprintf(f, "%senv.smt_siblings=%d\n", prefix, env->smt_siblings);
+    fprintf(f, "%senv.sibling_load=%.2f\n", prefix, env->sibling_load);
+    fprintf(f, "%senv.trusted=%d\n", prefix, env->trusted);
+}
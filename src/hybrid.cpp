@@ -0,0 +1,341 @@
+#include <stdio.h>
+#include <limits.h>
+#include <memory>
+#include <vector>
+
+#include "hyperscan.hpp"
+#include "main.h"
+#include <hs/hs.h>
+
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include <pcre2.h>
+
+/* upper bound of the confirmation window before and after a prefilter hit */
+#define HYBRID_MAX_WINDOW   (64 * 1024)
+/* extra context for lookarounds, they are not part of the prefilter width */
+#define HYBRID_CONTEXT      256
+
+namespace {
+
+enum RuleKind {
+    NATIVE,
+    PREFILTER,
+    FALLBACK,
+    UNSUPPORTED,
+};
+
+struct Rule {
+    RuleKind kind = UNSUPPORTED;
+    pcre2_code * re = nullptr;
+    size_t window = 0;
+    /* per block: confirmed up to this offset */
+    size_t scanned_to = 0;
+    size_t checked_to = 0;
+};
+
+struct ScanContext {
+    std::vector<Rule> * rules;
+    const char * subject;
+    size_t subject_len;
+    pcre2_match_data * match_data;
+    pcre2_match_context * match_ctx;
+    struct hybrid_stats * stats;
+    uint64_t found;
+};
+
+/*
+ * Counts the non-overlapping matches of re that start in subject[start, end].
+ * The whole subject stays visible, so lookarounds and a match running past
+ * the window behave as in a full scan. The offset limit stops the search for
+ * a match start at the end of the window.
+ */
+static uint64_t confirm(pcre2_code * re, const char * subject, size_t subject_len, size_t start, size_t end,
+                        pcre2_match_data * match_data, pcre2_match_context * match_ctx, size_t * last_end)
+{
+    PCRE2_SIZE * ovector = pcre2_get_ovector_pointer(match_data);
+    uint64_t found = 0;
+
+    pcre2_set_offset_limit(match_ctx, end);
+    while (start <= end) {
+        int rc = pcre2_jit_match(re, (PCRE2_SPTR8)subject, subject_len, start, 0, match_data, match_ctx);
+        if (rc < 0) {
+            break;
+        }
+
+        found++;
+        *last_end = ovector[1];
+        if (regex_is_match) {
+            break;
+        }
+        start = (ovector[1] > ovector[0]) ? ovector[1] : ovector[1] + 1;
+    }
+
+    return found;
+}
+
+static int onMatch(unsigned int id, UNUSED unsigned long long from, unsigned long long to,
+                   UNUSED unsigned int flags, void * context)
+{
+    ScanContext * ctx = static_cast<ScanContext *>(context);
+    Rule& rule = (*ctx->rules)[id];
+
+    /* a non-zero return stops the scan, one match is enough for --is-match */
+    if (rule.kind == NATIVE) {
+        ctx->found++;
+        return regex_is_match;
+    }
+
+    ctx->stats->prefilter_hits++;
+
+    /* a match ending here was visible to the previous window of this rule */
+    if (to <= rule.checked_to) {
+        return 0;
+    }
+
+    size_t start = (to > rule.window) ? to - rule.window : 0;
+    size_t end = to + rule.window;
+    if (start < rule.scanned_to) {
+        start = rule.scanned_to;
+    }
+    if (end > ctx->subject_len) {
+        end = ctx->subject_len;
+    }
+
+    ctx->stats->confirms++;
+    uint64_t const confirmed = confirm(rule.re, ctx->subject, ctx->subject_len, start, end,
+                                       ctx->match_data, ctx->match_ctx, &rule.scanned_to);
+    ctx->stats->confirmed_matches += confirmed;
+    ctx->found += confirmed;
+    rule.checked_to = end;
+    /* every start offset up to the end of the window was tried */
+    if (rule.scanned_to <= end) {
+        rule.scanned_to = end + 1;
+    }
+
+    return regex_is_match && confirmed > 0;
+}
+
+static pcre2_code * compile_pcre2(const char * pattern)
+{
+    int err_code;
+    PCRE2_SIZE err_offset;
+
+    pcre2_code * re = pcre2_compile((PCRE2_SPTR8)pattern, PCRE2_ZERO_TERMINATED,
+                                    PCRE2_USE_OFFSET_LIMIT | pcre2_option_flags(),
+                                    &err_code, &err_offset, NULL);
+    if (!re) {
+        return nullptr;
+    }
+    if (pcre2_jit_compile(re, PCRE2_JIT_COMPLETE) != 0) {
+        pcre2_code_free(re);
+        return nullptr;
+    }
+    return re;
+}
+
+/* the expression info alone misses late errors such as "Pattern is too large" */
+static bool hs_accepts(const char * pattern, unsigned flags, hs_expr_info_t ** info)
+{
+    hs_compile_error_t * compile_err = NULL;
+    hs_database_t * database = NULL;
+
+    if (hs_compile(pattern, flags, HS_MODE_BLOCK, NULL, &database, &compile_err) != HS_SUCCESS) {
+        hs_free_compile_error(compile_err);
+        return false;
+    }
+    hs_free_database(database);
+
+    if (hs_expression_info(pattern, flags, info, &compile_err) != HS_SUCCESS) {
+        hs_free_compile_error(compile_err);
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+/*
+ * Scans the complete rule set: rules Hyperscan supports are matched natively,
+ * rejected rules are compiled with HS_FLAG_PREFILTER into the same database and
+ * every prefilter hit is confirmed by PCRE2-JIT on a bounded window around the
+ * reported end offset. Rules that cannot be prefiltered either are scanned by
+ * PCRE2-JIT over the whole input.
+ */
+static int hybrid_find_all(const char ** pattern, int pattern_num, const struct blocks * blocks, int repeat,
+                           struct result * res, struct hybrid_stats * stats)
+{
+    unsigned const native_flags = HS_FLAG_DOTALL | HS_FLAG_MULTILINE | HS_FLAG_SOM_LEFTMOST | hs_option_flags();
+    /* prefiltering does not support SOM_LEFTMOST */
+    unsigned const prefilter_flags = HS_FLAG_DOTALL | HS_FLAG_MULTILINE | HS_FLAG_PREFILTER | hs_option_flags();
+    TIME_TYPE start, end;
+    std::vector<Rule> rules(pattern_num);
+    std::vector<const char *> hs_patterns;
+    std::vector<unsigned> hs_flags;
+    std::vector<unsigned> hs_ids;
+    std::vector<int> fallback;
+    hs_database_t * database = NULL;
+    hs_scratch_t * scratch = NULL;
+    bool chunked = false;
+    int ret = -1;
+
+    /* blocks above 4 GB need a stream mode database */
+    for (size_t iter = 0; iter < blocks->count; iter++) {
+        chunked |= blocks->len[iter] > HS_MAX_SCAN_LEN;
+    }
+
+    *stats = (struct hybrid_stats){};
+
+    double pre_times = 0;
+    GET_TIME(start);
+
+    for (int iter = 0; iter < pattern_num; iter++) {
+        Rule& rule = rules[iter];
+        hs_expr_info_t * info = NULL;
+
+        if (hs_accepts(pattern[iter], native_flags, &info)) {
+            rule.kind = NATIVE;
+            stats->native++;
+        } else if (hs_accepts(pattern[iter], prefilter_flags, &info) && (rule.re = compile_pcre2(pattern[iter]))) {
+            rule.kind = PREFILTER;
+            rule.window = (info->max_width < HYBRID_MAX_WINDOW ? info->max_width : HYBRID_MAX_WINDOW) + HYBRID_CONTEXT;
+            stats->prefiltered++;
+            /* unbounded or wider than the window: a longer match is only found from a later hit */
+            stats->capped += info->max_width > HYBRID_MAX_WINDOW;
+        } else if ((rule.re = compile_pcre2(pattern[iter]))) {
+            rule.kind = FALLBACK;
+            fallback.push_back(iter);
+            stats->fallback++;
+        } else {
+            stats->unsupported++;
+        }
+        free(info);
+
+        if (rule.kind == NATIVE || rule.kind == PREFILTER) {
+            hs_patterns.push_back(pattern[iter]);
+            hs_flags.push_back(rule.kind == NATIVE ? native_flags : prefilter_flags);
+            hs_ids.push_back(iter);
+        }
+    }
+
+    if (!hs_patterns.empty()) {
+        hs_compile_error_t * compile_err;
+        if (hs_compile_multi(hs_patterns.data(), hs_flags.data(), hs_ids.data(), hs_patterns.size(),
+                             chunked ? (HS_MODE_STREAM | HS_MODE_SOM_HORIZON_LARGE) : HS_MODE_BLOCK,
+                             NULL, &database, &compile_err) != HS_SUCCESS) {
+            fprintf(stderr, "ERROR: Unable to compile patterns: '%s'\n", compile_err->message);
+            hs_free_compile_error(compile_err);
+            goto out;
+        }
+        if (hs_alloc_scratch(database, &scratch) != HS_SUCCESS) {
+            fprintf(stderr, "ERROR: Unable to allocate scratch space. Exiting.\n");
+            goto out;
+        }
+    }
+
+    {
+        pcre2_match_data * match_data = pcre2_match_data_create(1, NULL);
+        pcre2_match_context * match_ctx = pcre2_match_context_create(NULL);
+        pcre2_jit_stack * stack = pcre2_jit_stack_create(32 * 1024, 512 * 1024, NULL);
+        if (!match_data || !match_ctx || !stack) {
+            fprintf(stderr, "ERROR: Unable to allocate PCRE2 match data. Exiting.\n");
+            pcre2_match_data_free(match_data);
+            pcre2_match_context_free(match_ctx);
+            pcre2_jit_stack_free(stack);
+            goto out;
+        }
+        pcre2_jit_stack_assign(match_ctx, NULL, stack);
+
+        GET_TIME(end);
+        pre_times = TIME_DIFF_IN_MS(start, end);
+
+        auto times = std::unique_ptr<double[]>(new double[repeat]);
+        int const times_len = repeat;
+        ScanContext ctx = {&rules, NULL, 0, match_data, match_ctx, stats, 0};
+        hs_error_t err = HS_SUCCESS;
+
+        do {
+            ctx.found = 0;
+            stats->prefilter_hits = 0;
+            stats->confirms = 0;
+            stats->confirmed_matches = 0;
+            stats->fallback_matches = 0;
+
+            START_SCAN_TIME(start);
+            for (size_t block = 0; block < blocks->count && err == HS_SUCCESS; block++) {
+                uint64_t const block_start = ctx.found;
+
+                ctx.subject = blocks->data[block];
+                ctx.subject_len = blocks->len[block];
+                for (auto& rule : rules) {
+                    rule.scanned_to = 0;
+                    rule.checked_to = 0;
+                }
+
+                if (database && chunked) {
+                    err = hs_scan_chunked(database, ctx.subject, ctx.subject_len, scratch, onMatch, &ctx);
+                } else if (database) {
+                    err = hs_scan(database, ctx.subject, ctx.subject_len, 0, scratch, onMatch, &ctx);
+                }
+                if (err == HS_SCAN_TERMINATED) {
+                    err = HS_SUCCESS;
+                }
+
+                for (int id : fallback) {
+                    size_t last_end = 0;
+                    if (regex_is_match && ctx.found > block_start) {
+                        break;
+                    }
+                    uint64_t const matches = confirm(rules[id].re, ctx.subject, ctx.subject_len, 0, ctx.subject_len,
+                                                     match_data, match_ctx, &last_end);
+                    stats->fallback_matches += matches;
+                    ctx.found += matches;
+                }
+                if (regex_is_match) {
+                    ctx.found = block_start + (ctx.found > block_start);
+                }
+            }
+            STOP_SCAN_TIME(end);
+
+            if (err != HS_SUCCESS) {
+                fprintf(stderr, "ERROR: Unable to scan input buffer. Exiting.\n");
+                break;
+            }
+
+            times[repeat - 1] = TIME_DIFF_IN_MS(start, end);
+        } while (--repeat > 0);
+
+        pcre2_jit_stack_free(stack);
+        pcre2_match_context_free(match_ctx);
+        pcre2_match_data_free(match_data);
+
+        if (err == HS_SUCCESS) {
+            res->matches = ctx.found;
+            get_mean_and_derivation(pre_times, times.get(), times_len, res);
+            ret = 0;
+        }
+    }
+
+out:
+    for (auto& rule : rules) {
+        pcre2_code_free(rule.re);
+    }
+    hs_free_scratch(scratch);
+    hs_free_database(database);
+
+    return ret;
+}
+
+int hybrid_multi_find_all(const char ** pattern, int pattern_num, const char * subject, size_t subject_len
+                        , int repeat, struct result * res, struct hybrid_stats * stats)
+{
+    unsigned int const flow = 0;
+    struct blocks const blocks = {&subject, &subject_len, &flow, 1, 1, subject_len};
+
+    return hybrid_find_all(pattern, pattern_num, &blocks, repeat, res, stats);
+}
+
+int hybrid_multi_find_all_blocks(const char ** pattern, int pattern_num, const struct blocks * blocks
+                        , int repeat, struct result * res, struct hybrid_stats * stats)
+{
+    return hybrid_find_all(pattern, pattern_num, blocks, repeat, res, stats);
+}
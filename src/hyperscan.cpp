@@ -1,22 +1,21 @@
 #include <stdio.h>
+#include <limits.h>
 #include <memory>
+#include <algorithm>
 #include <cstring>
+#include <string>
+#include <vector>
 
+#include "hyperscan.hpp"
 #include "hyperscan_new.hpp"
 #include "main.h"
+#include "regex_parser.hpp"
 #include <hs/hs.h>
 
-static int found = 0;
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include <pcre2.h>
 
-static int eventHandler(UNUSED unsigned int  id,
-                        UNUSED unsigned long long from,
-                        UNUSED unsigned long long to,
-                        UNUSED unsigned int flags,
-                        UNUSED void * ctx) {
-    fprintf(stdout, "Match for pattern \"%s\" at offset %llu:%llu\n", (char*)ctx, from, to);
-    found++;
-    return 0;
-}
+static uint64_t found = 0;
 
 static int eventHandlerMulti(UNUSED unsigned int  id,
                         UNUSED unsigned long long from,
@@ -26,15 +25,47 @@ static int eventHandlerMulti(UNUSED unsigned int  id,
     const char ** patterns = (const char**)ctx;
     fprintf(stdout, "%s Match for pattern \"%s\" at offset %llu:%llu\n", __func__, *(patterns+id), from, to);
     found++;
-    return 0;
+    /* --is-match: a non-zero return stops the scan at the first match */
+    return regex_is_match;
+}
+
+/* HS_FLAG_UTF8 assumes valid UTF-8 input, the corpora are mostly ASCII text */
+unsigned hs_option_flags(void)
+{
+    unsigned flags = (regex_encoding == ENC_UTF8) ? HS_FLAG_UTF8 | HS_FLAG_UCP : 0;
+
+    if (regex_caseless == CASE_NATIVE) {
+        flags |= HS_FLAG_CASELESS;
+    }
+    return flags;
+}
+
+uint32_t pcre2_option_flags(void)
+{
+    uint32_t flags = PCRE2_MULTILINE | PCRE2_DOTALL;
+
+    if (regex_encoding == ENC_UTF8) {
+        flags |= PCRE2_UTF | PCRE2_UCP | PCRE2_MATCH_INVALID_UTF;
+    }
+    if (regex_caseless == CASE_NATIVE) {
+        flags |= PCRE2_CASELESS;
+    }
+    return flags;
+}
+
+/* databases, scratch and streams come from the allocator of --allocator, compile errors and infos stay on malloc */
+void hs_use_allocator(void)
+{
+    hs_set_database_allocator(alloc_malloc, alloc_free);
+    hs_set_scratch_allocator(alloc_malloc, alloc_free);
+    hs_set_stream_allocator(alloc_malloc, alloc_free);
 }
 
 bool hs_verify_regex(const char* pattern) {
     hs_database_t * database;
     hs_compile_error_t * compile_err;
     if (hs_compile(pattern, 
-                    HS_FLAG_DOTALL | HS_FLAG_MULTILINE | HS_FLAG_SOM_LEFTMOST,
-                    // HS_FLAG_CASELESS, 
+                    HS_FLAG_DOTALL | HS_FLAG_MULTILINE | HS_FLAG_SOM_LEFTMOST | hs_option_flags(),
                     HS_MODE_BLOCK, 
                     NULL, 
                     &database, 
@@ -49,86 +80,51 @@ bool hs_verify_regex(const char* pattern) {
     return true;
 }
 
-int hs_find_all(const char* pattern, const char* subject, int subject_len, int repeat, struct result * res)
+hs_error_t hs_scan_chunked(const hs_database_t * database, const char * data, size_t len, hs_scratch_t * scratch,
+                           match_event_handler on_event, void * ctx)
 {
-    TIME_TYPE start, end;
-    hs_database_t * database;
+    hs_stream_t * stream = NULL;
+    hs_error_t err = hs_open_stream(database, 0, &stream);
 
-    double pre_times = 0;
-    GET_TIME(start);
-
-    hs_compile_error_t * compile_err;
-    if (hs_compile(pattern, 
-                    HS_FLAG_DOTALL | HS_FLAG_MULTILINE | HS_FLAG_SOM_LEFTMOST, 
-                    HS_MODE_BLOCK, 
-                    NULL, 
-                    &database, 
-                    &compile_err) != HS_SUCCESS) {
-        fprintf(stderr, "ERROR: Unable to compile pattern \"%s\": %s\n",
-                pattern, compile_err->message);
-        hs_free_compile_error(compile_err);
-        return -1;
+    if (err != HS_SUCCESS) {
+        return err;
     }
 
-    hs_scratch_t * scratch = NULL;
-    if (hs_alloc_scratch(database, &scratch) != HS_SUCCESS) {
-        fprintf(stderr, "ERROR: Unable to allocate scratch space. Exiting.\n");
-        hs_free_database(database);
-        return -1;
+    for (size_t offset = 0; offset < len && err == HS_SUCCESS; offset += HS_CHUNK_LEN) {
+        size_t const chunk = (len - offset < HS_CHUNK_LEN) ? len - offset : HS_CHUNK_LEN;
+        err = hs_scan_stream(stream, data + offset, chunk, 0, scratch, on_event, ctx);
     }
 
-    GET_TIME(end);
-    pre_times = TIME_DIFF_IN_MS(start, end);
-
-    auto times = std::unique_ptr<double[]>(new double[repeat]);
-    int const times_len = repeat;
-
-    do {
-        found = 0;
-        GET_TIME(start);
-        if (hs_scan(database, subject, subject_len, 0, scratch, eventHandler, (void*)pattern) != HS_SUCCESS) {
-            fprintf(stderr, "ERROR: Unable to scan input buffer. Exiting.\n");
-            hs_free_scratch(scratch);
-            hs_free_database(database);
-            return -1;
-        }
-        GET_TIME(end);
-
-        times[repeat - 1] = TIME_DIFF_IN_MS(start, end);
-    } while (--repeat > 0);
-
-    res->matches = found;
-    get_mean_and_derivation(pre_times, times.get(), times_len, res);
-
-    hs_free_scratch(scratch);
-    hs_free_database(database);
-
-    return 0;
+    /* closing reports the matches at the end of the data */
+    hs_error_t const close_err = hs_close_stream(stream, scratch, on_event, ctx);
+    return (err != HS_SUCCESS) ? err : close_err;
 }
 
-int hs_multi_find_all(const char ** pattern, int pattern_num, const char * subject, int subject_len
+int hs_multi_find_all(const char ** pattern, int pattern_num, const char * subject, size_t subject_len
                         , int repeat, struct result * res)
 {
     TIME_TYPE start, end;
 
     hs_database_t * database;
     hs_compile_error_t * compile_err;
-    unsigned all_flags[MAX_RULES];
-    unsigned all_rule_ids[MAX_RULES];
+    std::vector<unsigned> all_flags(pattern_num, HS_FLAG_DOTALL | HS_FLAG_MULTILINE | HS_FLAG_SOM_LEFTMOST | hs_option_flags());
+    std::vector<unsigned> all_rule_ids(pattern_num);
     for(int i = 0; i < pattern_num; i++)
     {
-        all_flags[i] = HS_FLAG_DOTALL | HS_FLAG_MULTILINE | HS_FLAG_SOM_LEFTMOST;
         all_rule_ids[i] = i;
     }
 
+    /* an input above 4 GB needs a stream mode database */
+    bool const chunked = subject_len > HS_MAX_SCAN_LEN;
+
     double pre_times = 0;
     GET_TIME(start);
 
     if (hs_compile_multi((const char *const *)pattern,
-                         all_flags,
-                         all_rule_ids, 
+                         all_flags.data(),
+                         all_rule_ids.data(), 
                          pattern_num, 
-                         HS_MODE_BLOCK, 
+                         chunked ? (HS_MODE_STREAM | HS_MODE_SOM_HORIZON_LARGE) : HS_MODE_BLOCK, 
                          NULL, 
                          &database, 
                          &compile_err) != HS_SUCCESS) {
@@ -152,7 +148,7 @@ int hs_multi_find_all(const char ** pattern, int pattern_num, const char * subje
 
     do {
         found = 0;
-        GET_TIME(start);
+        START_SCAN_TIME(start);
         printf("%s Scanning with ", __func__);
         for (int i = 0; i < pattern_num; i++)
         {
@@ -160,13 +156,15 @@ int hs_multi_find_all(const char ** pattern, int pattern_num, const char * subje
         }
         printf("\n");
 
-        if (hs_scan(database, subject, subject_len, 0, scratch, eventHandlerMulti, pattern) != HS_SUCCESS) {
+        hs_error_t const err = chunked ? hs_scan_chunked(database, subject, subject_len, scratch, eventHandlerMulti, pattern)
+                                       : hs_scan(database, subject, subject_len, 0, scratch, eventHandlerMulti, pattern);
+        if (err != HS_SUCCESS && err != HS_SCAN_TERMINATED) {
             fprintf(stderr, "ERROR: Unable to scan input buffer. Exiting.\n");
             hs_free_scratch(scratch);
             hs_free_database(database);
             return -1;
         }
-        GET_TIME(end);
+        STOP_SCAN_TIME(end);
 
         times[repeat - 1] = TIME_DIFF_IN_MS(start, end);
     } while (--repeat > 0);
@@ -180,10 +178,12 @@ int hs_multi_find_all(const char ** pattern, int pattern_num, const char * subje
     return 0;
 }
 
-int hs_multi_find_all_v2(const char ** pattern, int pattern_num, const char * subject, int subject_len
+int hs_multi_find_all_v2(const char ** pattern, int pattern_num, const char * subject, size_t subject_len
                         , int repeat, struct result * res){
     TIME_TYPE start, end;
     modsecurity::Utils::HyperscanPm hs;
+    /* an input above 4 GB needs stream mode databases */
+    bool const chunked = subject_len > HS_MAX_SCAN_LEN;
 
     for (int i = 0; i < pattern_num; i++)
     {
@@ -193,7 +193,7 @@ int hs_multi_find_all_v2(const char ** pattern, int pattern_num, const char * su
     double pre_times = 0;
     GET_TIME(start);
     std::string error;
-    if (!hs.compile(&error)) {
+    if (!hs.compile(&error, 1, chunked)) {
         fprintf(stderr, "ERROR: Unable to compile patterns: '%s'\n", error.c_str());
         return -1;
     }
@@ -204,10 +204,10 @@ int hs_multi_find_all_v2(const char ** pattern, int pattern_num, const char * su
     auto times = std::unique_ptr<double[]>(new double[repeat]);
     int const times_len = repeat;
     do {
-        GET_TIME(start);
+        START_SCAN_TIME(start);
         std::vector<std::string> matches;
-        found = hs.search(subject, subject_len, matches);
-        if ( -1 == found ) {
+        uint64_t num_matches = 0;
+        if (hs.search(subject, subject_len, matches, &num_matches, regex_is_match != 0) < 0) {
             fprintf(stderr, "ERROR: Unable to scan input buffer. Exiting.\n");
             return -1;
         }
@@ -215,7 +215,8 @@ int hs_multi_find_all_v2(const char ** pattern, int pattern_num, const char * su
         // for (const auto &m : matches) {
         //     fprintf(stdout, "Match for pattern \"%s\"\n", m.c_str());
         // }
-        GET_TIME(end);
+        found = num_matches;
+        STOP_SCAN_TIME(end);
 
         times[repeat - 1] = TIME_DIFF_IN_MS(start, end);
     } while (--repeat > 0);
@@ -224,4 +225,546 @@ int hs_multi_find_all_v2(const char ** pattern, int pattern_num, const char * su
     get_mean_and_derivation(pre_times, times.get(), times_len, res);
 
     return 0;
-}
\ No newline at end of file
+}
+static int eventHandlerCount(UNUSED unsigned int  id,
+                        UNUSED unsigned long long from,
+                        UNUSED unsigned long long to,
+                        UNUSED unsigned int flags,
+                        UNUSED void * ctx) {
+    found++;
+    return 0;
+}
+
+/* --is-match: the first match answers the question, a non-zero return stops the scan */
+static int eventHandlerFirst(UNUSED unsigned int  id,
+                        UNUSED unsigned long long from,
+                        UNUSED unsigned long long to,
+                        UNUSED unsigned int flags,
+                        UNUSED void * ctx) {
+    found++;
+    return 1;
+}
+
+/* a scan stopped by eventHandlerFirst() is not an error */
+static hs_error_t hs_scanned(hs_error_t err)
+{
+    return (err == HS_SCAN_TERMINATED) ? HS_SUCCESS : err;
+}
+
+static unsigned hs_variant_flags(int variant)
+{
+    switch (variant) {
+        case HS_VARIANT_NOSOM:
+            return HS_FLAG_DOTALL | HS_FLAG_MULTILINE | hs_option_flags();
+        case HS_VARIANT_SINGLE:
+            /* SINGLEMATCH cannot be combined with SOM_LEFTMOST */
+            return HS_FLAG_DOTALL | HS_FLAG_MULTILINE | HS_FLAG_SINGLEMATCH | hs_option_flags();
+        case HS_VARIANT_LITERAL:
+            /* literals are byte strings in every encoding */
+            return (regex_caseless == CASE_NATIVE) ? HS_FLAG_CASELESS : 0;
+        default:
+            return HS_FLAG_DOTALL | HS_FLAG_MULTILINE | HS_FLAG_SOM_LEFTMOST | hs_option_flags();
+    }
+}
+
+/* the literal variant passes the fixed strings of the rules to hs_compile_lit_multi() */
+static int hs_compile_variant(const char * const * pattern, int pattern_num, int variant, unsigned mode
+                        , hs_database_t ** database)
+{
+    hs_compile_error_t * compile_err = NULL;
+    hs_error_t err;
+    std::vector<unsigned> all_flags(pattern_num, hs_variant_flags(variant));
+    std::vector<unsigned> all_rule_ids(pattern_num);
+    for (int i = 0; i < pattern_num; i++) {
+        all_rule_ids[i] = i;
+    }
+
+    if (variant == HS_VARIANT_SOM && (mode & HS_MODE_STREAM)) {
+        mode |= HS_MODE_SOM_HORIZON_LARGE;
+    }
+
+    if (variant == HS_VARIANT_LITERAL) {
+        std::vector<std::string> literals(pattern_num);
+        std::vector<const char *> all_literals(pattern_num);
+        std::vector<size_t> all_lens(pattern_num);
+
+        for (int i = 0; i < pattern_num; i++) {
+            RegexNode node;
+            bool caseless = false;
+
+            if (!regex_parse(pattern[i], &node, NULL) || !regex_literal(node, &literals[i], &caseless)) {
+                fprintf(stderr, "ERROR: Pattern \"%s\" is not a literal\n", pattern[i]);
+                return -1;
+            }
+            if (caseless) {
+                all_flags[i] |= HS_FLAG_CASELESS;
+            }
+            all_literals[i] = literals[i].data();
+            all_lens[i] = literals[i].size();
+        }
+
+        err = hs_compile_lit_multi(all_literals.data(),
+                                   all_flags.data(),
+                                   all_rule_ids.data(),
+                                   all_lens.data(),
+                                   pattern_num,
+                                   mode,
+                                   NULL,
+                                   database,
+                                   &compile_err);
+    } else {
+        err = hs_compile_multi(pattern,
+                               all_flags.data(),
+                               all_rule_ids.data(),
+                               pattern_num,
+                               mode,
+                               NULL,
+                               database,
+                               &compile_err);
+    }
+
+    if (err != HS_SUCCESS) {
+        fprintf(stderr, "ERROR: Unable to compile patterns: '%s'\n", compile_err ? compile_err->message : "unknown error");
+        hs_free_compile_error(compile_err);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* match bounds reported by Hyperscan, the groups are extracted after the scan of a block */
+struct HsWindow {
+    unsigned long long from;
+    unsigned long long to;
+};
+
+static int eventHandlerWindow(UNUSED unsigned int  id,
+                        unsigned long long from,
+                        unsigned long long to,
+                        UNUSED unsigned int flags,
+                        void * ctx) {
+    static_cast<std::vector<HsWindow> *>(ctx)->push_back({from, to});
+    found++;
+    return 0;
+}
+
+/*
+ * Second pass of --captures: Hyperscan has no capture groups, PCRE2-JIT
+ * extracts them from every match window (from is known with SOM_LEFTMOST).
+ * The pattern is anchored at both ends of the window, the window end is the
+ * end of the subject for $ and \b, the bytes before it stay visible.
+ */
+class HsCaptures {
+ public:
+    ~HsCaptures()
+    {
+        if (stack) {
+            pcre2_jit_stack_free(stack);
+        }
+        pcre2_match_context_free(match_ctx);
+        pcre2_match_data_free(match_data);
+        pcre2_code_free(re);
+    }
+
+    bool compile(const char * pattern)
+    {
+        int err_code;
+        PCRE2_SIZE err_offset;
+
+        re = pcre2_compile((PCRE2_SPTR8)pattern, PCRE2_ZERO_TERMINATED,
+                           PCRE2_ANCHORED | PCRE2_ENDANCHORED | pcre2_option_flags(),
+                           &err_code, &err_offset, NULL);
+        if (!re || pcre2_jit_compile(re, PCRE2_JIT_COMPLETE) != 0) {
+            return false;
+        }
+
+        match_data = pcre2_match_data_create_from_pattern(re, NULL);
+        match_ctx = pcre2_match_context_create(NULL);
+        stack = pcre2_jit_stack_create(32 * 1024, 512 * 1024, NULL);
+        if (!match_data || !match_ctx || !stack) {
+            return false;
+        }
+        pcre2_jit_stack_assign(match_ctx, NULL, stack);
+        return true;
+    }
+
+    /* capture groups set in the windows, the windows are consumed */
+    uint64_t extract(const char * data, std::vector<HsWindow> * windows)
+    {
+        PCRE2_SIZE * ovector = pcre2_get_ovector_pointer(match_data);
+        uint64_t groups = 0;
+
+        for (const HsWindow& window : *windows) {
+            int const rc = pcre2_jit_match(re, (PCRE2_SPTR8)data, window.to, window.from, 0, match_data, match_ctx);
+
+            for (int iter = 1; iter < rc; iter++) {
+                groups += ovector[2 * iter] != PCRE2_UNSET;
+            }
+        }
+        windows->clear();
+        return groups;
+    }
+
+ private:
+    pcre2_code * re = nullptr;
+    pcre2_match_data * match_data = nullptr;
+    pcre2_match_context * match_ctx = nullptr;
+    pcre2_jit_stack * stack = nullptr;
+};
+
+/* scans every block separately (block mode) or feeds the blocks into one stream per flow (stream mode) */
+static int hs_blocks_find_all(const char ** pattern, int pattern_num, const struct blocks * blocks, bool stream
+                        , int variant, int repeat, struct result * res)
+{
+    TIME_TYPE start, end;
+
+    hs_database_t * database;
+    bool chunked = false;
+    /* the groups of a single SOM rule are extracted for --captures, the other variants only count */
+    bool const capture = regex_captures && pattern_num == 1 && variant == HS_VARIANT_SOM && !stream;
+    HsCaptures captures;
+    std::vector<HsWindow> windows;
+    uint64_t groups = 0;
+    /* a terminated stream reports nothing more, each flow counts once for --is-match */
+    match_event_handler const on_event = regex_is_match ? eventHandlerFirst : capture ? eventHandlerWindow : eventHandlerCount;
+
+    /* blocks above 4 GB need a stream mode database */
+    for (size_t iter = 0; iter < blocks->count && !stream; iter++) {
+        chunked |= blocks->len[iter] > HS_MAX_SCAN_LEN;
+    }
+
+    double pre_times = 0;
+    GET_TIME(start);
+
+    if (hs_compile_variant(pattern, pattern_num, variant, (stream || chunked) ? HS_MODE_STREAM : HS_MODE_BLOCK, &database) != 0) {
+        return -1;
+    }
+    if (capture && !captures.compile(pattern[0])) {
+        fprintf(stderr, "ERROR: PCRE2 cannot extract the groups of \"%s\"\n", pattern[0]);
+        hs_free_database(database);
+        return -1;
+    }
+
+    hs_scratch_t * scratch = NULL;
+    if (hs_alloc_scratch(database, &scratch) != HS_SUCCESS) {
+        fprintf(stderr, "ERROR: Unable to allocate scratch space. Exiting.\n");
+        hs_free_database(database);
+        return -1;
+    }
+
+    GET_TIME(end);
+    pre_times = TIME_DIFF_IN_MS(start, end);
+
+    auto times = std::unique_ptr<double[]>(new double[repeat]);
+    int const times_len = repeat;
+    std::vector<hs_stream_t *> streams(stream ? blocks->flows : 0, nullptr);
+    hs_error_t err = HS_SUCCESS;
+
+    do {
+        found = 0;
+        groups = 0;
+        START_SCAN_TIME(start);
+        for (size_t iter = 0; iter < blocks->count && err == HS_SUCCESS; iter++) {
+            if (chunked) {
+                err = hs_scanned(hs_scan_chunked(database, blocks->data[iter], blocks->len[iter], scratch, on_event, &windows));
+                groups += capture ? captures.extract(blocks->data[iter], &windows) : 0;
+                continue;
+            }
+            if (!stream) {
+                err = hs_scanned(hs_scan(database, blocks->data[iter], blocks->len[iter], 0, scratch, on_event, &windows));
+                groups += capture ? captures.extract(blocks->data[iter], &windows) : 0;
+                continue;
+            }
+
+            hs_stream_t *& flow_stream = streams[blocks->flow[iter]];
+            if (!flow_stream) {
+                err = hs_open_stream(database, 0, &flow_stream);
+                if (err != HS_SUCCESS) {
+                    break;
+                }
+            }
+            err = hs_scanned(hs_scan_stream(flow_stream, blocks->data[iter], blocks->len[iter], 0, scratch, on_event, NULL));
+        }
+
+        /* closing reports the matches at the end of the flows */
+        for (auto& flow_stream : streams) {
+            if (flow_stream) {
+                hs_close_stream(flow_stream, scratch, on_event, NULL);
+                flow_stream = nullptr;
+            }
+        }
+        STOP_SCAN_TIME(end);
+
+        if (err != HS_SUCCESS) {
+            fprintf(stderr, "ERROR: Unable to scan input buffer. Exiting.\n");
+            hs_free_scratch(scratch);
+            hs_free_database(database);
+            return -1;
+        }
+
+        times[repeat - 1] = TIME_DIFF_IN_MS(start, end);
+    } while (--repeat > 0);
+
+    res->matches = found;
+    res->captures = groups;
+    get_mean_and_derivation(pre_times, times.get(), times_len, res);
+
+    hs_free_scratch(scratch);
+    hs_free_database(database);
+
+    return 0;
+}
+
+/* a flat input is one block */
+static int hs_buffer_find_all(const char ** pattern, int pattern_num, const char * subject, size_t subject_len
+                        , int variant, int repeat, struct result * res)
+{
+    unsigned int const flow = 0;
+    struct blocks const blocks = {&subject, &subject_len, &flow, 1, 1, subject_len};
+
+    return hs_blocks_find_all(pattern, pattern_num, &blocks, false, variant, repeat, res);
+}
+
+int hs_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res)
+{
+    return hs_buffer_find_all(&pattern, 1, subject, subject_len, HS_VARIANT_SOM, repeat, res);
+}
+
+int hs_nosom_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res)
+{
+    return hs_buffer_find_all(&pattern, 1, subject, subject_len, HS_VARIANT_NOSOM, repeat, res);
+}
+
+int hs_single_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res)
+{
+    return hs_buffer_find_all(&pattern, 1, subject, subject_len, HS_VARIANT_SINGLE, repeat, res);
+}
+
+int hs_multi_variant_find_all(const char ** pattern, int pattern_num, const char * subject, size_t subject_len
+                        , int variant, int repeat, struct result * res)
+{
+    return hs_buffer_find_all(pattern, pattern_num, subject, subject_len, variant, repeat, res);
+}
+
+int hs_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res)
+{
+    return hs_blocks_find_all(&pattern, 1, blocks, false, HS_VARIANT_SOM, repeat, res);
+}
+
+int hs_nosom_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res)
+{
+    return hs_blocks_find_all(&pattern, 1, blocks, false, HS_VARIANT_NOSOM, repeat, res);
+}
+
+int hs_single_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res)
+{
+    return hs_blocks_find_all(&pattern, 1, blocks, false, HS_VARIANT_SINGLE, repeat, res);
+}
+
+int hs_stream_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res)
+{
+    return hs_blocks_find_all(&pattern, 1, blocks, true, HS_VARIANT_SOM, repeat, res);
+}
+
+int hs_multi_find_all_blocks(const char ** pattern, int pattern_num, const struct blocks * blocks, int stream
+                        , int variant, int repeat, struct result * res)
+{
+    return hs_blocks_find_all(pattern, pattern_num, blocks, stream != 0, variant, repeat, res);
+}
+
+bool hs_is_literal(const char* pattern)
+{
+    RegexNode node;
+    std::string literal;
+    bool caseless;
+
+    return regex_parse(pattern, &node, NULL) && regex_literal(node, &literal, &caseless);
+}
+
+static size_t hs_rule_database_size(const char * pattern, unsigned flags)
+{
+    hs_database_t * database;
+    hs_compile_error_t * compile_err;
+    size_t size = 0;
+
+    if (hs_compile(pattern, flags, HS_MODE_BLOCK, NULL, &database, &compile_err) != HS_SUCCESS) {
+        hs_free_compile_error(compile_err);
+        return 0;
+    }
+    hs_database_size(database, &size);
+    hs_free_database(database);
+    return size;
+}
+
+/* stream state per open stream, the start of match is tracked in it */
+static size_t hs_rule_stream_size(const char * pattern, unsigned flags)
+{
+    unsigned const mode = HS_MODE_STREAM | ((flags & HS_FLAG_SOM_LEFTMOST) ? HS_MODE_SOM_HORIZON_LARGE : 0);
+    hs_database_t * database;
+    hs_compile_error_t * compile_err;
+    size_t size = 0;
+
+    if (hs_compile(pattern, flags, mode, NULL, &database, &compile_err) != HS_SUCCESS) {
+        hs_free_compile_error(compile_err);
+        return 0;
+    }
+    hs_stream_size(database, &size);
+    hs_free_database(database);
+    return size;
+}
+
+/* without a stream mode database of both variants nothing is known */
+static bool hs_rule_som_state(const struct hs_rule_info& rule)
+{
+    return rule.stream_nosom > 0 && rule.stream_som > rule.stream_nosom;
+}
+
+/*
+ * What hs_expression_info() and the compiled databases tell about a rule.
+ * A rule takes a slow path when its matches need start of match state (the
+ * stream state grows with SOM_LEFTMOST, the bytecode size alone also changes
+ * with the different literal and engine choices), can be reported out of order
+ * (unordered), are only known at the end of the data (eod) or have an unbounded
+ * width (the start of match must be tracked over the whole input).
+ */
+bool hs_rule_info(const char * pattern, struct hs_rule_info * rule, char * error, size_t error_len)
+{
+    hs_expr_info_t * info = NULL;
+    hs_compile_error_t * compile_err = NULL;
+
+    if (hs_expression_info(pattern, hs_variant_flags(HS_VARIANT_SOM), &info, &compile_err) != HS_SUCCESS) {
+        snprintf(error, error_len, "%s", compile_err ? compile_err->message : "unknown");
+        hs_free_compile_error(compile_err);
+        return false;
+    }
+
+    rule->min_width = info->min_width;
+    rule->max_width = info->max_width;
+    rule->unordered = info->unordered_matches;
+    rule->at_eod = info->matches_at_eod;
+    rule->db_som = hs_rule_database_size(pattern, hs_variant_flags(HS_VARIANT_SOM));
+    rule->db_nosom = hs_rule_database_size(pattern, hs_variant_flags(HS_VARIANT_NOSOM));
+    rule->stream_som = hs_rule_stream_size(pattern, hs_variant_flags(HS_VARIANT_SOM));
+    rule->stream_nosom = hs_rule_stream_size(pattern, hs_variant_flags(HS_VARIANT_NOSOM));
+    rule->literal = hs_is_literal(pattern);
+    free(info);
+
+    snprintf(rule->slow, sizeof(rule->slow), "%s%s%s%s",
+             hs_rule_som_state(*rule) ? "som " : "",
+             rule->unordered ? "unordered " : "",
+             rule->at_eod ? "eod " : "",
+             rule->max_width == UINT_MAX ? "unbounded " : "");
+    return true;
+}
+
+/* writes hs_rule_info() of every rule */
+int hs_report_rules(const char ** pattern, int pattern_num, FILE * f)
+{
+    int literals = 0, som_state = 0, unordered = 0, at_eod = 0, unbounded = 0, failed = 0;
+
+    fprintf(f, "id;regex;min width;max width;unordered;eod;db som [bytes];db nosom [bytes];"
+               "stream som [bytes];stream nosom [bytes];literal;slow path\n");
+
+    for (int iter = 0; iter < pattern_num; iter++) {
+        struct hs_rule_info info;
+        char error[256];
+
+        if (!hs_rule_info(pattern[iter], &info, error, sizeof(error))) {
+            fprintf(f, "%d;%s;;;;;;;;;;error: %s\n", iter + 1, pattern[iter], error);
+            failed++;
+            continue;
+        }
+
+        bool const unbounded_width = info.max_width == UINT_MAX;
+
+        som_state += hs_rule_som_state(info);
+        unordered += info.unordered != 0;
+        at_eod += info.at_eod != 0;
+        unbounded += unbounded_width;
+        literals += info.literal;
+
+        fprintf(f, "%d;%s;%u;", iter + 1, pattern[iter], info.min_width);
+        if (unbounded_width) {
+            fprintf(f, "inf;");
+        } else {
+            fprintf(f, "%u;", info.max_width);
+        }
+        fprintf(f, "%d;%d;%zu;%zu;%zu;%zu;%d;%s\n", info.unordered, info.at_eod, info.db_som, info.db_nosom
+                , info.stream_som, info.stream_nosom, info.literal, info.slow);
+    }
+
+    fprintf(stdout, "Hyperscan rule info: %d literals, %d need SOM state, %d unordered, %d match at EOD, "
+                    "%d unbounded, %d not supported\n", literals, som_state, unordered, at_eod, unbounded, failed);
+
+    return 0;
+}
+
+static int eventHandlerPerRule(unsigned int id,
+                        UNUSED unsigned long long from,
+                        UNUSED unsigned long long to,
+                        UNUSED unsigned int flags,
+                        void * ctx) {
+    ((uint64_t *)ctx)[id]++;
+    return 0;
+}
+
+/*
+ * Best scan time in ms of repeat runs over the rule set, compilation is not
+ * timed. The timed scans count the matches in one counter, like the other
+ * engines do. matches (optional) gets the number of callbacks of every rule
+ * from one more scan that is not timed.
+ */
+double hs_multi_scan_time(const char ** pattern, int pattern_num, const char * subject, size_t subject_len
+                        , int variant, int repeat, uint64_t * matches)
+{
+    TIME_TYPE start, end;
+    hs_database_t * database;
+    hs_scratch_t * scratch = NULL;
+    std::vector<uint64_t> counts(pattern_num);
+    double best = -1;
+    /* an input above 4 GB needs a stream mode database */
+    bool const chunked = subject_len > HS_MAX_SCAN_LEN;
+
+    if (hs_compile_variant(pattern, pattern_num, variant, chunked ? HS_MODE_STREAM : HS_MODE_BLOCK, &database) != 0) {
+        return -1;
+    }
+    if (hs_alloc_scratch(database, &scratch) != HS_SUCCESS) {
+        fprintf(stderr, "ERROR: Unable to allocate scratch space. Exiting.\n");
+        hs_free_database(database);
+        return -1;
+    }
+
+    do {
+        found = 0;
+        START_SCAN_TIME(start);
+        hs_error_t const err = chunked ? hs_scan_chunked(database, subject, subject_len, scratch, eventHandlerCount, NULL)
+                                       : hs_scan(database, subject, subject_len, 0, scratch, eventHandlerCount, NULL);
+        STOP_SCAN_TIME(end);
+
+        if (err != HS_SUCCESS) {
+            fprintf(stderr, "ERROR: Unable to scan input buffer. Exiting.\n");
+            best = -1;
+            break;
+        }
+
+        double const time = TIME_DIFF_IN_MS(start, end);
+        if (best < 0 || time < best) {
+            best = time;
+        }
+    } while (--repeat > 0);
+
+    if (matches && best >= 0) {
+        hs_error_t const err = chunked ? hs_scan_chunked(database, subject, subject_len, scratch, eventHandlerPerRule, counts.data())
+                                       : hs_scan(database, subject, subject_len, 0, scratch, eventHandlerPerRule, counts.data());
+        if (err == HS_SUCCESS) {
+            std::copy(counts.begin(), counts.end(), matches);
+        } else {
+            best = -1;
+        }
+    }
+
+    hs_free_scratch(scratch);
+    hs_free_database(database);
+
+    return best;
+}
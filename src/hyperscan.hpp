@@ -0,0 +1,28 @@
+#ifndef HYPERSCAN_HPP
+#define HYPERSCAN_HPP
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <hs/hs.h>
+
+/* hs_scan() takes an unsigned int length, larger blocks are scanned as a stream of chunks */
+#define HS_MAX_SCAN_LEN     ((size_t)UINT_MAX)
+#define HS_CHUNK_LEN        ((size_t)1 << 30)
+
+/* HS_FLAG_UTF8 | HS_FLAG_UCP for --encoding utf8, HS_FLAG_CASELESS for --caseless native */
+unsigned hs_option_flags(void);
+
+/*
+ * PCRE2 options with the semantics of the Hyperscan flags, for the engines that
+ * confirm or replace Hyperscan: DOTALL | MULTILINE, UTF | UCP | MATCH_INVALID_UTF
+ * for --encoding utf8, CASELESS for --caseless native
+ */
+uint32_t pcre2_option_flags(void);
+
+/* the database must be compiled with HS_MODE_STREAM, match offsets are relative to data */
+hs_error_t hs_scan_chunked(const hs_database_t * database, const char * data, size_t len, hs_scratch_t * scratch,
+                           match_event_handler on_event, void * ctx);
+
+#endif // HYPERSCAN_HPP
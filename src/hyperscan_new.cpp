@@ -13,11 +13,14 @@
  *
  */
 
+#include <stdint.h>
+
 #include <string>
 #include <vector>
 
 // #ifdef WITH_HS
 #include "hyperscan_new.hpp"
+#include "hyperscan.hpp"
 
 namespace modsecurity {
 namespace Utils {
@@ -26,15 +29,27 @@ HyperscanPattern::HyperscanPattern(const char *pat, size_t patLen,
                                    unsigned int patId) :
                                    pattern(pat), len(patLen), id(patId) {}
 
-HyperscanPm::~HyperscanPm() {
+HyperscanPartition::~HyperscanPartition() {
     if (db) {
         hs_free_database(db);
     }
+}
+
+HyperscanSnapshot::~HyperscanSnapshot() {
     if (scratch) {
         hs_free_scratch(scratch);
     }
 }
 
+HyperscanPm::~HyperscanPm() {
+    // The readers must be gone before the databases are freed.
+    ownReader.reset();
+    for (auto &r : retired) {
+        delete r.second;
+    }
+    delete current.load();
+}
+
 void HyperscanPm::addPattern(const char *pat, size_t patLen) {
     printf("Adding pattern: '%s', lenth - %ld\n", pat, patLen);
     if (patLen == 0) {
@@ -45,7 +60,7 @@ void HyperscanPm::addPattern(const char *pat, size_t patLen) {
     patterns.emplace_back(p);
 }
 
-bool HyperscanPm::compile(std::string *error) {
+bool HyperscanPm::compile(std::string *error, unsigned int numPartitions, bool stream) {
     if (patterns.empty()) {
         return false;
     }
@@ -56,29 +71,69 @@ bool HyperscanPm::compile(std::string *error) {
         return false;
     }
 
+    std::lock_guard<std::mutex> lock(writer);
+    num_partitions = numPartitions > 0 ? numPartitions : 1;
+    streaming = stream;
+
+    std::unique_ptr<HyperscanSnapshot> next(new HyperscanSnapshot);
+    for (unsigned int p = 0; p < num_partitions; p++) {
+        std::shared_ptr<const HyperscanPartition> partition;
+        if (!buildPartition(p, &partition, error)) {
+            return false;
+        }
+        next->partitions.push_back(partition);
+    }
+
+    return publish(next.release(), error);
+}
+
+unsigned int HyperscanPm::partitionOf(unsigned int patId) const {
+    return patId % num_partitions;
+}
+
+bool HyperscanPm::buildPartition(unsigned int partition,
+                                 std::shared_ptr<const HyperscanPartition> *out,
+                                 std::string *error) {
+    std::shared_ptr<HyperscanPartition> part(new HyperscanPartition);
+
+    for (const auto &p : patterns) {
+        if (p.len > 0 && partitionOf(p.id) == partition) {
+            part->ids.emplace_back(p.id);
+            part->patterns.emplace_back(p.pattern);
+        }
+    }
+
+    // An empty partition has no database.
+    if (part->ids.empty()) {
+        *out = part;
+        return true;
+    }
+
     // The Hyperscan compiler takes its patterns in a group of arrays.
     std::vector<const char *> pats;
-    std::vector<unsigned> flags(num_patterns, HS_FLAG_DOTALL | HS_FLAG_MULTILINE | HS_FLAG_SOM_LEFTMOST);//HS_FLAG_CASELESS);
+    std::vector<unsigned> flags(part->ids.size(), HS_FLAG_DOTALL | HS_FLAG_MULTILINE | HS_FLAG_SOM_LEFTMOST | hs_option_flags());
     std::vector<unsigned> ids;
 
-    for (const auto &p : patterns) {
-        pats.emplace_back(p.pattern.c_str());
-        ids.emplace_back(p.id);
+    for (size_t i = 0; i < part->patterns.size(); i++) {
+        pats.emplace_back(part->patterns[i].c_str());
+        ids.emplace_back(i);
     }
 
     hs_compile_error_t *compile_error = NULL;
     hs_error_t hs_error = hs_compile_multi(&pats[0], 
                                             &flags[0], 
                                             &ids[0],
-                                            num_patterns, 
-                                            HS_MODE_BLOCK, 
+                                            pats.size(), 
+                                            streaming ? (HS_MODE_STREAM | HS_MODE_SOM_HORIZON_LARGE) : HS_MODE_BLOCK, 
                                             NULL, 
-                                            &db, 
+                                            &part->db, 
                                             &compile_error);
 
     if (compile_error != NULL) {
         std::string message(compile_error->message);
-        std::string expression = std::to_string(compile_error->expression);
+        std::string expression = std::to_string(compile_error->expression >= 0
+                                                ? (int)part->ids[compile_error->expression]
+                                                : compile_error->expression);
         error->assign("hs_compile_multi() failed: " + message +
                       "(expression: " + expression + ")");
         hs_free_compile_error(compile_error);
@@ -91,28 +146,143 @@ bool HyperscanPm::compile(std::string *error) {
         return false;
     }
 
-    // Allocate Hyperscan scratch space for this database.
-    hs_error = hs_alloc_scratch(db, &scratch);
+    *out = part;
+    return true;
+}
+
+bool HyperscanPm::publish(HyperscanSnapshot *snapshot, std::string *error) {
+    std::unique_ptr<HyperscanSnapshot> next(snapshot);
+    HyperscanSnapshot *old = current.load();
+    hs_error_t hs_error;
+
+    // The old scratch stays valid for the readers that still clone it, a
+    // copy is grown for the new databases.
+    if (old && old->scratch) {
+        hs_error = hs_clone_scratch(old->scratch, &next->scratch);
+        if (hs_error != HS_SUCCESS) {
+            error->assign("hs_clone_scratch() failed: error " +
+                          std::to_string(hs_error));
+            return false;
+        }
+    }
+
+    for (const auto &part : next->partitions) {
+        if (!part->db) {
+            continue;
+        }
+        // Allocate Hyperscan scratch space for this database.
+        hs_error = hs_alloc_scratch(part->db, &next->scratch);
+        if (hs_error != HS_SUCCESS) {
+            error->assign("hs_alloc_scratch() failed: error " +
+                          std::to_string(hs_error));
+            return false;
+        }
+    }
 
-    if (hs_error != HS_SUCCESS) {
-        error->assign("hs_alloc_scratch() failed: error " +
-                      std::to_string(hs_error));
+    next->generation = old ? old->generation + 1 : 1;
+    current.store(next.release());
+
+    // A reader that loaded the old snapshot entered before the new epoch.
+    if (old) {
+        retired.emplace_back(epoch.fetch_add(1) + 1, old);
+    }
+    reclaim();
+
+    return true;
+}
+
+void HyperscanPm::reclaim() {
+    uint64_t oldest = UINT64_MAX;
+
+    for (size_t i = 0; i < kMaxReaders; i++) {
+        uint64_t const e = readerEpochs[i].load();
+        if (e != 0 && e < oldest) {
+            oldest = e;
+        }
+    }
+
+    size_t kept = 0;
+    for (auto &r : retired) {
+        if (r.first <= oldest) {
+            delete r.second;
+        } else {
+            retired[kept++] = r;
+        }
+    }
+    retired.resize(kept);
+}
+
+bool HyperscanPm::rebuild(unsigned int partition, std::string *error) {
+    HyperscanSnapshot *old = current.load();
+    std::shared_ptr<const HyperscanPartition> part;
+
+    if (!buildPartition(partition, &part, error)) {
         return false;
     }
 
-    size_t scratch_size = 0;
-    hs_error = hs_scratch_size(scratch, &scratch_size);
-    if (hs_error != HS_SUCCESS) {
-        error->assign("hs_scratch_size() failed: error " +
-                      std::to_string(hs_error));
+    std::unique_ptr<HyperscanSnapshot> next(new HyperscanSnapshot);
+    next->partitions = old->partitions;
+    next->partitions[partition] = part;
+
+    return publish(next.release(), error);
+}
+
+bool HyperscanPm::addPattern(const char *pat, size_t patLen,
+                             unsigned int *patId, std::string *error) {
+    if (patLen == 0) {
+        error->assign("Empty pattern.");
         return false;
     }
 
-    size_t db_size = 0;
-    hs_error = hs_database_size(db, &db_size);
-    if (hs_error != HS_SUCCESS) {
-        error->assign("hs_database_size() failed: error " +
-                      std::to_string(hs_error));
+    std::lock_guard<std::mutex> lock(writer);
+    unsigned int const id = num_patterns++;
+    patterns.emplace_back(pat, patLen, id);
+
+    // Not compiled yet, compile() picks it up.
+    if (current.load() && !rebuild(partitionOf(id), error)) {
+        patterns.pop_back();
+        num_patterns--;
+        return false;
+    }
+
+    *patId = id;
+    return true;
+}
+
+bool HyperscanPm::removePattern(unsigned int patId, std::string *error) {
+    std::lock_guard<std::mutex> lock(writer);
+    if (patId >= num_patterns || patterns[patId].len == 0) {
+        error->assign("Unknown pattern id " + std::to_string(patId));
+        return false;
+    }
+
+    size_t const len = patterns[patId].len;
+    patterns[patId].len = 0;
+    if (current.load() && !rebuild(partitionOf(patId), error)) {
+        patterns[patId].len = len;
+        return false;
+    }
+
+    return true;
+}
+
+bool HyperscanPm::modifyPattern(unsigned int patId, const char *pat,
+                                size_t patLen, std::string *error) {
+    if (patLen == 0) {
+        return removePattern(patId, error);
+    }
+
+    std::lock_guard<std::mutex> lock(writer);
+    if (patId >= num_patterns || patterns[patId].len == 0) {
+        error->assign("Unknown pattern id " + std::to_string(patId));
+        return false;
+    }
+
+    HyperscanPattern const previous = patterns[patId];
+    patterns[patId].pattern.assign(pat, patLen);
+    patterns[patId].len = patLen;
+    if (current.load() && !rebuild(partitionOf(patId), error)) {
+        patterns[patId] = previous;
         return false;
     }
 
@@ -121,11 +291,12 @@ bool HyperscanPm::compile(std::string *error) {
 
 // Context data used by Hyperscan match callback.
 struct HyperscanCallbackContext {
-    HyperscanPm *pm{nullptr};
-    unsigned int num_matches{0};
-    unsigned int offset{0};
-    std::vector<std::string>& matches;
-    const bool terminateAfter1stMatch{false};
+    const HyperscanPartition *partition;
+    uint64_t num_matches;
+    unsigned long long offset;
+    std::vector<std::string> *matches;
+    const bool terminateAfter1stMatch;
+    const bool print;
 };
 
 // Match callback, called by hs_scan for every match.
@@ -135,27 +306,103 @@ int onMatch(unsigned int id, unsigned long long from, unsigned long long to,
     HyperscanCallbackContext *ctx = static_cast<HyperscanCallbackContext *>(hs_ctx);
 
     ctx->num_matches++;
-    ctx->offset = (unsigned int)to - 1;
+    ctx->offset = to - 1;
 
-    const char* match = ctx->pm->getPatternById(id);
-    if (match)
-        ctx->matches.push_back(match);
+    const char* match = ctx->partition->patterns[id].c_str();
+    if (ctx->matches)
+        ctx->matches->push_back(match);
 
-    printf("%s Match for pattern \"%s\" at offset %llu:%llu\n", __func__, match, from, to);
+    if (ctx->print)
+        printf("%s Match for pattern \"%s\" at offset %llu:%llu\n", __func__, match, from, to);
     return ctx->terminateAfter1stMatch; // Terminate matching.
 }
 
-int HyperscanPm::search(const char *t, unsigned int tlen, std::vector<std::string>& matches, bool terminateAfter1stMatch) {
-    HyperscanCallbackContext ctx{this, 0, 0, matches, terminateAfter1stMatch};
+HyperscanPm::Reader::Reader(HyperscanPm *pm) : pm(pm), slot(kMaxReaders) {
+    std::lock_guard<std::mutex> lock(pm->writer);
+    for (size_t i = 0; i < kMaxReaders; i++) {
+        if (!pm->readerUsed[i]) {
+            pm->readerUsed[i] = true;
+            slot = i;
+            break;
+        }
+    }
+}
+
+HyperscanPm::Reader::~Reader() {
+    if (scratch) {
+        hs_free_scratch(scratch);
+    }
+    if (slot < kMaxReaders) {
+        std::lock_guard<std::mutex> lock(pm->writer);
+        pm->readerUsed[slot] = false;
+    }
+}
 
-    hs_error_t error = hs_scan(db, t, tlen, 0, scratch, onMatch, &ctx);
-    if (error != HS_SUCCESS && error != HS_SCAN_TERMINATED) {
-        printf("%s hs_scan() return error code: %d\n", __func__, error);
-        // TODO add debug output
+int HyperscanPm::Reader::search(const char *t, size_t tlen, std::vector<std::string> *matches,
+                                uint64_t *numMatches, bool terminateAfter1stMatch, bool print) {
+    if (slot >= kMaxReaders) {
+        printf("%s more than %zu readers\n", __func__, kMaxReaders);
+        return -1;
+    }
+    if (!pm->streaming && tlen > HS_MAX_SCAN_LEN) {
+        printf("%s input larger than 4 GB needs stream mode databases\n", __func__);
         return -1;
     }
 
-    return ctx.num_matches;
+    // Announce the epoch before loading the snapshot, see reclaim().
+    std::atomic<uint64_t> &announced = pm->readerEpochs[slot];
+    announced.store(pm->epoch.load());
+    const HyperscanSnapshot *snapshot = pm->current.load();
+
+    if (snapshot && snapshot->generation != generation) {
+        if (scratch) {
+            hs_free_scratch(scratch);
+            scratch = nullptr;
+        }
+        if (snapshot->scratch && hs_clone_scratch(snapshot->scratch, &scratch) != HS_SUCCESS) {
+            announced.store(0);
+            printf("%s hs_clone_scratch() failed\n", __func__);
+            return -1;
+        }
+        generation = snapshot->generation;
+    }
+
+    HyperscanCallbackContext ctx{nullptr, 0, 0, matches, terminateAfter1stMatch, print};
+
+    for (size_t i = 0; snapshot && i < snapshot->partitions.size(); i++) {
+        const HyperscanPartition *part = snapshot->partitions[i].get();
+        if (!part->db) {
+            continue;
+        }
+
+        ctx.partition = part;
+        hs_error_t error = pm->streaming ? hs_scan_chunked(part->db, t, tlen, scratch, onMatch, &ctx)
+                                         : hs_scan(part->db, t, tlen, 0, scratch, onMatch, &ctx);
+        if (error == HS_SCAN_TERMINATED) {
+            break;
+        }
+        if (error != HS_SUCCESS) {
+            announced.store(0);
+            printf("%s hs_scan() return error code: %d\n", __func__, error);
+            // TODO add debug output
+            return -1;
+        }
+    }
+
+    announced.store(0);
+    if (numMatches) {
+        *numMatches = ctx.num_matches;
+    }
+    return 0;
+}
+
+int HyperscanPm::search(const char *t, size_t tlen, std::vector<std::string>& matches, uint64_t *numMatches,
+                        bool terminateAfter1stMatch) {
+    if (!ownReader) {
+        ownReader.reset(new Reader(this));
+    }
+
+    return ownReader->search(t, tlen, &matches, numMatches, terminateAfter1stMatch, true);
 }
 
 const char *HyperscanPm::getPatternById(unsigned int patId) const {
@@ -13,6 +13,11 @@
  *
  */
 
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -26,29 +31,108 @@ struct HyperscanPattern {
     HyperscanPattern(const char *pat, size_t patLen, unsigned int patId);
 
     std::string pattern;
-    size_t len;
+    size_t len; /* 0 once the pattern is removed */
     unsigned int id; /* actual pattern id */
 };
 
+/*
+ * The patterns are split into partitions by id, every partition is a separate
+ * database. Adding, removing or modifying a pattern after compile() only
+ * recompiles its partition.
+ */
+struct HyperscanPartition {
+    ~HyperscanPartition();
+
+    hs_database_t *db = nullptr;
+    std::vector<unsigned int> ids;  /* database id -> pattern id */
+    std::vector<std::string> patterns;
+};
+
+/*
+ * An immutable set of partitions, the unchanged partitions are shared with the
+ * previous snapshot. The scratch is big enough for every partition, the
+ * readers clone it.
+ */
+struct HyperscanSnapshot {
+    ~HyperscanSnapshot();
+
+    std::vector<std::shared_ptr<const HyperscanPartition>> partitions;
+    hs_scratch_t *scratch = nullptr;
+    uint64_t generation = 0;
+};
+
 class HyperscanPm {
  public:
+    /*
+     * A scanner thread. The snapshot is published with an epoch scheme: a
+     * reader announces the epoch it entered in and the writer frees a retired
+     * snapshot once no reader is still in an older epoch. Readers never take
+     * a lock or wait for an update.
+     */
+    class Reader {
+     public:
+        explicit Reader(HyperscanPm *pm);
+        ~Reader();
+
+        /* 0 or -1 on errors, matches and numMatches may be NULL */
+        int search(const char *t,
+                    size_t tlen,
+                    std::vector<std::string> *matches,
+                    uint64_t *numMatches,
+                    bool terminateAfter1stMatch = false,
+                    bool print = false);
+
+     private:
+        HyperscanPm *pm;
+        size_t slot;
+        hs_scratch_t *scratch = nullptr;
+        uint64_t generation = 0;
+    };
+
+    static const size_t kMaxReaders = 64;
+
     ~HyperscanPm();
 
     void addPattern(const char *pat, size_t patLen);
 
-    bool compile(std::string *error);
+    /*
+     * Block mode databases scan up to 4 GB at a time. With stream the
+     * partitions are stream mode databases and search() scans any length in
+     * chunks.
+     */
+    bool compile(std::string *error, unsigned int numPartitions = 1, bool stream = false);
 
     int search(const char *t, 
-                unsigned int tlen, 
+                size_t tlen, 
                 std::vector<std::string>& matches,
+                uint64_t *numMatches,
                 bool terminateAfter1stMatch = false);
 
     const char *getPatternById(unsigned int patId) const;
 
+    /* updates after compile(), the changed partition is published before they return */
+    bool addPattern(const char *pat, size_t patLen, unsigned int *patId, std::string *error);
+    bool removePattern(unsigned int patId, std::string *error);
+    bool modifyPattern(unsigned int patId, const char *pat, size_t patLen, std::string *error);
+
+    unsigned int partitionOf(unsigned int patId) const;
+
  private:
-    hs_database_t *db = nullptr;
-    // Scratch space for Hyperscan.
-    hs_scratch_t *scratch = nullptr;
+    bool rebuild(unsigned int partition, std::string *error);
+    bool buildPartition(unsigned int partition, std::shared_ptr<const HyperscanPartition> *out, std::string *error);
+    bool publish(HyperscanSnapshot *next, std::string *error);
+    void reclaim();
+
+    std::mutex writer; /* updates and reader registration */
+    std::atomic<HyperscanSnapshot *> current{nullptr};
+    std::atomic<uint64_t> epoch{1};
+    std::atomic<uint64_t> readerEpochs[kMaxReaders] = {}; /* 0: not scanning */
+    bool readerUsed[kMaxReaders] = {};
+    std::vector<std::pair<uint64_t, HyperscanSnapshot *>> retired;
+    std::unique_ptr<Reader> ownReader; /* search() */
+
+    unsigned int num_partitions = 1;
+    bool streaming = false;
     unsigned int num_patterns = 0; // number of elements
     std::vector<HyperscanPattern> patterns;
 };
@@ -2,52 +2,93 @@
 #include <string.h>
 #include <stdlib.h>
 #include <getopt.h>
+#include <limits.h>
 
 #include "main.h"
 #include "version.h"
+#include "corpus.hpp"
+#include "regex_parser.hpp"
+#include "normalize.hpp"
+#include "attribute.hpp"
+#include "tiered.hpp"
+#include "reload.hpp"
+#include "shared_db.hpp"
+#include "compress.hpp"
+#include "match_sink.hpp"
+#ifdef INCLUDE_PCAP
+#include "capture.hpp"
+#endif
 
 #include <vector>
 #include <string>
 #include <fstream>
 #include <sstream>
+#include <memory>
+#include <algorithm>
 
 struct engines {
     const char * name;
-    int (*find_all)(const char* pattern, const char* subject, int subject_len, int repeat, struct result * result);
+    int (*find_all)(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * result);
+    int (*find_all_blocks)(const char* pattern, const struct blocks * blocks, int repeat, struct result * result);
+    bool stream;    /* blocks of a flow belong to one stream */
+    bool bytes_only;    /* no UTF-8 mode, skipped for --encoding utf8 */
+    bool no_caseless;   /* no caseless flag, skipped for --caseless native */
+    bool captures;      /* can extract capture groups, measured with and without them for --captures */
+    bool valid_utf8;    /* the utf8 mode needs valid UTF-8 input, skipped for other input */
+    int encoding;
+    bool extract;       /* this run extracts the capture groups */
+    int allocator;
+    bool baseline;      /* reference search instead of a regex engine, not scored */
+    bool ceiling;       /* read sweep, the throughput of the other engines is reported relative to it */
 };
 
 static struct engines engines [] = {
+    {.name = "memread",     .find_all = memread_find_all, .find_all_blocks = memread_find_all_blocks, .baseline = true, .ceiling = true},
+    {.name = "memchr",      .find_all = memchr_find_all, .find_all_blocks = memchr_find_all_blocks, .bytes_only = true, .baseline = true},
+    {.name = "memmem",      .find_all = memmem_find_all, .find_all_blocks = memmem_find_all_blocks, .bytes_only = true, .baseline = true},
+    {.name = "classscan",   .find_all = classscan_find_all, .find_all_blocks = classscan_find_all_blocks, .bytes_only = true, .baseline = true},
 #ifdef INCLUDE_CTRE
-    {.name = "ctre",        .find_all = ctre_find_all},
+    {.name = "ctre",        .find_all = ctre_find_all, .bytes_only = true, .no_caseless = true},
 #endif
 #ifdef INCLUDE_BOOST
-    {.name = "boost",        .find_all = boost_find_all},
+    {.name = "boost",        .find_all = boost_find_all, .bytes_only = true},
 #endif
 #ifdef INCLUDE_CPPSTD
-    {.name = "cppstd",        .find_all = cppstd_find_all},
+    {.name = "cppstd",        .find_all = cppstd_find_all, .bytes_only = true},
 #endif
 #ifdef INCLUDE_PCRE2
-    {.name = "pcre",        .find_all = pcre2_std_find_all},
-    {.name = "pcre-dfa",    .find_all = pcre2_dfa_find_all},
-    {.name = "pcre-jit",    .find_all = pcre2_jit_find_all},
+    {.name = "pcre",        .find_all = pcre2_std_find_all, .find_all_blocks = pcre2_std_find_all_blocks, .captures = true},
+    {.name = "pcre-dfa",    .find_all = pcre2_dfa_find_all, .find_all_blocks = pcre2_dfa_find_all_blocks},
+    {.name = "pcre-jit",    .find_all = pcre2_jit_find_all, .find_all_blocks = pcre2_jit_find_all_blocks, .captures = true},
 #endif
 #ifdef INCLUDE_RE2
-    {.name = "re2",         .find_all = re2_find_all},
+    {.name = "re2",         .find_all = re2_find_all, .find_all_blocks = re2_find_all_blocks, .captures = true},
+    {.name = "re2-match",   .find_all = re2_match_find_all, .find_all_blocks = re2_match_find_all_blocks, .captures = true},
+    {.name = "re2-longst",  .find_all = re2_longest_find_all, .find_all_blocks = re2_longest_find_all_blocks, .captures = true},
 #endif
 // #ifdef INCLUDE_ONIGURUMA
-//     {.name = "onig",        .find_all = onig_find_all},
+//     {.name = "onig",        .find_all = onig_find_all, .captures = true},
 // #endif
 // #ifdef INCLUDE_TRE
 //     {.name = "tre",         .find_all = tre_find_all},
 // #endif
 #ifdef INCLUDE_HYPERSCAN
-    {.name = "hscan",       .find_all = hs_find_all},
+    {.name = "hscan",       .find_all = hs_find_all, .find_all_blocks = hs_find_all_blocks, .captures = true, .valid_utf8 = true},
+    {.name = "hscan-nsom",  .find_all = hs_nosom_find_all, .find_all_blocks = hs_nosom_find_all_blocks, .valid_utf8 = true},
+    {.name = "hscan-1st",   .find_all = hs_single_find_all, .find_all_blocks = hs_single_find_all_blocks, .valid_utf8 = true},
+    {.name = "hscan-strm",  .find_all = NULL, .find_all_blocks = hs_stream_find_all_blocks, .stream = true, .valid_utf8 = true},
 #endif
 #ifdef INCLUDE_YARA
-    {.name = "yara",        .find_all = yara_find_all},
+    {.name = "yara",        .find_all = yara_find_all, .find_all_blocks = yara_find_all_blocks, .bytes_only = true},
 #endif
-    {.name = "rust_regex",  .find_all = rust_find_all},
-    {.name = "rust_regrs",  .find_all = regress_find_all},
+    {.name = "rust_regex",  .find_all = rust_find_all, .find_all_blocks = rust_find_all_blocks, .captures = true},
+    {.name = "rust_regrs",  .find_all = regress_find_all, .valid_utf8 = true},
+    {.name = "ra-dense",    .find_all = ra_dense_find_all, .find_all_blocks = ra_dense_find_all_blocks},
+    {.name = "ra-sparse",   .find_all = ra_sparse_find_all, .find_all_blocks = ra_sparse_find_all_blocks},
+    {.name = "ra-meta",     .find_all = ra_meta_find_all, .find_all_blocks = ra_meta_find_all_blocks},
+    {.name = "ra-dense-mm", .find_all = ra_dense_mm_find_all, .find_all_blocks = ra_dense_mm_find_all_blocks},
+    {.name = "ra-sprs-mm",  .find_all = ra_sparse_mm_find_all, .find_all_blocks = ra_sparse_mm_find_all_blocks},
+    {.name = "shiftand",    .find_all = shiftand_find_all, .find_all_blocks = shiftand_find_all_blocks, .bytes_only = true},
 };
 
 // static char * regex [] = {
@@ -71,34 +112,253 @@ static struct engines engines [] = {
 //     "(.*?,){13}z"
 // };
 
+/* the engines measured in this run, one entry per engine and selected encoding */
+static std::vector<struct engines> runs;
+static std::vector<int> encodings = {ENC_NATIVE};
+static std::vector<int> allocators = {ALLOC_SYSTEM};
+
+int regex_encoding = ENC_NATIVE;
+int regex_caseless = CASE_SENSITIVE;
+int regex_captures = 0;
+int regex_is_match = 0;
+
+static struct env_info env = {.cpu = -1};
+static bool perf_enabled = false;
+static bool normalize_enabled = false;
+static bool captures_enabled = false;
+static bool records_enabled = false;
+
+/* set when the input is a list of blocks (packets, flows, records) instead of one buffer */
+static const struct blocks * input_blocks = NULL;
+static bool input_valid_utf8 = true;
+static const struct blocks * stream_blocks = NULL;
+static size_t input_packets = 0;
+static const char * input_unit = "packets";
+
+/* --records: the lines of the flat input, every line is a separate input and stream */
+struct Records {
+    std::vector<const char *> data;
+    std::vector<size_t> len;
+    std::vector<unsigned int> flow;
+    struct blocks blocks;
+};
+
+static void printPerf(const char * name, const struct perf_counters& counters)
+{
+    struct perf_metrics metrics;
+
+    if (!perf_enabled) {
+        return;
+    }
+
+    perf_get_metrics(&counters, &metrics);
+    fprintf(stdout, "[%10s] IPC: %5.2f, branch-miss: %5.2f %%, L1d-miss: %8.2f/KB, LLC-miss: %8.3f/KB, dTLB-miss: %8.3f/KB\n", name
+                , metrics.ipc, metrics.branch_miss_rate, metrics.l1d_per_kb, metrics.llc_per_kb, metrics.dtlb_per_kb);
+}
+
+static void printRate(const char * name, const struct result& res)
+{
+    if (!input_blocks || res.time <= 0) {
+        return;
+    }
+
+    fprintf(stdout, "[%10s] %12.0f %s/s, %8.3f Gbit/s\n", name
+                , input_packets * 1000.0 / res.time, input_unit, input_blocks->bytes * 8.0 / (res.time * 1e6));
+    if (regex_is_match && input_blocks->count > 0) {
+        fprintf(stdout, "[%10s] hits: %" PRIu64 " of %zu inputs (%.2f %%)\n", name
+                    , res.matches, input_blocks->count, res.matches * 100.0 / input_blocks->count);
+    }
+}
+
+/* time of the read sweep on the same input, 0 if it did not run */
+static double ceilingTime(const struct result * engine_results)
+{
+    for (size_t iter = 0; iter < runs.size(); iter++) {
+        if (runs[iter].ceiling && engine_results[iter].time > 0) {
+            return engine_results[iter].time;
+        }
+    }
+    return 0;
+}
+
+static void printThroughput(const char * name, double bytes, double time, double ceiling)
+{
+    if (time <= 0) {
+        return;
+    }
+
+    if (ceiling > 0) {
+        fprintf(stdout, "[%10s] %8.3f GB/s, %5.1f %% of memread\n", name, bytes / (time * 1e6), ceiling * 100 / time);
+    } else {
+        fprintf(stdout, "[%10s] %8.3f GB/s\n", name, bytes / (time * 1e6));
+    }
+}
+
+static void printCoverage(const char * name, const struct hybrid_stats& stats)
+{
+    fprintf(stdout, "[%10s] rules: %d native, %d prefiltered (%d capped), %d fallback, %d unsupported | "
+                    "prefilter hits: %llu, confirm windows: %llu, confirmed: %llu, fallback matches: %llu\n", name
+                , stats.native, stats.prefiltered, stats.capped, stats.fallback, stats.unsupported
+                , stats.prefilter_hits, stats.confirms, stats.confirmed_matches, stats.fallback_matches);
+}
+
+static void printBuild(const char * name, const struct build_stats& stats)
+{
+    fprintf(stdout, "[%10s] build: %9.4f ms, load: %7.4f ms, size: %" PRIu64 " bytes\n", name
+                , stats.build_time, stats.load_time, stats.size);
+}
+
+static void printCaptures(const char * name, const struct result& res)
+{
+    fprintf(stdout, "[%10s] capture groups: %" PRIu64 " (%.2f per match)\n", name
+                , res.captures, res.matches ? (double)res.captures / res.matches : 0.0);
+}
+
 static void printResult(const char * name, const struct result& res)
 {
-    fprintf(stdout, "[%10s] pre_time: %7.4f ms, time: %7.1f ms (+/- %4.1f %%), matches: '%8d'\n", name
+    fprintf(stdout, "[%10s] pre_time: %7.4f ms, time: %7.1f ms (+/- %4.1f %%), matches: '%8" PRIu64 "'\n", name
                 , res.pre_time, res.time, (res.time_sd / res.time) * 100, res.matches);
+    printRate(name, res);
+    printPerf(name, res.perf);
     fflush(stdout);
 }
 
-static std::string load(const char * file_name)
+/* counters are read after the engine returns, they only count inside START/STOP_SCAN_TIME */
+static void readPerf(size_t subject_len, int repeat, struct result * res)
+{
+    if (!perf_enabled) {
+        return;
+    }
+
+    res->perf = (struct perf_counters){};
+    perf_read(&res->perf);
+    res->perf.scanned_kb = (double)subject_len * repeat / 1024;
+}
+
+static int run_engine(size_t iter, const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res)
+{
+    int ret = -1;
+
+    regex_encoding = runs[iter].encoding;
+    regex_captures = runs[iter].extract;
+
+    perf_reset();
+    alloc_select(runs[iter].allocator);
+    if (input_blocks) {
+        const struct blocks * blocks = runs[iter].stream ? stream_blocks : input_blocks;
+
+        if (runs[iter].find_all_blocks) {
+            ret = runs[iter].find_all_blocks(pattern, blocks, repeat, res);
+        }
+        readPerf(blocks->bytes, repeat, res);
+    } else {
+        if (runs[iter].find_all) {
+            ret = runs[iter].find_all(pattern, subject, subject_len, repeat, res);
+        }
+        readPerf(subject_len, repeat, res);
+    }
+    alloc_select(ALLOC_SYSTEM);
+
+    return ret;
+}
+
+static void writePerfHeader(FILE * f, const char * name)
+{
+    if (!perf_enabled) {
+        return;
+    }
+
+    fprintf(f, "%s [ipc];%s [branch-miss %%];%s [L1d-miss/KB];%s [LLC-miss/KB];%s [dTLB-miss/KB];", name, name, name, name, name);
+}
+
+static void writePerf(FILE * f, const struct perf_counters& counters)
+{
+    struct perf_metrics metrics;
+
+    if (!perf_enabled) {
+        return;
+    }
+
+    perf_get_metrics(&counters, &metrics);
+    fprintf(f, "%.3f;%.3f;%.3f;%.4f;%.4f;", metrics.ipc, metrics.branch_miss_rate, metrics.l1d_per_kb, metrics.llc_per_kb, metrics.dtlb_per_kb);
+}
+
+static void appendLines(std::istream& in, bool keep_lines, std::string * out)
+{
+    while (!in.eof()) {
+        std::string line;
+        std::getline(in, line);
+        out->append(line);
+        if (keep_lines) {
+            out->push_back('\n');
+        }
+    }
+}
+
+/* the line breaks are dropped unless the lines are kept as records, zstd and lz4 files are decompressed first */
+static std::string load(const char * file_name, bool keep_lines)
 {
     std::string ret;
 
     do {
+        if (compress_detect(file_name) != COMPRESS_NONE) {
+            std::string raw;
+            if (!decompress_file(file_name, &raw)) {
+                break;
+            }
+            std::istringstream file(raw);
+            raw.clear();
+            appendLines(file, keep_lines, &ret);
+            break;
+        }
+
         std::ifstream file(file_name);
         if (!file.is_open()) {
             fprintf(stderr, "Cannot open '%s'!\n", file_name);
             break;
         }
-
-        while (!file.eof()) {
-            std::string line;
-            std::getline(file, line);
-            ret.append(line);
-        }
+        appendLines(file, keep_lines, &ret);
     } while (false);
 
     return ret;
 }
 
+/* empty lines are skipped, the records point into data */
+static void splitRecords(const std::string& data, Records * records)
+{
+    size_t bytes = 0;
+
+    for (size_t pos = 0; pos < data.size(); ) {
+        size_t end = data.find('\n', pos);
+        if (end == std::string::npos) {
+            end = data.size();
+        }
+        if (end > pos) {
+            records->flow.push_back(records->data.size());
+            records->data.push_back(data.data() + pos);
+            records->len.push_back(end - pos);
+            bytes += end - pos;
+        }
+        pos = end + 1;
+    }
+
+    records->blocks = {records->data.data(), records->len.data(), records->flow.data(), records->data.size(),
+                       (unsigned int)records->data.size(), bytes};
+}
+
+/* --tiered on flat input: fixed size chunks, a new tier is swapped in between two chunks */
+static void splitChunks(const std::string& data, size_t chunk, Records * records)
+{
+    for (size_t pos = 0; pos < data.size(); pos += chunk) {
+        records->flow.push_back(0);
+        records->data.push_back(data.data() + pos);
+        records->len.push_back(std::min(chunk, data.size() - pos));
+    }
+
+    records->blocks = {records->data.data(), records->len.data(), records->flow.data(), records->data.size(),
+                       1, data.size()};
+}
+
 static std::vector<std::string> loadRegex(char const * file_name)
 {
     std::vector<std::string> regexes;
@@ -122,20 +382,82 @@ static std::vector<std::string> loadRegex(char const * file_name)
     return regexes;
 }
 
-static void find_all(const char* pattern, const char* subject, int subject_len, int repeat, struct result * engine_results)
+/* runs one repetition per engine in turn, so slow drifts (thermal, frequency, noisy
+ * neighbours) are spread over all engines instead of hitting one engine's block */
+static void find_all_interleaved(const char* pattern, const char* subject, size_t subject_len, int repeat,
+                                 struct result * engine_results, std::vector<bool>& failed)
+{
+    size_t const engines_len = runs.size();
+    std::vector<std::vector<double>> times(engines_len);
+    std::vector<double> pre_times(engines_len, 0);
+
+    for (int round = 0; round < repeat; round++) {
+        for (size_t iter = 0; iter < engines_len; iter++) {
+            struct result res = {};
+
+            if (failed[iter]) {
+                continue;
+            }
+
+            if (run_engine(iter, pattern, subject, subject_len, 1, &res) == -1) {
+                failed[iter] = true;
+                continue;
+            }
+
+            times[iter].push_back(res.time);
+            pre_times[iter] += res.pre_time;
+            engine_results[iter].matches = res.matches;
+            engine_results[iter].captures = res.captures;
+            perf_add(&engine_results[iter].perf, &res.perf);
+        }
+    }
+
+    for (size_t iter = 0; iter < engines_len; iter++) {
+        if (failed[iter] || times[iter].empty()) {
+            failed[iter] = true;
+            continue;
+        }
+
+        get_mean_and_derivation(pre_times[iter] / times[iter].size(), times[iter].data(), times[iter].size(), &engine_results[iter]);
+    }
+}
+
+static void find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * engine_results)
 {
     fprintf(stdout, "-----------------\nRegex: '%s'\n", pattern);
 
-    for (size_t iter = 0; iter < sizeof(engines)/sizeof(engines[0]); iter++) {
-        int ret = engines[iter].find_all(pattern, subject, subject_len, repeat, &(engine_results[iter]));
-        if (ret == -1) {
+    std::vector<bool> failed(runs.size(), false);
+
+    if (env.interleaved) {
+        find_all_interleaved(pattern, subject, subject_len, repeat, engine_results, failed);
+    } else {
+        for (size_t iter = 0; iter < runs.size(); iter++) {
+            int ret = run_engine(iter, pattern, subject, subject_len, repeat, &(engine_results[iter]));
+            failed[iter] = (ret == -1);
+        }
+    }
+
+    for (size_t iter = 0; iter < runs.size(); iter++) {
+        if (failed[iter]) {
             engine_results[iter].pre_time = 0;
             engine_results[iter].time = 0;
             engine_results[iter].time_sd = 0;
             engine_results[iter].matches = 0;
+            engine_results[iter].captures = 0;
             engine_results[iter].score = 0;
-        } else {
-            printResult(engines[iter].name, engine_results[iter]);
+            engine_results[iter].perf = (struct perf_counters){};
+        }
+    }
+
+    double const ceiling = ceilingTime(engine_results);
+    double const bytes = input_blocks ? input_blocks->bytes : subject_len;
+    for (size_t iter = 0; iter < runs.size(); iter++) {
+        if (!failed[iter]) {
+            printResult(runs[iter].name, engine_results[iter]);
+            printThroughput(runs[iter].name, bytes, engine_results[iter].time, ceiling);
+            if (runs[iter].extract) {
+                printCaptures(runs[iter].name, engine_results[iter]);
+            }
         }
     }
 
@@ -143,16 +465,16 @@ static void find_all(const char* pattern, const char* subject, int subject_len,
     for (int top = 0; top < score_points; top++) {
         double best = 0;
 
-        for (size_t iter = 0; iter < sizeof(engines)/sizeof(engines[0]); iter++) {
-            if (engine_results[iter].time > 0 &&
+        for (size_t iter = 0; iter < runs.size(); iter++) {
+            if (engine_results[iter].time > 0 && !runs[iter].baseline &&
                 engine_results[iter].score == 0 &&
                 (best == 0 || best > engine_results[iter].time)) {
                 best = engine_results[iter].time;
             }
         }
 
-        for (size_t iter = 0; iter < sizeof(engines)/sizeof(engines[0]); iter++) {
-            if (engine_results[iter].time > 0 && best == engine_results[iter].time) {
+        for (size_t iter = 0; iter < runs.size(); iter++) {
+            if (engine_results[iter].time > 0 && !runs[iter].baseline && best == engine_results[iter].time) {
                 engine_results[iter].score = score_points;
             }
         }
@@ -162,6 +484,49 @@ static void find_all(const char* pattern, const char* subject, int subject_len,
 
 }
 
+/*
+ * Extraction cost per engine of --captures: the match time of the run with
+ * groups against the run right before it, which only finds the matches. The
+ * rankings of both modes show where the extraction reorders the engines.
+ */
+static void printCapturePenalty(const std::vector<struct result>& totals)
+{
+    std::vector<size_t> plain;
+    std::vector<size_t> extract;
+
+    fprintf(stdout, "-----------------\nCapture extraction:\n");
+    for (size_t iter = 1; iter < runs.size(); iter++) {
+        if (!runs[iter].extract) {
+            continue;
+        }
+
+        const struct result& base = totals[iter - 1];
+        const struct result& groups = totals[iter];
+        if (base.time <= 0 || groups.time <= 0) {
+            continue;
+        }
+        plain.push_back(iter - 1);
+        extract.push_back(iter);
+
+        fprintf(stdout, "[%10s] match time: %7.1f ms -> %7.1f ms, throughput: %5.1f %% of the match-only run, groups: %" PRIu64 "\n",
+                runs[iter - 1].name, base.time, groups.time, base.time * 100 / groups.time, groups.captures);
+    }
+
+    auto const faster = [&](size_t a, size_t b) { return totals[a].time < totals[b].time; };
+    std::stable_sort(plain.begin(), plain.end(), faster);
+    std::stable_sort(extract.begin(), extract.end(), faster);
+
+    fprintf(stdout, "Ranking without captures:");
+    for (size_t rank = 0; rank < plain.size(); rank++) {
+        fprintf(stdout, "%s %s", rank ? "," : "", runs[plain[rank]].name);
+    }
+    fprintf(stdout, "\nRanking with captures:   ");
+    for (size_t rank = 0; rank < extract.size(); rank++) {
+        fprintf(stdout, "%s %s", rank ? "," : "", runs[extract[rank]].name);
+    }
+    fprintf(stdout, "\n");
+}
+
 void get_mean_and_derivation(double pre_times, const double * times, uint32_t times_len, struct result * res)
 {
     double mean, sd, var, sum = 0.0, sdev = 0.0;
@@ -177,23 +542,740 @@ void get_mean_and_derivation(double pre_times, const double * times, uint32_t ti
         res->time_sd = 0;
     }
 
-    /* get mean value */
-    for (uint32_t iter = 0; iter < times_len; iter++) {
-        sum += times[iter];
+    /* get mean value */
+    for (uint32_t iter = 0; iter < times_len; iter++) {
+        sum += times[iter];
+    }
+    mean = sum / times_len;
+
+    /* get variance */
+    for (uint32_t iter = 0; iter < times_len; iter++) {
+        sdev += (times[iter] - mean) * (times[iter] - mean);
+    }
+    var = sdev / (times_len - 1);
+
+    /* get standard derivation */
+    sd = sqrt(var);
+
+    res->time = mean;
+    res->time_sd = sd;
+}
+
+static const char * encodingName(int encoding)
+{
+    switch (encoding) {
+        case ENC_BYTES: return "bytes";
+        case ENC_UTF8:  return "utf8";
+        default:        return "native";
+    }
+}
+
+/* well-formed UTF-8: no overlong forms, surrogates or code points above U+10FFFF */
+static bool validUtf8(const char * data, size_t len)
+{
+    const unsigned char * const bytes = (const unsigned char *)data;
+    size_t pos = 0;
+
+    while (pos < len) {
+        unsigned char const c = bytes[pos];
+        size_t follow;
+        unsigned char min = 0x80;
+        unsigned char max = 0xbf;
+
+        if (c < 0x80) {
+            pos++;
+            continue;
+        } else if (c >= 0xc2 && c <= 0xdf) {
+            follow = 1;
+        } else if (c >= 0xe0 && c <= 0xef) {
+            follow = 2;
+            min = (c == 0xe0) ? 0xa0 : 0x80;
+            max = (c == 0xed) ? 0x9f : 0xbf;
+        } else if (c >= 0xf0 && c <= 0xf4) {
+            follow = 3;
+            min = (c == 0xf0) ? 0x90 : 0x80;
+            max = (c == 0xf4) ? 0x8f : 0xbf;
+        } else {
+            return false;
+        }
+
+        if (pos + follow >= len || bytes[pos + 1] < min || bytes[pos + 1] > max) {
+            return false;
+        }
+        for (size_t iter = 2; iter <= follow; iter++) {
+            if ((bytes[pos + iter] & 0xc0) != 0x80) {
+                return false;
+            }
+        }
+        pos += follow + 1;
+    }
+    return true;
+}
+
+static bool validUtf8(const struct blocks * blocks)
+{
+    for (size_t iter = 0; iter < blocks->count; iter++) {
+        if (!validUtf8(blocks->data[iter], blocks->len[iter])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * The engine names get the encoding appended when several encodings are compared.
+ * --captures only keeps the engines that can extract groups, each one is run
+ * without and right after that with extraction ("/cap").
+ */
+static void setupRuns()
+{
+    static std::vector<std::string> names;
+    size_t const engines_len = sizeof(engines)/sizeof(engines[0]);
+
+    for (int allocator : allocators) {
+        for (int encoding : encodings) {
+            for (size_t iter = 0; iter < engines_len; iter++) {
+                if (engines[iter].bytes_only && encoding == ENC_UTF8) {
+                    continue;
+                }
+                if (engines[iter].valid_utf8 && encoding == ENC_UTF8 && !input_valid_utf8) {
+                    continue;
+                }
+                if (engines[iter].no_caseless && regex_caseless == CASE_NATIVE) {
+                    continue;
+                }
+                if (!engines[iter].captures && captures_enabled) {
+                    continue;
+                }
+                /* hscan-strm only scans blocks of packets or records */
+                if (!input_blocks && !engines[iter].find_all) {
+                    continue;
+                }
+                /* ctre, boost, cppstd and regress only scan flat input */
+                if (input_blocks && !engines[iter].find_all_blocks) {
+                    continue;
+                }
+                struct engines run = engines[iter];
+                std::string name = run.name;
+                run.encoding = encoding;
+                run.allocator = allocator;
+                if (encodings.size() > 1) {
+                    name += "/";
+                    name += encodingName(encoding);
+                }
+                if (allocators.size() > 1) {
+                    name += "/";
+                    name += alloc_name(allocator);
+                }
+                runs.push_back(run);
+                names.push_back(name);
+                if (captures_enabled) {
+                    run.extract = true;
+                    runs.push_back(run);
+                    names.push_back(names.back() + "/cap");
+                }
+            }
+        }
+    }
+
+    for (size_t iter = 0; iter < runs.size(); iter++) {
+        runs[iter].name = names[iter].c_str();
+    }
+}
+
+static const char * caselessName(int caseless)
+{
+    switch (caseless) {
+        case CASE_NATIVE:   return "native";
+        case CASE_FOLD:     return "fold";
+        default:            return "off";
+    }
+}
+
+static void writeMeta(FILE * f)
+{
+    env_print(f, &env, "# ");
+    fprintf(f, "# perf=%d\n", perf_enabled);
+    fprintf(f, "# caseless=%s\n", caselessName(regex_caseless));
+    fprintf(f, "# normalize=%d\n", normalize_enabled);
+    fprintf(f, "# captures=%d\n", captures_enabled);
+    fprintf(f, "# is_match=%d\n", regex_is_match);
+    fprintf(f, "# records=%d\n", records_enabled);
+    fprintf(f, "# encoding=");
+    for (size_t iter = 0; iter < encodings.size(); iter++) {
+        fprintf(f, "%s%s", iter ? "," : "", encodingName(encodings[iter]));
+    }
+    fprintf(f, "\n");
+    fprintf(f, "# allocator=");
+    for (size_t iter = 0; iter < allocators.size(); iter++) {
+        fprintf(f, "%s%s", iter ? "," : "", alloc_name(allocators[iter]));
+    }
+    fprintf(f, "\n");
+}
+
+/* chunks of the arena and pool allocators, all chunks stay mapped until the end */
+static void printAllocStats()
+{
+    struct alloc_stats stats;
+
+    if (allocators.size() == 1 && allocators[0] == ALLOC_SYSTEM) {
+        return;
+    }
+
+    alloc_get_stats(&stats);
+    fprintf(stdout, "Allocators: %zu chunks, %.1f MB mapped, %.1f MB MAP_HUGETLB, %.1f MB transparent huge pages\n",
+            stats.chunks, stats.mapped / (1024.0 * 1024.0), stats.hugetlb / (1024.0 * 1024.0), stats.thp / (1024.0 * 1024.0));
+}
+
+/*
+ * Classes like [sS] spell out case insensitivity by hand. Engines match them
+ * as classes, a caseless flag on the literal is usually faster. Rules with an
+ * inline (?i) are skipped, the flag produces the same classes.
+ */
+static void reportCaseClasses(const std::vector<std::string>& regexes)
+{
+    size_t rules = 0;
+
+    for (size_t iter = 0; iter < regexes.size(); iter++) {
+        RegexNode node;
+
+        if (regexes[iter].find("(?i") != std::string::npos || !regex_parse(regexes[iter], &node, NULL)) {
+            continue;
+        }
+        int const pairs = regex_case_pairs(node);
+        if (pairs > 0) {
+            fprintf(stdout, "Rule %zu: %d hand-expanded case classes: %s\n", iter + 1, pairs, regexes[iter].c_str());
+            rules++;
+        }
+    }
+    fprintf(stdout, "Rules with hand-expanded case classes: %zu of %zu\n", rules, regexes.size());
+}
+
+/* replaces the rules by the normalized set, ids gets the input rules behind each rule, e.g. "3,17" */
+static void normalizeRegexes(std::vector<std::string> * regexes, std::vector<std::string> * ids)
+{
+    NormalizeStats stats;
+    NormalizedRules normalized = normalize_rules(*regexes, &stats);
+
+    fprintf(stdout, "Normalized rules: %zu of %zu left, %zu duplicates, %zu unescaped, %zu prefixes stripped, "
+            "%zu caseless literals, %zu alternations factored\n",
+            normalized.rules.size(), regexes->size(), stats.duplicates, stats.unescaped, stats.stripped,
+            stats.caseless, stats.factored);
+
+    ids->clear();
+    for (size_t iter = 0; iter < normalized.rules.size(); iter++) {
+        std::string id;
+
+        for (size_t input : normalized.ids[iter]) {
+            if (!id.empty()) {
+                id += ",";
+            }
+            id += std::to_string(input);
+        }
+        if (normalized.ids[iter].size() > 1) {
+            fprintf(stdout, "Rule %zu stands for rules %s\n", iter + 1, id.c_str());
+        }
+        ids->push_back(id);
+    }
+
+    regexes->swap(normalized.rules);
+}
+
+/* the patterns of --caseless fold: letters and classes lower case only, for the lowercased input */
+static void foldRegexes(std::vector<std::string> * regexes, std::vector<std::string> * ids)
+{
+    std::vector<std::string> folded;
+    std::vector<std::string> folded_ids;
+
+    for (size_t iter = 0; iter < regexes->size(); iter++) {
+        const std::string& regex_ = (*regexes)[iter];
+        std::string text;
+        std::string error;
+
+        if (!regex_fold_pattern(regex_, &text, &error)) {
+            fprintf(stdout, "Cannot fold '%s': %s\n", regex_.c_str(), error.c_str());
+            continue;
+        }
+        folded.push_back(text);
+        if (iter < ids->size()) {
+            folded_ids.push_back((*ids)[iter]);
+        }
+    }
+
+    fprintf(stdout, "Case folding: %zu of %zu rules folded, %zu dropped\n",
+            folded.size(), regexes->size(), regexes->size() - folded.size());
+    regexes->swap(folded);
+    ids->swap(folded_ids);
+}
+
+static void foldInput(char * data, size_t len)
+{
+    TIME_TYPE start, end;
+
+    GET_TIME(start);
+    fold_lower(data, len);
+    GET_TIME(end);
+
+    double const ms = TIME_DIFF_IN_MS(start, end);
+    fprintf(stdout, "Lowercased input: %zu bytes in %.3f ms (%.2f GB/s)\n",
+            len, ms, ms > 0 ? len / (ms * 1e6) : 0.0);
+}
+
+/* one multi-pattern engine of the cost attribution, scan_time measures a subset of rules */
+struct AttributeEngine {
+    const char * name;
+    bool hyperscan;                 /* callbacks per rule and hs_expression_info() are available */
+    std::vector<size_t> rules;      /* indices into the loaded rules */
+    SetScanTime scan_time;
+};
+
+#define ATTRIBUTE_TOP 10
+
+static void writeAttribution(FILE * f, const AttributeEngine& engine, const AttributeResult& result,
+                             const std::vector<std::string>& regexes, const std::vector<std::string>& ids,
+                             const std::vector<uint64_t>& matches)
+{
+    std::vector<size_t> ranked;
+    for (size_t iter = 0; iter < engine.rules.size(); iter++) {
+        ranked.push_back(iter);
+    }
+    std::stable_sort(ranked.begin(), ranked.end(), [&](size_t a, size_t b) {
+        return result.marginal[a] > result.marginal[b];
+    });
+
+    fprintf(stdout, "[%10s] full scan: %.3f ms | noise: %.3f ms | recompiles: %zu\n",
+            engine.name, result.full_time, result.noise, result.recompiles);
+    fprintf(stdout, "%6s %8s %14s %8s %10s %6s %6s %-16s %s\n",
+            "rank", "id", "marginal [ms]", "share", "matches", "min", "max", "slow path", "regex");
+
+    for (size_t rank = 0; rank < ranked.size(); rank++) {
+        size_t const rule = engine.rules[ranked[rank]];
+        double const share = result.full_time > 0 ? result.marginal[ranked[rank]] * 100 / result.full_time : 0;
+        struct hs_rule_info info = {};
+        char error[256];
+        bool const has_info = engine.hyperscan && !matches.empty() && hs_rule_info(regexes[rule].c_str(), &info, error, sizeof(error));
+        char max_width[16] = "inf";
+
+        if (info.max_width != UINT_MAX) {
+            snprintf(max_width, sizeof(max_width), "%u", info.max_width);
+        }
+
+        if (rank < ATTRIBUTE_TOP) {
+            if (has_info) {
+                fprintf(stdout, "%6zu %8s %14.3f %7.1f%% %10" PRIu64 " %6u %6s %-16s %s\n", rank + 1, ids[rule].c_str(),
+                        result.marginal[ranked[rank]], share, matches[ranked[rank]], info.min_width, max_width,
+                        info.slow, regexes[rule].c_str());
+            } else {
+                fprintf(stdout, "%6zu %8s %14.3f %7.1f%% %10s %6s %6s %-16s %s\n", rank + 1, ids[rule].c_str(),
+                        result.marginal[ranked[rank]], share, "-", "-", "-", "-", regexes[rule].c_str());
+            }
+        }
+
+        if (f) {
+            fprintf(f, "%s;%zu;%s;%s;%.4f;%.2f;", engine.name, rank + 1, ids[rule].c_str(), regexes[rule].c_str(),
+                    result.marginal[ranked[rank]], share);
+            if (has_info) {
+                fprintf(f, "%" PRIu64 ";%u;%s;%d;%d;%s\n", matches[ranked[rank]], info.min_width, max_width,
+                        info.unordered, info.at_eod, info.slow);
+            } else {
+                fprintf(f, ";;;;;\n");
+            }
+        }
+    }
+    fprintf(stdout, "\n");
+}
+
+/*
+ * Ranks the rules of the multi-pattern engines by their marginal scan cost,
+ * see attribute.hpp. Hyperscan also reports the match callbacks per rule and
+ * the hs_expression_info() properties.
+ */
+static int attributeCosts(const std::vector<std::string>& regexes, const std::vector<std::string>& ids,
+                          const std::string& data, int repeat, AttributeMethod method, const char * file_name)
+{
+    AttributeEngine hs_engine = {"hscan-multi", true, {}, nullptr};
+    AttributeEngine ra_engine = {"ra-meta", false, {}, nullptr};
+
+    for (size_t iter = 0; iter < regexes.size(); iter++) {
+        if (hs_verify_regex(regexes[iter].c_str())) {
+            hs_engine.rules.push_back(iter);
+        }
+        if (rust_ra_verify(regexes[iter].c_str())) {
+            ra_engine.rules.push_back(iter);
+        }
+    }
+
+    hs_engine.scan_time = [&](const std::vector<size_t>& subset) {
+        std::vector<const char *> patterns;
+        for (size_t rule : subset) {
+            patterns.push_back(regexes[hs_engine.rules[rule]].c_str());
+        }
+        return hs_multi_scan_time(patterns.data(), patterns.size(), data.data(), data.size(), HS_VARIANT_SOM, repeat, NULL);
+    };
+    ra_engine.scan_time = [&](const std::vector<size_t>& subset) {
+        std::vector<const char *> patterns;
+        for (size_t rule : subset) {
+            patterns.push_back(regexes[ra_engine.rules[rule]].c_str());
+        }
+        return rust_ra_multi_scan_time(patterns.data(), patterns.size(), data.data(), data.size(), RA_META, repeat);
+    };
+    const AttributeEngine * const attribute_engines[] = {&hs_engine, &ra_engine};
+
+    FILE * f = NULL;
+    if (file_name) {
+        f = fopen(file_name, "w");
+        if (!f) {
+            fprintf(stderr, "Cannot open '%s'!\n", file_name);
+            return -1;
+        }
+        writeMeta(f);
+        fprintf(f, "engine;rank;id;regex;marginal [ms];share [%%];matches;min width;max width;unordered;eod;slow path\n");
+    }
+
+    printf("\n[Attribute the scan time to the rules, %s]\n\n", method == ATTRIBUTE_LOO ? "leave-one-out" : "group bisection");
+
+    for (const AttributeEngine * engine : attribute_engines) {
+        AttributeResult result;
+        std::vector<uint64_t> matches;
+
+        if (engine->rules.empty()) {
+            continue;
+        }
+        if (!attribute_rules(engine->rules.size(), engine->scan_time, method, &result)) {
+            fprintf(stderr, "ERROR: Attribution of %s failed\n", engine->name);
+            continue;
+        }
+
+        if (engine->hyperscan) {
+            std::vector<const char *> patterns;
+            for (size_t rule : engine->rules) {
+                patterns.push_back(regexes[rule].c_str());
+            }
+            matches.resize(patterns.size());
+            if (hs_multi_scan_time(patterns.data(), patterns.size(), data.data(), data.size(), HS_VARIANT_SOM, 1, matches.data()) < 0) {
+                matches.clear();
+            }
+        }
+
+        writeAttribution(f, *engine, result, regexes, ids, matches);
+    }
+
+    if (f) {
+        fclose(f);
+    }
+    return 0;
+}
+
+/*
+ * Scans the rule set with tiered compilation, see tiered.hpp: time to the
+ * first scan and the first match, throughput over time and the time each rule
+ * reached its final tier.
+ */
+static int tieredRun(const std::vector<std::string>& regexes, const std::vector<std::string>& ids,
+                     const struct blocks * blocks, int passes, const char * file_name)
+{
+    TieredResult result;
+
+    printf("\n[Tiered compilation, %zu rules, %d passes over %zu %s]\n\n", regexes.size(), passes, blocks->count, input_unit);
+
+    if (!tiered_scan(regexes, blocks, passes, &result)) {
+        return -1;
+    }
+
+    printf("%-20s %10.2f ms\n", "first scan", result.first_scan);
+    if (result.first_match >= 0) {
+        printf("%-20s %10.2f ms\n", "first match", result.first_match);
+    } else {
+        printf("%-20s %10s\n", "first match", "-");
+    }
+    if (result.hs_ready >= 0) {
+        printf("%-20s %10.2f ms\n", "hyperscan ready", result.hs_ready);
+    } else {
+        printf("%-20s %10s\n", "hyperscan ready", "-");
+    }
+    printf("%-20s %10.2f ms, %" PRIu64 " matches\n\n", "total", result.total, result.matches);
+
+    /* at most 20 rows, a row is the throughput since the previous row */
+    size_t const rows = result.timeline.size();
+    size_t const step = rows > 20 ? (rows + 19) / 20 : 1;
+    printf("%10s %12s %10s %10s %10s\n", "time [ms]", "MB/s", "interp", "jit", "hyperscan");
+    double prev_time = result.first_scan;
+    uint64_t prev_bytes = 0;
+    for (size_t row = 0; row < rows; row += step) {
+        const TieredSample& sample = result.timeline[std::min(row + step - 1, rows - 1)];
+        double const interval = sample.time - prev_time;
+        double const rate = interval > 0 ? (sample.bytes - prev_bytes) / (interval * 1000.0) : 0;
+
+        printf("%10.2f %12.1f %10zu %10zu %10zu\n", sample.time, rate, sample.rules[TIER_INTERP],
+               sample.rules[TIER_JIT], sample.rules[TIER_HS]);
+        prev_time = sample.time;
+        prev_bytes = sample.bytes;
+    }
+
+    printf("\n%-12s %8s %12s %12s %12s\n", "final tier", "rules", "p50 [ms]", "p90 [ms]", "max [ms]");
+    for (int tier = TIER_NONE; tier <= TIER_HS; tier++) {
+        std::vector<double> times;
+        for (size_t iter = 0; iter < regexes.size(); iter++) {
+            if (result.final_tier[iter] == tier) {
+                times.push_back(result.final_time[iter]);
+            }
+        }
+        if (times.empty()) {
+            continue;
+        }
+        std::sort(times.begin(), times.end());
+        printf("%-12s %8zu %12.2f %12.2f %12.2f\n", tier_name((Tier)tier), times.size(),
+               times[times.size() / 2], times[(times.size() * 9) / 10], times.back());
+    }
+    printf("\n");
+
+    if (file_name) {
+        FILE * f = fopen(file_name, "w");
+        if (!f) {
+            fprintf(stderr, "Cannot open '%s'!\n", file_name);
+            return -1;
+        }
+        writeMeta(f);
+        fprintf(f, "id;regex;final tier;final at [ms]\n");
+        for (size_t iter = 0; iter < regexes.size(); iter++) {
+            fprintf(f, "%s;%s;%s;%.3f\n", ids[iter].c_str(), regexes[iter].c_str(),
+                    tier_name(result.final_tier[iter]), result.final_time[iter]);
+        }
+        fclose(f);
+    }
+    return 0;
+}
+
+/*
+ * Applies a stream of rule updates to a partitioned HyperscanPm while scanner
+ * threads scan the input, see reload.hpp: update latency and the throughput
+ * during the updates against the throughput between them.
+ */
+static int reloadRun(const std::vector<std::string>& regexes, const std::vector<std::string>& ids,
+                     const std::string& data, const ReloadOptions& opts, const char * file_name)
+{
+    std::vector<std::string> rules;
+    std::vector<size_t> rule_index;
+    ReloadResult result;
+
+    for (size_t iter = 0; iter < regexes.size(); iter++) {
+        if (hs_verify_regex(regexes[iter].c_str())) {
+            rules.push_back(regexes[iter]);
+            rule_index.push_back(iter);
+        }
+    }
+
+    printf("\n[Hot reload, %zu rules in %u partitions, %u scanner threads, %u updates every %.1f ms]\n\n",
+           rules.size(), opts.partitions, opts.threads, opts.updates, opts.interval);
+
+    if (!reload_run(rules, data.data(), data.size(), opts, &result)) {
+        return -1;
+    }
+
+    printf("%-24s %10.2f ms\n", "compile, one database", result.full_compile);
+    printf("%-24s %10.2f ms\n", "compile, partitioned", result.partitioned_compile);
+    printf("%-24s %10.1f MB/s\n", "scan between updates", result.quiet_rate);
+    if (result.min_rate >= 0) {
+        printf("%-24s %10.1f MB/s (%.1f%% dip)\n", "worst sample in update", result.min_rate,
+               result.quiet_rate > 0 ? 100.0 * (1 - result.min_rate / result.quiet_rate) : 0);
+    }
+    printf("%-24s %10.1f MB/s\n\n", "scan overall", result.total > 0 ? result.bytes / (result.total * 1000.0) : 0);
+
+    printf("%-8s %8s %12s %12s %12s %12s\n", "update", "count", "p50 [ms]", "p90 [ms]", "max [ms]", "MB/s");
+    for (int op = ReloadUpdate::REMOVE; op <= ReloadUpdate::MODIFY; op++) {
+        std::vector<double> latencies;
+        double rate = 0;
+        for (const auto& update : result.updates) {
+            if (update.op == op && update.ok) {
+                latencies.push_back(update.latency);
+                rate += update.rate;
+            }
+        }
+        if (latencies.empty()) {
+            continue;
+        }
+        std::sort(latencies.begin(), latencies.end());
+        printf("%-8s %8zu %12.2f %12.2f %12.2f %12.1f\n", reload_op_name((ReloadUpdate::Op)op), latencies.size(),
+               latencies[latencies.size() / 2], latencies[(latencies.size() * 9) / 10], latencies.back(),
+               rate / latencies.size());
+    }
+    printf("\n");
+
+    if (file_name) {
+        FILE * f = fopen(file_name, "w");
+        if (!f) {
+            fprintf(stderr, "Cannot open '%s'!\n", file_name);
+            return -1;
+        }
+        writeMeta(f);
+        fprintf(f, "update;op;id;regex;partition;start [ms];latency [ms];MB/s;ok\n");
+        for (size_t iter = 0; iter < result.updates.size(); iter++) {
+            const ReloadUpdate& update = result.updates[iter];
+            fprintf(f, "%zu;%s;%s;%s;%u;%.3f;%.3f;%.1f;%d\n", iter + 1, reload_op_name(update.op),
+                    ids[rule_index[update.rule]].c_str(), rules[update.rule].c_str(), update.partition,
+                    update.start, update.latency, update.rate, update.ok);
+        }
+        fclose(f);
+    }
+    return 0;
+}
+
+/*
+ * Forks scanner processes that either map one shared database or compile their
+ * own, see shared_db.hpp: total RSS and PSS of the workers and the aggregate
+ * scan throughput.
+ */
+static int sharedDbRun(const std::vector<std::string>& regexes, const std::string& data, int repeat,
+                       const SharedDbOptions& opts)
+{
+    std::vector<std::string> rules;
+    double private_pss = 0;
+
+    for (const auto& regex : regexes) {
+        if (hs_verify_regex(regex.c_str())) {
+            rules.push_back(regex);
+        }
+    }
+
+    printf("\n[Shared database, %zu rules, %u worker processes, %d scans each]\n\n", rules.size(), opts.workers, repeat);
+    printf("%-10s %12s %12s %12s %12s %12s\n", "database", "compile [ms]", "setup [ms]", "RSS [MB]", "PSS [MB]", "MB/s");
+
+    for (int shared = 0; shared <= 1; shared++) {
+        SharedDbResult result;
+
+        if ((shared && !opts.shared) || (!shared && !opts.private_db)) {
+            continue;
+        }
+        if (!shared_db_run(rules, data.data(), data.size(), repeat, shared, opts.workers, &result)) {
+            fprintf(stderr, "ERROR: %s workers failed\n", shared ? "Shared" : "Private");
+            return -1;
+        }
+
+        double setup = 0, rss = 0, pss = 0, scan = 0;
+        uint64_t bytes = 0;
+        for (const auto& worker : result.workers) {
+            if (!worker.ok) {
+                fprintf(stderr, "ERROR: %s worker failed\n", shared ? "Shared" : "Private");
+                return -1;
+            }
+            setup += worker.setup / result.workers.size();
+            rss += worker.rss / 1024.0;
+            pss += worker.pss / 1024.0;
+            scan = std::max(scan, worker.scan);
+            bytes += worker.bytes;
+        }
+
+        printf("%-10s %12.2f %12.2f %12.1f %12.1f %12.1f", shared ? "shared" : "private", result.compile, setup, rss, pss,
+               scan > 0 ? bytes / (scan * 1000.0) : 0);
+        if (shared) {
+            printf("  (%.1f MB database", result.db_size / (1024.0 * 1024.0));
+            if (private_pss > 0) {
+                printf(", PSS %.1f%% of private", 100.0 * pss / private_pss);
+            }
+            printf(")");
+        } else {
+            private_pss = pss;
+        }
+        printf("\n");
+    }
+    printf("\n");
+
+    return 0;
+}
+
+/*
+ * Scans a file while a producer thread reads or decompresses it, see
+ * compress.hpp: the input stage alone, the scan alone and both overlapped, and
+ * which side of the ring waited for the other one.
+ */
+static int pipelineRun(const std::vector<std::string>& regexes, const char * file_name, const PipelineOptions& opts)
+{
+    std::vector<std::string> hs_rules;
+    PipelineResult input;
+
+    for (const auto& regex : regexes) {
+        if (hs_verify_regex(regex.c_str())) {
+            hs_rules.push_back(regex);
+        }
+    }
+
+    if (!pipeline_run(file_name, hs_rules, PIPELINE_READ_ONLY, opts, &input)) {
+        return -1;
+    }
+
+    CompressFormat const fmt = compress_detect(file_name);
+    printf("\n[Pipeline, %s %s input, %.1f MB -> %.1f MB (ratio %.2f), %.1f MB chunks, %u buffers, %zu bytes overlap]\n\n",
+           pipeline_input_name(opts.input), compress_name(fmt), input.file_bytes / (1024.0 * 1024.0),
+           input.bytes / (1024.0 * 1024.0), input.file_bytes ? (double)input.bytes / input.file_bytes : 0.0,
+           opts.chunk / (1024.0 * 1024.0), opts.ring, opts.overlap);
+    printf("input only: %.1f MB/s (%.2f ms, %" PRIu64 " chunks)\n\n",
+           input.total > 0 ? input.bytes / (input.total * 1000.0) : 0, input.total, input.chunks);
+
+    printf("%-10s %8s %12s %12s %12s %12s %12s %14s %8s  %s\n", "engine", "threads", "matches", "scan [ms]",
+           "I/O wait", "prod. wait", "scan MB/s", "pipelined MB/s", "overlap", "bottleneck");
+
+    for (int engine = PIPELINE_HS_STREAM; engine <= PIPELINE_PCRE2_JIT; engine++) {
+        PipelineResult result;
+
+        if (!pipeline_run(file_name, engine == PIPELINE_HS_STREAM ? hs_rules : regexes, (PipelineEngine)engine, opts,
+                          &result)) {
+            fprintf(stderr, "ERROR: %s pipeline failed\n", pipeline_engine_name((PipelineEngine)engine));
+            return -1;
+        }
+
+        /* the share of the shorter stage hidden behind the longer one */
+        double const scan = result.scan / result.threads;
+        double const io_wait = result.scanner_wait / result.threads;
+        double const shorter = std::min(scan, input.total);
+        double const overlap = shorter > 0 ? std::max(0.0, std::min(1.0, (input.total + scan - result.total) / shorter)) : 0;
+
+        /* a producer blocked on a full ring waits for the scanners and the other way round */
+        printf("%-10s %8u %12" PRIu64 " %12.2f %12.2f %12.2f %12.1f %14.1f %7.1f%%  %s\n",
+               pipeline_engine_name((PipelineEngine)engine), result.threads, result.matches, scan, io_wait,
+               result.producer_wait, scan > 0 ? result.bytes / (scan * 1000.0) : 0,
+               result.total > 0 ? result.bytes / (result.total * 1000.0) : 0, 100.0 * overlap,
+               result.producer_wait > io_wait ? "scan" : "input");
+    }
+    printf("\n");
+
+    return 0;
+}
+
+/*
+ * Delivers every match of a multi-pattern scan to a consumer thread, see
+ * match_sink.hpp: scan throughput and delivery latency per backpressure
+ * policy, next to counting the matches and copying them in the scan.
+ */
+static int sinkRun(const std::vector<std::string>& regexes, const std::string& data, int repeat, const SinkOptions& opts)
+{
+    std::vector<std::string> rules;
+    std::vector<SinkResult> results;
+
+    for (const auto& regex : regexes) {
+        if (hs_verify_regex(regex.c_str())) {
+            rules.push_back(regex);
+        }
     }
-    mean = sum / times_len;
 
-    /* get variance */
-    for (uint32_t iter = 0; iter < times_len; iter++) {
-        sdev += (times[iter] - mean) * (times[iter] - mean);
+    printf("\n[Match sink, %zu rules, %zu records ring, %d scans]\n\n", rules.size(), opts.capacity, repeat);
+    if (!sink_run(rules, data.data(), data.size(), repeat, opts, &results)) {
+        return -1;
     }
-    var = sdev / (times_len - 1);
 
-    /* get standard derivation */
-    sd = sqrt(var);
+    printf("%-8s %12s %12s %12s %12s %10s %10s %10s %10s %10s %10s\n", "sink", "matches", "delivered", "dropped",
+           "spill peak", "scan MB/s", "total MB/s", "stall [ms]", "p50 [us]", "p99 [us]", "max [us]");
+    for (const auto& result : results) {
+        bool const sink = result.stats.pushed > 0;
 
-    res->time = mean;
-    res->time_sd = sd;
+        printf("%-8s %12" PRIu64 " %12" PRIu64 " %12" PRIu64 " %12zu %10.1f %10.1f %10.2f %10.1f %10.1f %10.1f\n",
+               result.mode.c_str(), result.matches, sink ? result.stats.delivered : result.matches, result.stats.dropped,
+               result.stats.spill_peak, result.scan > 0 ? result.bytes / (result.scan * 1000.0) : 0,
+               result.total > 0 ? result.bytes / (result.total * 1000.0) : 0, result.stats.stall,
+               result.stats.latency_p50, result.stats.latency_p99, result.stats.latency_max);
+    }
+    printf("\n");
+
+    return 0;
 }
 
 static std::vector<std::string> str_split(const std::string &str, char delim) {
@@ -220,9 +1302,239 @@ int main(int argc, char **argv)
     int mode = 0;
     int c = 0;
     std::vector<std::string> regexes;
-
-    while ((c = getopt(argc, argv, "n:m:i:hvf:o:t:e:")) != -1) {
+    std::vector<std::string> rule_ids;
+    char const * attribute_file = NULL;
+    AttributeMethod attribute_method = ATTRIBUTE_BISECT;
+    bool generate = false;
+    CorpusOptions corpus_opts;
+    char const * corpus_out = NULL;
+    char const * pcap_file = NULL;
+#ifdef INCLUDE_PCAP
+    bool per_flow = false;
+    bool reassemble = false;
+#endif
+    char const * hs_info_file = NULL;
+    char const * tiered_file = NULL;
+    bool reload = false;
+    ReloadOptions reload_opts;
+    bool shared_db = false;
+    SharedDbOptions shared_db_opts;
+    bool pipeline = false;
+    PipelineOptions pipeline_opts;
+    bool match_sink = false;
+    SinkOptions sink_opts;
+
+    enum {
+        OPT_PIN = 256,
+        OPT_FIFO,
+        OPT_MLOCK,
+        OPT_INTERLEAVE,
+        OPT_PERF,
+        OPT_GEN,
+        OPT_GEN_OUT,
+        OPT_PCAP,
+        OPT_PER_FLOW,
+        OPT_REASSEMBLE,
+        OPT_HS_INFO,
+        OPT_CACHE_DIR,
+        OPT_RA_SIZE_LIMIT,
+        OPT_RE2_MAX_MEM,
+        OPT_ENCODING,
+        OPT_CASELESS,
+        OPT_NORMALIZE,
+        OPT_ATTRIBUTE,
+        OPT_ATTRIBUTE_METHOD,
+        OPT_CAPTURES,
+        OPT_IS_MATCH,
+        OPT_RECORDS,
+        OPT_TIERED,
+        OPT_RELOAD,
+        OPT_SHARED_DB,
+        OPT_PIPELINE,
+        OPT_MATCH_SINK,
+        OPT_ALLOCATOR,
+        OPT_CHECK_COMPRESS,
+    };
+
+    static struct option const long_options[] = {
+        {"pin",         required_argument,  NULL,   OPT_PIN},
+        {"fifo",        required_argument,  NULL,   OPT_FIFO},
+        {"mlock",       no_argument,        NULL,   OPT_MLOCK},
+        {"interleave",  no_argument,        NULL,   OPT_INTERLEAVE},
+        {"perf",        no_argument,        NULL,   OPT_PERF},
+        {"gen",         required_argument,  NULL,   OPT_GEN},
+        {"gen-out",     required_argument,  NULL,   OPT_GEN_OUT},
+        {"pcap",        required_argument,  NULL,   OPT_PCAP},
+#ifdef INCLUDE_PCAP
+        {"per-flow",    no_argument,        NULL,   OPT_PER_FLOW},
+        {"reassemble",  no_argument,        NULL,   OPT_REASSEMBLE},
+#endif
+        {"hs-info",     required_argument,  NULL,   OPT_HS_INFO},
+        {"cache-dir",   required_argument,  NULL,   OPT_CACHE_DIR},
+        {"ra-size-limit", required_argument, NULL,  OPT_RA_SIZE_LIMIT},
+        {"re2-max-mem", required_argument,  NULL,   OPT_RE2_MAX_MEM},
+        {"encoding",    required_argument,  NULL,   OPT_ENCODING},
+        {"caseless",    required_argument,  NULL,   OPT_CASELESS},
+        {"normalize",   no_argument,        NULL,   OPT_NORMALIZE},
+        {"attribute",   required_argument,  NULL,   OPT_ATTRIBUTE},
+        {"attribute-method", required_argument, NULL, OPT_ATTRIBUTE_METHOD},
+        {"captures",    no_argument,        NULL,   OPT_CAPTURES},
+        {"is-match",    no_argument,        NULL,   OPT_IS_MATCH},
+        {"records",     no_argument,        NULL,   OPT_RECORDS},
+        {"tiered",      required_argument,  NULL,   OPT_TIERED},
+        {"reload",      required_argument,  NULL,   OPT_RELOAD},
+        {"shared-db",   required_argument,  NULL,   OPT_SHARED_DB},
+        {"pipeline",    required_argument,  NULL,   OPT_PIPELINE},
+        {"match-sink",  required_argument,  NULL,   OPT_MATCH_SINK},
+        {"allocator",   required_argument,  NULL,   OPT_ALLOCATOR},
+        {"check-compress", no_argument,     NULL,   OPT_CHECK_COMPRESS},
+        {NULL,          0,                  NULL,   0}
+    };
+
+    while ((c = getopt_long(argc, argv, "n:m:i:hvf:o:t:e:", long_options, NULL)) != -1) {
         switch (c) {
+            case OPT_PIN:
+                env.cpu = atoi(optarg);
+                break;
+            case OPT_FIFO:
+                env.fifo_priority = atoi(optarg);
+                break;
+            case OPT_MLOCK:
+                env.mlocked = 1;
+                break;
+            case OPT_INTERLEAVE:
+                env.interleaved = 1;
+                break;
+            case OPT_PERF:
+                perf_enabled = true;
+                break;
+            case OPT_GEN:
+                generate = true;
+                if (!corpus_parse_options(optarg, &corpus_opts)) {
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case OPT_GEN_OUT:
+                corpus_out = optarg;
+                break;
+            case OPT_PCAP:
+                pcap_file = optarg;
+                break;
+#ifdef INCLUDE_PCAP
+            case OPT_PER_FLOW:
+                per_flow = true;
+                break;
+            case OPT_REASSEMBLE:
+                reassemble = true;
+                break;
+#endif
+            case OPT_HS_INFO:
+                hs_info_file = optarg;
+                break;
+            case OPT_CHECK_COMPRESS:
+                exit(compress_check() ? EXIT_SUCCESS : EXIT_FAILURE);
+            case OPT_CACHE_DIR:
+                rust_set_cache_dir(optarg);
+#ifdef INCLUDE_YARA
+                yara_set_cache_dir(optarg);
+#endif
+                break;
+            case OPT_RA_SIZE_LIMIT:
+                rust_set_size_limit(strtoull(optarg, NULL, 0));
+                break;
+            case OPT_ENCODING:
+                encodings.clear();
+                for (const auto& name : str_split(optarg, ',')) {
+                    if (name == "native") {
+                        encodings.push_back(ENC_NATIVE);
+                    } else if (name == "bytes") {
+                        encodings.push_back(ENC_BYTES);
+                    } else if (name == "utf8") {
+                        encodings.push_back(ENC_UTF8);
+                    } else {
+                        fprintf(stderr, "Unknown encoding '%s' (native, bytes, utf8)\n", name.c_str());
+                        exit(EXIT_FAILURE);
+                    }
+                }
+                break;
+            case OPT_ALLOCATOR:
+                allocators.clear();
+                for (const auto& name : str_split(optarg, ',')) {
+                    int const kind = alloc_parse(name.c_str());
+                    if (kind < 0) {
+                        fprintf(stderr, "Unknown allocator '%s' (system, arena, pool, huge)\n", name.c_str());
+                        exit(EXIT_FAILURE);
+                    }
+                    allocators.push_back(kind);
+                }
+                break;
+            case OPT_CASELESS:
+                if (strcmp(optarg, "native") == 0) {
+                    regex_caseless = CASE_NATIVE;
+                } else if (strcmp(optarg, "fold") == 0) {
+                    regex_caseless = CASE_FOLD;
+                } else {
+                    fprintf(stderr, "Unknown caseless mode '%s' (native, fold)\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case OPT_NORMALIZE:
+                normalize_enabled = true;
+                break;
+            case OPT_ATTRIBUTE:
+                attribute_file = optarg;
+                break;
+            case OPT_ATTRIBUTE_METHOD:
+                if (strcmp(optarg, "bisect") == 0) {
+                    attribute_method = ATTRIBUTE_BISECT;
+                } else if (strcmp(optarg, "loo") == 0) {
+                    attribute_method = ATTRIBUTE_LOO;
+                } else {
+                    fprintf(stderr, "Unknown attribution method '%s' (bisect, loo)\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case OPT_CAPTURES:
+                captures_enabled = true;
+                break;
+            case OPT_IS_MATCH:
+                regex_is_match = 1;
+                break;
+            case OPT_RECORDS:
+                records_enabled = true;
+                break;
+            case OPT_TIERED:
+                tiered_file = optarg;
+                break;
+            case OPT_RELOAD:
+                reload = true;
+                if (!reload_parse_options(optarg, &reload_opts)) {
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case OPT_SHARED_DB:
+                shared_db = true;
+                if (!shared_db_parse_options(optarg, &shared_db_opts)) {
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case OPT_PIPELINE:
+                pipeline = true;
+                if (!pipeline_parse_options(optarg, &pipeline_opts)) {
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case OPT_MATCH_SINK:
+                match_sink = true;
+                if (!sink_parse_options(optarg, &sink_opts)) {
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case OPT_RE2_MAX_MEM:
+#ifdef INCLUDE_RE2
+                re2_set_max_mem(strtoll(optarg, NULL, 0));
+#endif
+                break;
             case 't':
                 test_data = optarg;
                 if (test_data == NULL) {
@@ -271,11 +1583,89 @@ int main(int argc, char **argv)
                 printf("  -v\tGet the application version and build date.\n");
                 printf("  -t\tTest string, can work with -e option only. All other option will be ignored.\n");
                 printf("  -e\tPatterns, multple can be specified via coma(',').\n");
-                printf("  -h\tPrint this help message\n\n");
+                printf("  -h\tPrint this help message\n");
+                printf("  --pin <cpu>\tPin the benchmark thread to the given cpu.\n");
+                printf("  --fifo <prio>\tRun with SCHED_FIFO real-time priority (needs CAP_SYS_NICE).\n");
+                printf("  --mlock\tLock all memory to avoid page faults while measuring.\n");
+                printf("  --interleave\tRun engines round-robin per repetition instead of back-to-back.\n");
+                printf("  --perf\tCollect hardware performance counters of the scan (IPC, branch and cache misses).\n");
+                printf("  --gen <spec>\tGenerate the input instead of reading -f, e.g. size=64M,alphabet=text|binary|http,rate=<matches/KB>,seed=1.\n");
+                printf("  --gen-out <file>\tAlso write the generated input into a file.\n");
+#ifdef INCLUDE_PCAP
+                printf("  --pcap <file>\tScan the TCP/UDP payloads of a packet capture instead of -f.\n");
+                printf("  --per-flow\tScan the payloads of a flow as one block instead of packet by packet.\n");
+                printf("  --reassemble\tPut TCP segments in sequence order and drop retransmissions.\n");
+#endif
+                printf("  --encoding <list>\tPattern and input encoding: native (engine default), bytes, utf8; e.g. bytes,utf8 to compare both. Default: native\n");
+                printf("  --allocator <list>\tAllocator of the Hyperscan, PCRE2 and C++ engine memory: system, arena, pool, huge (2 MB pages); e.g. system,huge to compare both. Default: system\n");
+                printf("  --normalize\tDeduplicate and rewrite the rules before compiling them (prefixes, case classes, escapes).\n");
+                printf("  --caseless <mode>\tMatch case-insensitive: native (caseless flag of each engine) or fold (lowercased input, patterns folded to lower case).\n");
+                printf("  --is-match\tOnly find out whether an input matches, the engines stop at the first match.\n");
+                printf("  --records\tScan every line of the input file or the generated input as a separate record.\n");
+                printf("  --captures\tMeasure the engines that can extract capture groups with and without extracting the groups of every match.\n");
+                printf("  --attribute <file>\tRank the rules of the multi-pattern engines by their marginal scan cost instead of benchmarking, write all rules into a CSV file.\n");
+                printf("  --attribute-method <m>\tbisect (group bisection) or loo (leave-one-out, one recompile per rule). Default: bisect\n");
+                printf("  --tiered <file>\tScan all rules with tiered compilation instead of benchmarking: interpreter first, JIT and Hyperscan built in the background; write the final tier of every rule into a CSV file.\n");
+                printf("  --reload <options>\tUpdate rules of a partitioned Hyperscan set while scanning instead of benchmarking, e.g. threads=4,partitions=16,updates=100,interval=20 (ms). -o writes every update into a CSV file.\n");
+                printf("  --shared-db <options>\tFork scanner processes that map one Hyperscan database from a memfd or compile their own instead of benchmarking, e.g. workers=8,mode=both (shared, private, both).\n");
+                printf("  --pipeline <options>\tScan the -f file while a thread reads or decompresses it (zstd, lz4) into a ring of chunk buffers instead of benchmarking, e.g. input=uring,chunk=4M,ring=8,threads=2,overlap=16K (input: buffered, direct, uring).\n");
+                printf("  --match-sink <options>\tDeliver every Hyperscan match to a consumer thread through a ring instead of benchmarking, e.g. capacity=64K,policy=all (block, drop, spill, all).\n");
+                printf("  --check-compress\tCompress generated text with zstd and lz4, read it back through the input decompressor and compare.\n");
+                printf("  --hs-info <file>\tWrite the Hyperscan expression info and slow path reasons of every rule into a CSV file.\n");
+                printf("  --cache-dir <dir>\tDirectory of the serialized regex-automata DFAs and YARA rules. Default: /tmp\n");
+                printf("  --ra-size-limit <bytes>\tSize limit of the regex-automata DFAs and caches, 0 for none. Default: 0\n");
+#ifdef INCLUDE_RE2
+                printf("  --re2-max-mem <bytes>\tMemory budget of the RE2 engines, a DFA running out of it falls back to the NFA. Default: RE2 default (8 MB)\n");
+#endif
+                printf("\n");
                 exit(EXIT_SUCCESS);
         }
     }
 
+    if (mode == 1 && encodings.size() > 1) {
+        fprintf(stderr, "Only one encoding can be used with -m 1.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (regex_is_match && captures_enabled) {
+        fprintf(stderr, "--is-match and --captures cannot be combined.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (records_enabled && pcap_file) {
+        fprintf(stderr, "--records cannot be used with --pcap.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (mode == 1 && captures_enabled) {
+        fprintf(stderr, "--captures can only be used with -m 0.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (regex_caseless == CASE_FOLD && std::find(encodings.begin(), encodings.end(), ENC_UTF8) != encodings.end()) {
+        /* the folded patterns are byte classes */
+        fprintf(stderr, "--caseless fold cannot be used with --encoding utf8.\n");
+        exit(EXIT_FAILURE);
+    }
+    regex_encoding = encodings[0];
+    hs_use_allocator();
+
+    if (env.cpu >= 0 && env_pin_cpu(env.cpu) != 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    if (env.fifo_priority > 0 && env_set_fifo(env.fifo_priority) != 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    if (env.mlocked && env_lock_memory() != 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    env_check(&env);
+    env_print(stdout, &env, "");
+
+    if (perf_enabled && perf_open() != 0) {
+        fprintf(stderr, "Hardware performance counters not available, check /proc/sys/kernel/perf_event_paranoid.\n");
+        perf_enabled = false;
+    }
+
     if (test_regex) {
         fprintf(stdout, "Test regex: '%s'\n", test_regex);
         regexes = str_split(test_regex, ',');
@@ -287,6 +1677,21 @@ int main(int argc, char **argv)
     }
 
     if (test_data) {
+        if (normalize_enabled) {
+            normalizeRegexes(&regexes, &rule_ids);
+        }
+        if (regex_caseless != CASE_SENSITIVE) {
+            reportCaseClasses(regexes);
+        }
+        if (regex_caseless == CASE_FOLD) {
+            foldRegexes(&regexes, &rule_ids);
+            foldInput(test_data, strlen(test_data));
+        }
+
+        if (regex_encoding == ENC_UTF8 && !validUtf8(test_data, strlen(test_data))) {
+            fprintf(stderr, "The test data is not valid UTF-8, Hyperscan cannot scan it with --encoding utf8.\n");
+            exit(EXIT_FAILURE);
+        }
         fprintf(stdout, "Test data: '%s'\n", test_data);
         fprintf(stdout, "Total amount of regexes: %ld\n", regexes.size());
 
@@ -302,6 +1707,7 @@ int main(int argc, char **argv)
 
         {
             struct result results = {};
+            perf_reset();
             if (hs_multi_find_all(filtered_regex.data(), 
                                     filtered_regex.size(), 
                                     test_data, 
@@ -310,11 +1716,13 @@ int main(int argc, char **argv)
                                     &results) == -1) {
                 exit(EXIT_FAILURE);
             }
+            readPerf(strlen(test_data), repeat, &results);
             printResult("hscan-multi", results);
         }
 
         {
             struct result results = {};
+            perf_reset();
             if (hs_multi_find_all_v2(filtered_regex.data(), 
                                     filtered_regex.size(), 
                                     test_data, 
@@ -323,14 +1731,38 @@ int main(int argc, char **argv)
                                     &results) == -1) {
                 exit(EXIT_FAILURE);
             }
+            readPerf(strlen(test_data), repeat, &results);
             printResult("hscan-multi v2", results);
         }
 
+        {
+            std::vector<const char *> all_regex;
+            for (auto &regex_ : regexes) {
+                all_regex.push_back(regex_.c_str());
+            }
+
+            struct result results = {};
+            struct hybrid_stats stats;
+            perf_reset();
+            if (hybrid_multi_find_all(all_regex.data(),
+                                    all_regex.size(),
+                                    test_data,
+                                    strlen(test_data),
+                                    repeat,
+                                    &results,
+                                    &stats) == -1) {
+                exit(EXIT_FAILURE);
+            }
+            readPerf(strlen(test_data), repeat, &results);
+            printResult("hs-hybrid", results);
+            printCoverage("hs-hybrid", stats);
+        }
+
 
         exit(EXIT_SUCCESS);
     }
 
-    if (file == NULL) {
+    if (file == NULL && !generate && !pcap_file) {
         fprintf(stderr, "No input file given.\n");
         exit(EXIT_FAILURE);
     }
@@ -343,6 +1775,19 @@ int main(int argc, char **argv)
     if (input_regex) {
         regexes = loadRegex(input_regex);
     }
+    if (normalize_enabled) {
+        normalizeRegexes(&regexes, &rule_ids);
+    } else {
+        for (size_t iter = 0; iter < regexes.size(); iter++) {
+            rule_ids.push_back(std::to_string(iter + 1));
+        }
+    }
+    if (regex_caseless != CASE_SENSITIVE) {
+        reportCaseClasses(regexes);
+    }
+    if (regex_caseless == CASE_FOLD) {
+        foldRegexes(&regexes, &rule_ids);
+    }
     std::vector<const char *> regex;
     for (auto &regex_ : regexes) {
         fprintf(stdout, "Regex: %s\n", regex_.c_str());
@@ -351,80 +1796,264 @@ int main(int argc, char **argv)
 
     fprintf(stdout, "Total amount of records: %ld\n", regexes.size());
 
-    auto data = load(file);
-    if (data.empty()) {
-        exit(EXIT_FAILURE);
+    if (hs_info_file) {
+        FILE * f = fopen(hs_info_file, "w");
+        if (!f) {
+            fprintf(stderr, "Cannot open '%s'!\n", hs_info_file);
+            exit(EXIT_FAILURE);
+        }
+        hs_report_rules(regex.data(), regex.size(), f);
+        fclose(f);
     }
 
-    if (mode == 0) {
-        printf("\n[Match regex patterns one by one]\n\n");
+    /* the file is streamed, it is never loaded as a whole */
+    if (pipeline) {
+        if (!file || generate || pcap_file || records_enabled || regex_caseless == CASE_FOLD) {
+            fprintf(stderr, "--pipeline needs -f and cannot be used with --gen, --pcap, --records or --caseless fold.\n");
+            exit(EXIT_FAILURE);
+        }
+        exit(pipelineRun(regexes, file, pipeline_opts) == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
 
-        struct result results[MAX_RULES][sizeof(engines)/sizeof(engines[0])] = {0};
-        struct result engine_results[sizeof(engines)/sizeof(engines[0])] = {0};
+    std::string data;
+    if (generate) {
+        CorpusStats stats;
 
-        for (size_t  iter = 0; iter < regex.size(); iter++) {
-            find_all(regex[iter], data.c_str(), data.size(), repeat, results[iter]);
+        data = corpus_generate(corpus_opts, regexes, &stats);
+        fprintf(stdout, "Generated input: %zu bytes, seed %llu, %zu of %zu rules sampleable, %zu injected matches (%.4f per KB)\n",
+                data.size(), (unsigned long long)corpus_opts.seed, stats.sampleable_rules, regexes.size(),
+                stats.injected, stats.injected * 1024.0 / data.size());
 
-            for (size_t iiter = 0; iiter < sizeof(engines)/sizeof(engines[0]); iiter++) {
-                engine_results[iiter].pre_time += results[iter][iiter].pre_time;
-                engine_results[iiter].time += results[iter][iiter].time;
-                engine_results[iiter].matches += results[iter][iiter].matches;
-                engine_results[iiter].score += results[iter][iiter].score;
+        if (corpus_out) {
+            FILE * f = fopen(corpus_out, "wb");
+            if (!f || fwrite(data.data(), 1, data.size(), f) != data.size()) {
+                fprintf(stderr, "Cannot write '%s'!\n", corpus_out);
+                exit(EXIT_FAILURE);
             }
+            fclose(f);
         }
+    } else if (pcap_file) {
+#ifdef INCLUDE_PCAP
+        static PacketTrace trace;
 
-        fprintf(stdout, "-----------------\nTotal Results:\n");
-        for (size_t iter = 0; iter < sizeof(engines)/sizeof(engines[0]); iter++) {
-            fprintf(stdout, "[%10s] pre time: %7.4f ms | match time: %7.1f ms | matches: %8d | score: %6u points |\n", engines[iter].name, engine_results[iter].pre_time, engine_results[iter].time, engine_results[iter].matches, engine_results[iter].score);
+        if (!trace.load(pcap_file, reassemble)) {
+            exit(EXIT_FAILURE);
+        }
+
+        stream_blocks = &trace.packets();
+        input_blocks = per_flow ? &trace.flows() : &trace.packets();
+        input_packets = trace.packets().count;
+
+        fprintf(stdout, "Capture: %zu packets, %zu payloads, %zu flows, %zu payload bytes, scanned %s\n",
+                trace.captured(), input_packets, trace.flows().count, trace.payloadBytes(),
+                per_flow ? "per flow" : "per packet");
+        if (input_packets == 0) {
+            exit(EXIT_FAILURE);
+        }
+#else
+        fprintf(stderr, "Built without pcap support.\n");
+        exit(EXIT_FAILURE);
+#endif
+    } else {
+        data = load(file, records_enabled);
+    }
+    if (data.empty() && !input_blocks) {
+        exit(EXIT_FAILURE);
+    }
+
+    /* HS_FLAG_UTF8 and regress assume valid UTF-8, the result of a scan of other input is undefined */
+    if (std::find(encodings.begin(), encodings.end(), ENC_UTF8) != encodings.end()) {
+        input_valid_utf8 = input_blocks ? validUtf8(input_blocks) : validUtf8(data.data(), data.size());
+        if (!input_valid_utf8 && (mode != 0 || attribute_file || tiered_file || reload || shared_db || match_sink)) {
+            fprintf(stderr, "The input is not valid UTF-8, Hyperscan cannot scan it with --encoding utf8.\n");
+            exit(EXIT_FAILURE);
+        }
+        if (!input_valid_utf8) {
+            fprintf(stdout, "The input is not valid UTF-8, the utf8 runs of Hyperscan and regress are skipped.\n");
+        }
+    }
+
+    if (regex_caseless == CASE_FOLD) {
+        if (input_blocks) {
+            fprintf(stderr, "--caseless fold cannot be used with --pcap.\n");
+            exit(EXIT_FAILURE);
+        }
+        foldInput(&data[0], data.size());
+    }
+
+    if (attribute_file) {
+        if (input_blocks) {
+            fprintf(stderr, "--attribute cannot be used with --pcap.\n");
+            exit(EXIT_FAILURE);
+        }
+        exit(attributeCosts(regexes, rule_ids, data, repeat, attribute_method, attribute_file) == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    if (records_enabled) {
+        static Records records;
+
+        splitRecords(data, &records);
+        input_blocks = stream_blocks = &records.blocks;
+        input_packets = records.blocks.count;
+        input_unit = "records";
+
+        fprintf(stdout, "Records: %zu lines, %zu bytes\n", records.blocks.count, records.blocks.bytes);
+        if (records.blocks.count == 0) {
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (tiered_file) {
+        static Records chunks;
+
+        if (!input_blocks) {
+            splitChunks(data, 1024 * 1024, &chunks);
+            input_blocks = &chunks.blocks;
+            input_unit = "chunks";
+        }
+        exit(tieredRun(regexes, rule_ids, input_blocks, repeat, tiered_file) == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    if (reload) {
+        if (input_blocks) {
+            fprintf(stderr, "--reload cannot be used with --pcap or --records.\n");
+            exit(EXIT_FAILURE);
+        }
+        exit(reloadRun(regexes, rule_ids, data, reload_opts, out_file) == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    if (shared_db) {
+        if (input_blocks) {
+            fprintf(stderr, "--shared-db cannot be used with --pcap or --records.\n");
+            exit(EXIT_FAILURE);
+        }
+        exit(sharedDbRun(regexes, data, repeat, shared_db_opts) == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    if (match_sink) {
+        if (input_blocks) {
+            fprintf(stderr, "--match-sink cannot be used with --pcap or --records.\n");
+            exit(EXIT_FAILURE);
         }
+        exit(sinkRun(regexes, data, repeat, sink_opts) == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    /* the engines depend on the input: flat, or blocks of packets, flows or records */
+    setupRuns();
+
+    if (mode == 0) {
+        printf("\n[Match regex patterns one by one]\n\n");
 
+        size_t const engines_len = runs.size();
+        std::vector<struct result> engine_results(engines_len);
+        /* only over the rules an engine completed, so failed rules do not inflate its throughput */
+        std::vector<double> scanned(engines_len, 0);
+        std::vector<double> ceilings(engines_len, 0);
+        FILE * f = NULL;
+
+        /* rows are written as soon as a rule is measured, nothing is kept per rule */
         if (out_file != NULL) {
-            FILE * f = fopen(out_file, "w");
+            f = fopen(out_file, "w");
             if (!f) {
                 fprintf(stderr, "Cannot open '%s'!\n", out_file);
                 exit(EXIT_FAILURE);
             }
 
+            writeMeta(f);
+
             /* write table header*/
             fprintf(f, "id;");
             fprintf(f, "regex;");
-            for (size_t iter = 0; iter < sizeof(engines)/sizeof(engines[0]); iter++) {
-                fprintf(f, "%s (pre) [ms];", engines[iter].name);
+            for (size_t iter = 0; iter < engines_len; iter++) {
+                fprintf(f, "%s (pre) [ms];", runs[iter].name);
+            }
+            for (size_t iter = 0; iter < engines_len; iter++) {
+                fprintf(f, "%s (match) [ms];", runs[iter].name);
             }
-            for (size_t iter = 0; iter < sizeof(engines)/sizeof(engines[0]); iter++) {
-                fprintf(f, "%s (match) [ms];", engines[iter].name);
+            for (size_t iter = 0; iter < engines_len; iter++) {
+                fprintf(f, "%s [matches];", runs[iter].name);
             }
-            for (size_t iter = 0; iter < sizeof(engines)/sizeof(engines[0]); iter++) {
-                fprintf(f, "%s [matches];", engines[iter].name);
+            for (size_t iter = 0; iter < engines_len; iter++) {
+                fprintf(f, "%s [sp];", runs[iter].name);
+            }
+            for (size_t iter = 0; iter < engines_len && captures_enabled; iter++) {
+                if (runs[iter].extract) {
+                    fprintf(f, "%s [captures];", runs[iter].name);
+                }
             }
-            for (size_t iter = 0; iter < sizeof(engines)/sizeof(engines[0]); iter++) {
-                fprintf(f, "%s [sp];", engines[iter].name);
+            for (size_t iter = 0; iter < engines_len; iter++) {
+                writePerfHeader(f, runs[iter].name);
             }
             fprintf(f, "\n");
+        }
 
-            /* write data */
-            for (size_t iter = 0; iter < regex.size(); iter++) {
-                fprintf(f, "%lu;", iter + 1);
+        for (size_t  iter = 0; iter < regex.size(); iter++) {
+            std::vector<struct result> results(engines_len);
+
+            find_all(regex[iter], data.c_str(), data.size(), repeat, results.data());
+
+            double const ceiling = ceilingTime(results.data());
+            for (size_t iiter = 0; iiter < engines_len; iiter++) {
+                if (results[iiter].time > 0) {
+                    scanned[iiter] += input_blocks ? input_blocks->bytes : data.size();
+                    ceilings[iiter] += ceiling;
+                }
+                engine_results[iiter].pre_time += results[iiter].pre_time;
+                engine_results[iiter].time += results[iiter].time;
+                engine_results[iiter].matches += results[iiter].matches;
+                engine_results[iiter].captures += results[iiter].captures;
+                engine_results[iiter].score += results[iiter].score;
+                perf_add(&engine_results[iiter].perf, &results[iiter].perf);
+            }
+
+            if (f) {
+                fprintf(f, "%s;", rule_ids[iter].c_str());
                 fprintf(f, "%s;", regex[iter]);
 
-                for (size_t iiter = 0; iiter < sizeof(engines)/sizeof(engines[0]); iiter++) {
-                    fprintf(f, "%7.4f;", results[iter][iiter].pre_time);
+                for (size_t iiter = 0; iiter < engines_len; iiter++) {
+                    fprintf(f, "%7.4f;", results[iiter].pre_time);
                 }
-                for (size_t iiter = 0; iiter < sizeof(engines)/sizeof(engines[0]); iiter++) {
-                    fprintf(f, "%7.1f;", results[iter][iiter].time);
+                for (size_t iiter = 0; iiter < engines_len; iiter++) {
+                    fprintf(f, "%7.1f;", results[iiter].time);
                 }
-                for (size_t iiter = 0; iiter < sizeof(engines)/sizeof(engines[0]); iiter++) {
-                    fprintf(f, "%d;", results[iter][iiter].matches);
+                for (size_t iiter = 0; iiter < engines_len; iiter++) {
+                    fprintf(f, "%" PRIu64 ";", results[iiter].matches);
                 }
-                for (size_t iiter = 0; iiter < sizeof(engines)/sizeof(engines[0]); iiter++) {
-                    fprintf(f, "%d;", results[iter][iiter].score);
+                for (size_t iiter = 0; iiter < engines_len; iiter++) {
+                    fprintf(f, "%d;", results[iiter].score);
+                }
+                for (size_t iiter = 0; iiter < engines_len && captures_enabled; iiter++) {
+                    if (runs[iiter].extract) {
+                        fprintf(f, "%" PRIu64 ";", results[iiter].captures);
+                    }
+                }
+                for (size_t iiter = 0; iiter < engines_len; iiter++) {
+                    writePerf(f, results[iiter].perf);
                 }
                 fprintf(f, "\n");
+                fflush(f);
             }
+        }
 
+        if (f) {
             fclose(f);
         }
 
+        fprintf(stdout, "-----------------\nTotal Results:\n");
+        for (size_t iter = 0; iter < engines_len; iter++) {
+            fprintf(stdout, "[%10s] pre time: %7.4f ms | match time: %7.1f ms | matches: %8" PRIu64 " | score: %6u points |\n", runs[iter].name, engine_results[iter].pre_time, engine_results[iter].time, engine_results[iter].matches, engine_results[iter].score);
+        }
+        for (size_t iter = 0; iter < engines_len; iter++) {
+            printThroughput(runs[iter].name, scanned[iter], engine_results[iter].time, ceilings[iter]);
+        }
+        for (size_t iter = 0; iter < engines_len; iter++) {
+            printPerf(runs[iter].name, engine_results[iter].perf);
+        }
+        if (captures_enabled) {
+            printCapturePenalty(engine_results);
+        }
+        printAllocStats();
+
     } else {
         printf("\n[Match regex patterns all together]\n\n");
 
@@ -439,16 +2068,193 @@ int main(int argc, char **argv)
 
         fprintf(stdout, "Total amount of valid for hs_multi regexes: %ld\n", filtered_regex.size());
 
-        struct result results = {};
-        if (hs_multi_find_all(filtered_regex.data(), 
-                                filtered_regex.size(), 
-                                data.c_str(), 
-                                data.size(), 
-                                repeat, 
-                                &results) == -1) {
-            exit(EXIT_FAILURE);
+        /* one read sweep of the input, the ceiling of every multi-pattern engine */
+        struct result sweep = {};
+        double const bytes = input_blocks ? input_blocks->bytes : data.size();
+        perf_reset();
+        if (input_blocks) {
+            memread_find_all_blocks("", input_blocks, repeat, &sweep);
+        } else {
+            memread_find_all("", data.c_str(), data.size(), repeat, &sweep);
+        }
+        printResult("memread", sweep);
+        printThroughput("memread", bytes, sweep.time, sweep.time);
+
+        /* every flag variant of the multi-pattern database, the stream variant only for packet input */
+        struct {
+            const char * name;
+            const char * column;
+            int variant;
+            bool stream;
+            bool run;
+            struct result results;
+        } variants[] = {
+            {"hscan-multi", "hs-multi",         HS_VARIANT_SOM,     false, true,  {}},
+            {"hs-mul-nsom", "hs-multi-nosom",   HS_VARIANT_NOSOM,   false, true,  {}},
+            {"hs-mul-1st",  "hs-multi-single",  HS_VARIANT_SINGLE,  false, true,  {}},
+            {"hs-mul-lit",  "hs-multi-literal", HS_VARIANT_LITERAL, false, true,  {}},
+            {"hs-mul-strm", "hs-multi-stream",  HS_VARIANT_SOM,     true,  input_blocks != NULL, {}},
+        };
+
+        size_t literals = 0;
+        for (auto pattern : filtered_regex) {
+            literals += hs_is_literal(pattern);
+        }
+        if (filtered_regex.empty() || literals != filtered_regex.size()) {
+            fprintf(stdout, "%zu of %zu regexes are literals, skipping the literal variant\n", literals, filtered_regex.size());
+            variants[3].run = false;
+        }
+
+        /* the first allocator goes into the CSV file, the others are only printed */
+        for (auto& variant : variants) {
+            if (!variant.run) {
+                continue;
+            }
+
+            for (size_t alloc = 0; alloc < allocators.size(); alloc++) {
+                struct result results = {};
+                std::string name = variant.name;
+                int ret;
+
+                if (allocators.size() > 1) {
+                    name += "/";
+                    name += alloc_name(allocators[alloc]);
+                }
+
+                perf_reset();
+                alloc_select(allocators[alloc]);
+                if (input_blocks) {
+                    const struct blocks * blocks = variant.stream ? stream_blocks : input_blocks;
+                    ret = hs_multi_find_all_blocks(filtered_regex.data(),
+                                            filtered_regex.size(),
+                                            blocks,
+                                            variant.stream,
+                                            variant.variant,
+                                            repeat,
+                                            &results);
+                    readPerf(blocks->bytes, repeat, &results);
+                } else {
+                    ret = hs_multi_variant_find_all(filtered_regex.data(),
+                                            filtered_regex.size(),
+                                            data.c_str(),
+                                            data.size(),
+                                            variant.variant,
+                                            repeat,
+                                            &results);
+                    readPerf(data.size(), repeat, &results);
+                }
+                alloc_select(ALLOC_SYSTEM);
+                if (ret == -1) {
+                    exit(EXIT_FAILURE);
+                }
+                printResult(name.c_str(), results);
+                printThroughput(name.c_str(), bytes, results.time, sweep.time);
+                if (alloc == 0) {
+                    variant.results = results;
+                }
+            }
+        }
+        printAllocStats();
+
+        /* the complete rule set, including the rules dropped by hs_verify_regex() */
+        struct result hybrid_results = {};
+        struct hybrid_stats hybrid = {};
+        perf_reset();
+        if (input_blocks) {
+            if (hybrid_multi_find_all_blocks(regex.data(), regex.size(), input_blocks, repeat, &hybrid_results, &hybrid) == -1) {
+                exit(EXIT_FAILURE);
+            }
+            readPerf(input_blocks->bytes, repeat, &hybrid_results);
+        } else {
+            if (hybrid_multi_find_all(regex.data(), regex.size(), data.c_str(), data.size(), repeat, &hybrid_results, &hybrid) == -1) {
+                exit(EXIT_FAILURE);
+            }
+            readPerf(data.size(), repeat, &hybrid_results);
+        }
+        printResult("hs-hybrid", hybrid_results);
+        printThroughput("hs-hybrid", bytes, hybrid_results.time, sweep.time);
+        printCoverage("hs-hybrid", hybrid);
+
+        /* regex-automata builds one automaton over all rules, its own syntax decides which rules are usable */
+        std::vector<const char *> ra_regex;
+        for (auto pattern : regex) {
+            if (rust_ra_verify(pattern)) {
+                ra_regex.push_back(pattern);
+            }
+        }
+
+        fprintf(stdout, "Total amount of valid for regex-automata regexes: %zu\n", ra_regex.size());
+
+        struct {
+            const char * name;
+            const char * column;
+            int kind;
+            bool ok;
+            struct result results;
+            struct build_stats stats;
+        } ra_variants[] = {
+            {"ra-dense",    "ra-multi-dense",       RA_DENSE,       false, {}, {}},
+            {"ra-sparse",   "ra-multi-sparse",      RA_SPARSE,      false, {}, {}},
+            {"ra-meta",     "ra-multi-meta",        RA_META,        false, {}, {}},
+            {"ra-dense-mm", "ra-multi-dense-mmap",  RA_DENSE_MMAP,  false, {}, {}},
+            {"ra-sprs-mm",  "ra-multi-sparse-mmap", RA_SPARSE_MMAP, false, {}, {}},
+        };
+
+        for (auto& variant : ra_variants) {
+            if (ra_regex.empty()) {
+                break;
+            }
+
+            /* a DFA over a large rule set may exceed the size limit, the other engines still run */
+            perf_reset();
+            if (input_blocks) {
+                variant.ok = rust_ra_multi_find_all_blocks(ra_regex.data(), ra_regex.size(), input_blocks,
+                                                           variant.kind, repeat, &variant.results, &variant.stats) == 0;
+                readPerf(input_blocks->bytes, repeat, &variant.results);
+            } else {
+                variant.ok = rust_ra_multi_find_all(ra_regex.data(), ra_regex.size(), data.c_str(), data.size(),
+                                                    variant.kind, repeat, &variant.results, &variant.stats) == 0;
+                readPerf(data.size(), repeat, &variant.results);
+            }
+            if (variant.ok) {
+                printResult(variant.name, variant.results);
+                printThroughput(variant.name, bytes, variant.results.time, sweep.time);
+                printBuild(variant.name, variant.stats);
+            }
+        }
+
+#ifdef INCLUDE_YARA
+        /* one combined ruleset, a single rule YARA rejects would fail the whole compilation */
+        std::vector<const char *> yara_regex;
+        for (auto pattern : regex) {
+            if (yara_verify_regex(pattern)) {
+                yara_regex.push_back(pattern);
+            }
+        }
+
+        fprintf(stdout, "Total amount of valid for yara regexes: %zu\n", yara_regex.size());
+
+        struct result yara_results = {};
+        struct build_stats yara_stats = {};
+        bool yara_ok = false;
+        if (!yara_regex.empty()) {
+            perf_reset();
+            if (input_blocks) {
+                yara_ok = yara_multi_find_all_blocks(yara_regex.data(), yara_regex.size(), input_blocks, repeat,
+                                                     &yara_results, &yara_stats) == 0;
+                readPerf(input_blocks->bytes, repeat, &yara_results);
+            } else {
+                yara_ok = yara_multi_find_all(yara_regex.data(), yara_regex.size(), data.c_str(), data.size(), repeat,
+                                              &yara_results, &yara_stats) == 0;
+                readPerf(data.size(), repeat, &yara_results);
+            }
+            if (yara_ok) {
+                printResult("yara-multi", yara_results);
+                printThroughput("yara-multi", bytes, yara_results.time, sweep.time);
+                printBuild("yara-multi", yara_stats);
+            }
         }
-        printResult("hscan-multi", results);
+#endif
 
         if (out_file != NULL) {
 
@@ -458,19 +2264,95 @@ int main(int argc, char **argv)
                 exit(EXIT_FAILURE);
             }
 
+            writeMeta(f);
+
             /* write table header*/
             fprintf(f, "id;");
             fprintf(f, "regex;");
-            fprintf(f, "hs-multi (pre) [ms];");
-            fprintf(f, "hs-multi (match) [ms];");
-            fprintf(f, "hs-multi [matches];");
+            for (const auto& variant : variants) {
+                if (!variant.run) {
+                    continue;
+                }
+                fprintf(f, "%s (pre) [ms];", variant.column);
+                fprintf(f, "%s (match) [ms];", variant.column);
+                fprintf(f, "%s [matches];", variant.column);
+                writePerfHeader(f, variant.column);
+            }
+            fprintf(f, "hs-hybrid (pre) [ms];");
+            fprintf(f, "hs-hybrid (match) [ms];");
+            fprintf(f, "hs-hybrid [matches];");
+            writePerfHeader(f, "hs-hybrid");
+            fprintf(f, "hs-hybrid native [rules];");
+            fprintf(f, "hs-hybrid prefiltered [rules];");
+            fprintf(f, "hs-hybrid fallback [rules];");
+            fprintf(f, "hs-hybrid unsupported [rules];");
+            fprintf(f, "hs-hybrid prefilter hits;");
+            fprintf(f, "hs-hybrid confirmed [matches];");
+            for (const auto& variant : ra_variants) {
+                if (!variant.ok) {
+                    continue;
+                }
+                fprintf(f, "%s (pre) [ms];", variant.column);
+                fprintf(f, "%s (match) [ms];", variant.column);
+                fprintf(f, "%s [matches];", variant.column);
+                writePerfHeader(f, variant.column);
+                fprintf(f, "%s (build) [ms];", variant.column);
+                fprintf(f, "%s (load) [ms];", variant.column);
+                fprintf(f, "%s [bytes];", variant.column);
+            }
+#ifdef INCLUDE_YARA
+            if (yara_ok) {
+                fprintf(f, "yara-multi (pre) [ms];");
+                fprintf(f, "yara-multi (match) [ms];");
+                fprintf(f, "yara-multi [matches];");
+                writePerfHeader(f, "yara-multi");
+                fprintf(f, "yara-multi (build) [ms];");
+                fprintf(f, "yara-multi (load) [ms];");
+                fprintf(f, "yara-multi [bytes];");
+            }
+#endif
             fprintf(f, "\n");
 
             /* write data */
             fprintf(f, "%lu;", regex.size());
-            fprintf(f, "%7.4f;", results.pre_time);
-            fprintf(f, "%7.1f;", results.time);
-            fprintf(f, "%d;", results.matches);
+            for (const auto& variant : variants) {
+                if (!variant.run) {
+                    continue;
+                }
+                fprintf(f, "%7.4f;", variant.results.pre_time);
+                fprintf(f, "%7.1f;", variant.results.time);
+                fprintf(f, "%" PRIu64 ";", variant.results.matches);
+                writePerf(f, variant.results.perf);
+            }
+            fprintf(f, "%7.4f;", hybrid_results.pre_time);
+            fprintf(f, "%7.1f;", hybrid_results.time);
+            fprintf(f, "%" PRIu64 ";", hybrid_results.matches);
+            writePerf(f, hybrid_results.perf);
+            fprintf(f, "%d;%d;%d;%d;", hybrid.native, hybrid.prefiltered, hybrid.fallback, hybrid.unsupported);
+            fprintf(f, "%llu;%llu;", hybrid.prefilter_hits, hybrid.confirmed_matches);
+            for (const auto& variant : ra_variants) {
+                if (!variant.ok) {
+                    continue;
+                }
+                fprintf(f, "%7.4f;", variant.results.pre_time);
+                fprintf(f, "%7.1f;", variant.results.time);
+                fprintf(f, "%" PRIu64 ";", variant.results.matches);
+                writePerf(f, variant.results.perf);
+                fprintf(f, "%7.4f;", variant.stats.build_time);
+                fprintf(f, "%7.4f;", variant.stats.load_time);
+                fprintf(f, "%" PRIu64 ";", variant.stats.size);
+            }
+#ifdef INCLUDE_YARA
+            if (yara_ok) {
+                fprintf(f, "%7.4f;", yara_results.pre_time);
+                fprintf(f, "%7.1f;", yara_results.time);
+                fprintf(f, "%" PRIu64 ";", yara_results.matches);
+                writePerf(f, yara_results.perf);
+                fprintf(f, "%7.4f;", yara_stats.build_time);
+                fprintf(f, "%7.4f;", yara_stats.load_time);
+                fprintf(f, "%" PRIu64 ";", yara_stats.size);
+            }
+#endif
             fprintf(f, "\n");
 
             fclose(f);
@@ -1,65 +1,291 @@
+#ifndef MAIN_H
+#define MAIN_H
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#include <stdio.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <time.h>
 #include <math.h>
+#include <stdbool.h>
 
 #define TIME_TYPE                   clock_t
 #define GET_TIME(res)               { res = clock(); }
 #define TIME_DIFF_IN_MS(begin, end) (((double) (end - begin)) * 1000 / CLOCKS_PER_SEC)
+/* wrap the timed scan region, hardware counters (if opened) only count in between */
+#define START_SCAN_TIME(res)        { perf_enable(); GET_TIME(res); }
+#define STOP_SCAN_TIME(res)         { GET_TIME(res); perf_disable(); }
 #define UNUSED __attribute__((unused))
-#define MAX_RULES 1000
 #define MAX_REGEX_LEN 1000
 
+struct perf_counters {
+    uint64_t cycles;
+    uint64_t instructions;
+    uint64_t branches;
+    uint64_t branch_misses;
+    uint64_t l1d_misses;
+    uint64_t llc_misses;
+    uint64_t dtlb_misses;
+    double scanned_kb;      /* amount of data scanned while counting */
+};
+
+struct perf_metrics {
+    double ipc;
+    double branch_miss_rate; /* in percent of all branches */
+    double l1d_per_kb;
+    double llc_per_kb;
+    double dtlb_per_kb;
+};
+
 struct result {
     int score;
     double pre_time;
     double time;
     double time_sd;
-    int matches;
+    uint64_t matches;
+    uint64_t captures;      /* capture groups set in the matches, only counted with --captures */
+    struct perf_counters perf;
+};
+
+/* a list of separate inputs (packets, flows, records), scanned one after another with one compiled pattern */
+struct blocks {
+    const char * const * data;
+    const size_t * len;
+    const unsigned int * flow;  /* stream id of each block, used by stream mode engines */
+    size_t count;
+    unsigned int flows;
+    size_t bytes;
+};
+
+/* rule coverage of the hybrid Hyperscan + PCRE2 engine, counts of the last repetition */
+struct hybrid_stats {
+    int native;                 /* matched by Hyperscan */
+    int prefiltered;            /* HS_FLAG_PREFILTER, hits confirmed by PCRE2-JIT */
+    int capped;                 /* prefiltered, wider than the confirmation window */
+    int fallback;               /* scanned by PCRE2-JIT only */
+    int unsupported;            /* rejected by both engines */
+    unsigned long long prefilter_hits;
+    unsigned long long confirms;
+    unsigned long long confirmed_matches;
+    unsigned long long fallback_matches;
+};
+
+/* pattern and input encoding of the engines, see --encoding */
+#define ENC_NATIVE  0   /* the default of each engine */
+#define ENC_BYTES   1   /* bytes / Latin-1, ASCII character classes */
+#define ENC_UTF8    2   /* UTF-8 with Unicode properties for \w, \s, \d and \b */
+
+/* encoding of the engine run in progress */
+extern int regex_encoding;
+
+/* case sensitivity of the patterns, see --caseless */
+#define CASE_SENSITIVE  0   /* as written in the rules */
+#define CASE_NATIVE     1   /* compiled with the caseless flag of each engine */
+#define CASE_FOLD       2   /* lowercased input, patterns folded to lower case */
+
+extern int regex_caseless;
+
+/* extract the spans of all capture groups of every match instead of the match bounds only, see --captures */
+extern int regex_captures;
+
+/*
+ * Only find out whether an input matches, see --is-match. The engines stop at
+ * the first match, matches is the number of inputs (blocks) with a match.
+ */
+extern int regex_is_match;
+
+/*
+ * Allocator of the engine compile and scratch memory, see --allocator and
+ * alloc.cpp. Hyperscan, PCRE2 and C++ operator new allocate through it.
+ */
+#define ALLOC_SYSTEM    0   /* malloc */
+#define ALLOC_ARENA     1   /* bump arena, rewound when all its blocks are freed */
+#define ALLOC_POOL      2   /* power-of-two size classes with free lists */
+#define ALLOC_HUGE      3   /* bump arena on 2 MB pages, MAP_HUGETLB or transparent huge pages */
+
+struct alloc_stats {
+    size_t chunks;          /* mapped chunks of all allocators */
+    size_t mapped;          /* bytes */
+    size_t hugetlb;         /* bytes mapped with MAP_HUGETLB */
+    size_t thp;             /* bytes advised as transparent huge pages */
+};
+
+/* lowercases A-Z in place, other bytes are left as they are */
+void fold_lower(char * data, size_t len);
+
+/* engines that can load a precompiled database from the cache directory */
+struct build_stats {
+    double build_time;      /* ms, 0 if the database was loaded from the cache */
+    double load_time;       /* ms, 0 if the database is used as built */
+    uint64_t size;          /* serialized size, heap size of databases that are not serialized */
+};
+
+struct env_info {
+    int cpu;                /* pinned cpu, -1 if not pinned */
+    int fifo_priority;      /* SCHED_FIFO priority, 0 if not used */
+    int mlocked;
+    int interleaved;        /* engines interleaved per repetition */
+    char governor[32];
+    int turbo;              /* 1: enabled, 0: disabled, -1: unknown */
+    int smt_siblings;
+    double sibling_load;    /* highest busy fraction of a SMT sibling */
+    int trusted;
 };
 
 void get_mean_and_derivation(double pre_times, const double * times, uint32_t times_len, struct result * res);
 
+int env_pin_cpu(int cpu);
+int env_set_fifo(int priority);
+int env_lock_memory(void);
+void env_check(struct env_info * env);
+void env_print(FILE * f, const struct env_info * env, const char * prefix);
+
+int perf_open(void);
+void perf_close(void);
+void perf_reset(void);
+void perf_enable(void);
+void perf_disable(void);
+void perf_read(struct perf_counters * counters);
+void perf_add(struct perf_counters * sum, const struct perf_counters * counters);
+void perf_get_metrics(const struct perf_counters * counters, struct perf_metrics * metrics);
+
+int alloc_parse(const char * name);
+const char * alloc_name(int kind);
+void alloc_select(int kind);
+void * alloc_malloc(size_t size);
+void alloc_free(void * ptr);
+void alloc_get_stats(struct alloc_stats * stats);
+/* signatures of pcre2_general_context_create() */
+void * alloc_pcre2_malloc(size_t size, void * data);
+void alloc_pcre2_free(void * ptr, void * data);
+
 #ifdef INCLUDE_CTRE
-int ctre_find_all(const char* pattern, const char* subject, int subject_len, int repeat, struct result * res);
+int ctre_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res);
 #endif
 #ifdef INCLUDE_BOOST
-int boost_find_all(const char* pattern, const char* subject, int subject_len, int repeat, struct result * res);
+int boost_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res);
 #endif
 #ifdef INCLUDE_CPPSTD
-int cppstd_find_all(const char* pattern, const char* subject, int subject_len, int repeat, struct result * res);
+int cppstd_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res);
 #endif
 #ifdef INCLUDE_PCRE2
-int pcre2_std_find_all(const char* pattern, const char* subject, int subject_len, int repeat, struct result * res);
-int pcre2_dfa_find_all(const char* pattern, const char* subject, int subject_len, int repeat, struct result * res);
-int pcre2_jit_find_all(const char* pattern, const char* subject, int subject_len, int repeat, struct result * res);
+int pcre2_std_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res);
+int pcre2_dfa_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res);
+int pcre2_jit_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res);
+int pcre2_std_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res);
+int pcre2_dfa_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res);
+int pcre2_jit_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res);
 #endif
 #ifdef INCLUDE_RE2
-int re2_find_all(const char* pattern, const char* subject, int subject_len, int repeat, struct result * res);
+int re2_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res);
+int re2_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res);
+int re2_match_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res);
+int re2_match_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res);
+int re2_longest_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res);
+int re2_longest_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res);
+void re2_set_max_mem(int64_t max_mem);
 #endif
 #ifdef INCLUDE_TRE
-int tre_find_all(const char* pattern, const char* subject, int subject_len, int repeat, struct result * res);
+int tre_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res);
 #endif
 #ifdef INCLUDE_ONIGURUMA
-int onig_find_all(const char* pattern, const char* subject, int subject_len, int repeat, struct result * res);
+int onig_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res);
 #endif
 #ifdef INCLUDE_HYPERSCAN
-#include <stdbool.h>
+/* compile flag variants of the Hyperscan engines */
+#define HS_VARIANT_SOM      0   /* DOTALL | MULTILINE | SOM_LEFTMOST */
+#define HS_VARIANT_NOSOM    1   /* DOTALL | MULTILINE, only end offsets */
+#define HS_VARIANT_SINGLE   2   /* DOTALL | MULTILINE | SINGLEMATCH, one match per rule */
+#define HS_VARIANT_LITERAL  3   /* hs_compile_lit_multi(), all rules must be literals */
+/* hs_expression_info() and database sizes of a rule */
+struct hs_rule_info {
+    unsigned min_width;
+    unsigned max_width;     /* UINT_MAX if unbounded */
+    int unordered;
+    int at_eod;
+    size_t db_som;
+    size_t db_nosom;
+    size_t stream_som;      /* stream state, 0 if the rule has no stream mode database */
+    size_t stream_nosom;
+    bool literal;
+    char slow[48];          /* slow path reasons, e.g. "som unbounded " */
+};
+
+void hs_use_allocator(void);
 bool hs_verify_regex(const char* pattern);
-int hs_find_all(const char* pattern, const char* subject, int subject_len, int repeat, struct result * res);
-int hs_multi_find_all(const char ** pattern, int pattern_num, const char * subject, int subject_len, int repeat, struct result * res);
-int hs_multi_find_all_v2(const char ** pattern, int pattern_num, const char * subject, int subject_len, int repeat, struct result * res);
+bool hs_rule_info(const char * pattern, struct hs_rule_info * info, char * error, size_t error_len);
+bool hs_is_literal(const char* pattern);
+int hs_report_rules(const char ** pattern, int pattern_num, FILE * f);
+int hs_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res);
+int hs_nosom_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res);
+int hs_single_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res);
+int hs_multi_find_all(const char ** pattern, int pattern_num, const char * subject, size_t subject_len, int repeat, struct result * res);
+int hs_multi_variant_find_all(const char ** pattern, int pattern_num, const char * subject, size_t subject_len, int variant, int repeat, struct result * res);
+double hs_multi_scan_time(const char ** pattern, int pattern_num, const char * subject, size_t subject_len, int variant, int repeat, uint64_t * matches);
+int hs_multi_find_all_v2(const char ** pattern, int pattern_num, const char * subject, size_t subject_len, int repeat, struct result * res);
+int hs_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res);
+int hs_nosom_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res);
+int hs_single_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res);
+int hs_stream_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res);
+int hs_multi_find_all_blocks(const char ** pattern, int pattern_num, const struct blocks * blocks, int stream, int variant, int repeat, struct result * res);
+int hybrid_multi_find_all(const char ** pattern, int pattern_num, const char * subject, size_t subject_len, int repeat, struct result * res, struct hybrid_stats * stats);
+int hybrid_multi_find_all_blocks(const char ** pattern, int pattern_num, const struct blocks * blocks, int repeat, struct result * res, struct hybrid_stats * stats);
 #endif
 #ifdef INCLUDE_YARA
-int yara_find_all(char * pattern, char * subject, int subject_len, int repeat, struct result * res);
+void yara_set_cache_dir(const char * dir);
+bool yara_verify_regex(const char * pattern);
+int yara_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res);
+int yara_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res);
+int yara_multi_find_all(const char ** pattern, int pattern_num, const char * subject, size_t subject_len, int repeat, struct result * res, struct build_stats * stats);
+int yara_multi_find_all_blocks(const char ** pattern, int pattern_num, const struct blocks * blocks, int repeat, struct result * res, struct build_stats * stats);
 #endif
-int rust_find_all(const char* pattern, const char* subject, int subject_len, int repeat, struct result * res);
-int regress_find_all(const char* pattern, const char* subject, int subject_len, int repeat, struct result * res);
+/* regex-automata engines of the Rust library, byte oriented (no Unicode classes) */
+#define RA_DENSE        0   /* fully compiled dense DFA */
+#define RA_SPARSE       1   /* sparse DFA, smaller but slower transitions */
+#define RA_META         2   /* meta regex, picks lazy DFA, one-pass or NFA engines */
+#define RA_DENSE_MMAP   3   /* dense DFA deserialized from an mmap'd cache file */
+#define RA_SPARSE_MMAP  4   /* sparse DFA deserialized from an mmap'd cache file */
+
+void rust_set_cache_dir(const char * dir);
+void rust_set_size_limit(uint64_t limit);
+bool rust_ra_verify(const char * pattern);
+int rust_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res);
+int rust_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res);
+int regress_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res);
+int ra_dense_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res);
+int ra_sparse_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res);
+int ra_meta_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res);
+int ra_dense_mm_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res);
+int ra_sparse_mm_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res);
+int ra_dense_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res);
+int ra_sparse_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res);
+int ra_meta_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res);
+int ra_dense_mm_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res);
+int ra_sparse_mm_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res);
+double rust_ra_multi_scan_time(const char ** pattern, int pattern_num, const char * subject, size_t subject_len, int kind, int repeat);
+int rust_ra_multi_find_all(const char ** pattern, int pattern_num, const char * subject, size_t subject_len, int kind, int repeat, struct result * res, struct build_stats * stats);
+int rust_ra_multi_find_all_blocks(const char ** pattern, int pattern_num, const struct blocks * blocks, int kind, int repeat, struct result * res, struct build_stats * stats);
+
+/* bit-parallel Glushkov automaton of shiftand.cpp, patterns of up to 512 classes without anchors */
+int shiftand_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res);
+int shiftand_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res);
+
+/* baselines of baseline.cpp, a read sweep of the input and the simplest searches a pattern reduces to */
+int memread_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res);
+int memread_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res);
+int memchr_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res);
+int memchr_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res);
+int memmem_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res);
+int memmem_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res);
+int classscan_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res);
+int classscan_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res);
 
 #ifdef __cplusplus
 }
 #endif
+
+#endif // MAIN_H
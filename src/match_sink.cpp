@@ -0,0 +1,340 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+
+#include "main.h"
+#include "corpus.hpp"
+#include "match_sink.hpp"
+#include "util.hpp"
+
+#ifdef INCLUDE_HYPERSCAN
+#include "hyperscan.hpp"
+#endif
+
+/* every n-th delivered record is timed */
+#define SINK_LATENCY_SAMPLE 16
+#define SINK_OUTPUT_SIZE    (64 << 10)
+
+namespace {
+
+static uint64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+static double percentile(const std::vector<uint64_t>& sorted, double p)
+{
+    if (sorted.empty()) {
+        return 0;
+    }
+    return sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))] / 1000.0;
+}
+
+}  // namespace
+
+MatchSink::MatchSink(SinkPolicy policy, size_t capacity, size_t rules)
+    : policy(policy), head(0), tail(0), closed(false), per_rule(rules, 0)
+{
+    size_t size = 2;
+
+    while (size < capacity) {
+        size <<= 1;
+    }
+    records.resize(size);
+    mask = size - 1;
+    consumer = std::thread(&MatchSink::consume, this);
+}
+
+MatchSink::~MatchSink()
+{
+    if (consumer.joinable()) {
+        close();
+    }
+}
+
+bool MatchSink::tryPush(const MatchRecord& record)
+{
+    uint64_t const pos = tail.load(std::memory_order_relaxed);
+
+    if (pos - head_cache > mask) {
+        head_cache = head.load(std::memory_order_acquire);
+        if (pos - head_cache > mask) {
+            return false;
+        }
+    }
+    records[pos & mask] = record;
+    tail.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+/* true once the spilled records are all in the ring */
+bool MatchSink::flushSpill()
+{
+    while (spill_pos < spill.size() && tryPush(spill[spill_pos])) {
+        spill_pos++;
+    }
+    if (spill_pos < spill.size()) {
+        return false;
+    }
+    spill.clear();
+    spill_pos = 0;
+    return true;
+}
+
+void MatchSink::push(uint32_t rule, uint64_t start, uint64_t end)
+{
+    MatchRecord const record = {rule, 0, start, end, nowNs()};
+
+    sink_stats.pushed++;
+    switch (policy) {
+        case SINK_BLOCK:
+            if (!tryPush(record)) {
+                Clock::time_point const blocked = Clock::now();
+                sink_stats.stalls++;
+                while (!tryPush(record)) {
+                    std::this_thread::yield();
+                }
+                sink_stats.stall += since(blocked);
+            }
+            break;
+        case SINK_DROP:
+            if (!tryPush(record)) {
+                sink_stats.stalls++;
+                sink_stats.dropped++;
+            }
+            break;
+        case SINK_SPILL:
+            /* the ring gets the spilled records first to keep the order */
+            if (!flushSpill() || !tryPush(record)) {
+                sink_stats.stalls++;
+                sink_stats.spilled++;
+                spill.push_back(record);
+                sink_stats.spill_peak = std::max(sink_stats.spill_peak, spill.size() - spill_pos);
+            }
+            break;
+    }
+}
+
+void MatchSink::close()
+{
+    while (!flushSpill()) {
+        std::this_thread::yield();
+    }
+    closed.store(true, std::memory_order_release);
+    consumer.join();
+
+    std::sort(latencies.begin(), latencies.end());
+    sink_stats.latency_p50 = percentile(latencies, 0.50);
+    sink_stats.latency_p99 = percentile(latencies, 0.99);
+    sink_stats.latency_max = latencies.empty() ? 0 : latencies.back() / 1000.0;
+}
+
+/* polls the ring, the counters are kept local to stay off the producer's cache lines */
+void MatchSink::consume()
+{
+    std::vector<char> out(SINK_OUTPUT_SIZE);
+    size_t out_len = 0;
+    uint64_t output = 0;
+    uint64_t pos = head.load(std::memory_order_relaxed);
+
+    while (true) {
+        uint64_t const end = tail.load(std::memory_order_acquire);
+
+        if (pos == end) {
+            if (closed.load(std::memory_order_acquire) && tail.load(std::memory_order_acquire) == pos) {
+                break;
+            }
+            std::this_thread::yield();
+            continue;
+        }
+
+        for (; pos < end; pos++) {
+            const MatchRecord& record = records[pos & mask];
+
+            if (pos % SINK_LATENCY_SAMPLE == 0) {
+                uint64_t const now = nowNs();
+                latencies.push_back(now > record.stamp ? now - record.stamp : 0);
+            }
+            if (record.rule < per_rule.size()) {
+                per_rule[record.rule]++;
+            }
+
+            /* the buffer is shipped when full */
+            if (out_len + 64 > out.size()) {
+                output += out_len;
+                out_len = 0;
+            }
+            out_len += snprintf(&out[out_len], 64, "%u:%llu-%llu\n", record.rule, (unsigned long long)record.start,
+                                (unsigned long long)record.end);
+            head.store(pos + 1, std::memory_order_release);
+        }
+    }
+
+    sink_stats.delivered = pos;
+    sink_stats.output = output + out_len;
+}
+
+const char * sink_policy_name(SinkPolicy policy)
+{
+    switch (policy) {
+        case SINK_BLOCK:    return "block";
+        case SINK_DROP:     return "drop";
+        case SINK_SPILL:    return "spill";
+        default:            return "none";
+    }
+}
+
+bool sink_parse_options(const char * spec, SinkOptions * opts)
+{
+    return parse_options(spec, [opts](const std::string& key, const std::string& value) {
+        if (key == "capacity") {
+            if (!corpus_parse_size(value.c_str(), &opts->capacity) || opts->capacity == 0
+                    || opts->capacity > ((size_t)1 << 30)) {
+                fprintf(stderr, "Invalid sink capacity '%s'\n", value.c_str());
+                return false;
+            }
+        } else if (key == "policy") {
+            bool found = value == "all";
+            for (int policy = SINK_BLOCK; policy <= SINK_SPILL; policy++) {
+                opts->policies[policy] = value == "all" || value == sink_policy_name((SinkPolicy)policy);
+                found = found || opts->policies[policy];
+            }
+            if (!found) {
+                fprintf(stderr, "Unknown sink policy '%s' (block, drop, spill, all)\n", value.c_str());
+                return false;
+            }
+        } else {
+            fprintf(stderr, "Unknown match sink option '%s'\n", key.c_str());
+            return false;
+        }
+        return true;
+    });
+}
+
+#ifdef INCLUDE_HYPERSCAN
+namespace {
+
+struct SinkContext {
+    const std::vector<std::string> * rules;
+    std::vector<std::string> * copies;
+    MatchSink * sink;
+    uint64_t matches;
+};
+
+static int onCount(UNUSED unsigned int id, UNUSED unsigned long long from, UNUSED unsigned long long to,
+                   UNUSED unsigned int flags, void * ctx)
+{
+    static_cast<SinkContext *>(ctx)->matches++;
+    return 0;
+}
+
+/* what HyperscanPm::search() does with the matches */
+static int onCopy(unsigned int id, UNUSED unsigned long long from, UNUSED unsigned long long to,
+                  UNUSED unsigned int flags, void * ctx)
+{
+    SinkContext * const sink_ctx = static_cast<SinkContext *>(ctx);
+
+    sink_ctx->matches++;
+    sink_ctx->copies->push_back((*sink_ctx->rules)[id]);
+    return 0;
+}
+
+static int onSink(unsigned int id, unsigned long long from, unsigned long long to, UNUSED unsigned int flags,
+                  void * ctx)
+{
+    SinkContext * const sink_ctx = static_cast<SinkContext *>(ctx);
+
+    sink_ctx->matches++;
+    sink_ctx->sink->push(id, from, to);
+    return 0;
+}
+
+}  // namespace
+
+bool sink_run(const std::vector<std::string>& rules, const char * data, size_t len, int repeat, const SinkOptions& opts,
+              std::vector<SinkResult> * results)
+{
+    std::vector<const char *> patterns;
+    std::vector<unsigned> flags(rules.size(), HS_FLAG_DOTALL | HS_FLAG_MULTILINE | HS_FLAG_SOM_LEFTMOST | hs_option_flags());
+    std::vector<unsigned> ids;
+    hs_database_t * database = NULL;
+    hs_compile_error_t * compile_err = NULL;
+    hs_scratch_t * scratch = NULL;
+    /* an input above 4 GB needs a stream mode database */
+    bool const chunked = len > HS_MAX_SCAN_LEN;
+    bool ok = true;
+
+    results->clear();
+    if (rules.empty()) {
+        fprintf(stderr, "ERROR: No rules.\n");
+        return false;
+    }
+
+    for (size_t iter = 0; iter < rules.size(); iter++) {
+        patterns.push_back(rules[iter].c_str());
+        ids.push_back(iter);
+    }
+
+    unsigned const hs_mode = chunked ? (HS_MODE_STREAM | HS_MODE_SOM_HORIZON_LARGE) : HS_MODE_BLOCK;
+    if (hs_compile_multi(patterns.data(), flags.data(), ids.data(), patterns.size(), hs_mode, NULL, &database,
+                         &compile_err) != HS_SUCCESS) {
+        fprintf(stderr, "ERROR: Unable to compile patterns: %s\n", compile_err ? compile_err->message : "");
+        hs_free_compile_error(compile_err);
+        return false;
+    }
+    if (hs_alloc_scratch(database, &scratch) != HS_SUCCESS) {
+        fprintf(stderr, "ERROR: Unable to allocate scratch space.\n");
+        hs_free_database(database);
+        return false;
+    }
+
+    /* count, vector, then one run per selected policy */
+    for (int mode = -2; mode <= SINK_SPILL && ok; mode++) {
+        std::vector<std::string> copies;
+        std::unique_ptr<MatchSink> sink;
+        SinkContext ctx = {&rules, &copies, NULL, 0};
+        match_event_handler handler = onSink;
+        SinkResult result;
+
+        if (mode == -2) {
+            result.mode = "count";
+            handler = onCount;
+        } else if (mode == -1) {
+            result.mode = "vector";
+            handler = onCopy;
+        } else if (opts.policies[mode]) {
+            result.mode = sink_policy_name((SinkPolicy)mode);
+            sink.reset(new MatchSink((SinkPolicy)mode, opts.capacity, rules.size()));
+            ctx.sink = sink.get();
+        } else {
+            continue;
+        }
+
+        Clock::time_point const start = Clock::now();
+        for (int pass = 0; pass < repeat && ok; pass++) {
+            copies.clear();
+            hs_error_t const err = chunked ? hs_scan_chunked(database, data, len, scratch, handler, &ctx)
+                                           : hs_scan(database, data, len, 0, scratch, handler, &ctx);
+            if (err != HS_SUCCESS) {
+                fprintf(stderr, "ERROR: Unable to scan input buffer.\n");
+                ok = false;
+            }
+        }
+        result.scan = since(start);
+        if (sink) {
+            sink->close();
+            result.stats = sink->stats();
+        }
+        result.total = since(start);
+        result.bytes = (uint64_t)len * repeat;
+        result.matches = ctx.matches;
+        results->push_back(result);
+    }
+
+    hs_free_scratch(scratch);
+    hs_free_database(database);
+    return ok;
+}
+#endif
@@ -0,0 +1,112 @@
+#ifndef MATCH_SINK_HPP
+#define MATCH_SINK_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Delivery of matches to a consumer thread, as a service ships them instead of
+ * counting them. The match callback pushes a compact record into a lock-free
+ * single producer, single consumer ring, the consumer formats every record into
+ * an output buffer and counts the matches per rule. A full ring either blocks
+ * the scan, drops the record or spills it into an unbounded buffer of the
+ * producer that is moved into the ring in order as space frees up.
+ */
+enum SinkPolicy {
+    SINK_BLOCK,
+    SINK_DROP,
+    SINK_SPILL,
+};
+
+struct MatchRecord {
+    uint32_t rule;
+    uint32_t reserved;
+    uint64_t start;
+    uint64_t end;
+    uint64_t stamp;     /* ns, steady clock at the push */
+};
+
+struct SinkStats {
+    uint64_t pushed = 0;
+    uint64_t delivered = 0;
+    uint64_t dropped = 0;
+    uint64_t spilled = 0;
+    size_t spill_peak = 0;      /* records */
+    uint64_t stalls = 0;        /* pushes that found the ring full */
+    double stall = 0;           /* ms the scan was blocked */
+    double latency_p50 = 0;     /* us from the push to the consumer, sampled */
+    double latency_p99 = 0;
+    double latency_max = 0;
+    uint64_t output = 0;        /* bytes formatted by the consumer */
+};
+
+class MatchSink {
+public:
+    /* the capacity is rounded up to a power of two, the consumer starts at once */
+    MatchSink(SinkPolicy policy, size_t capacity, size_t rules);
+    ~MatchSink();
+
+    MatchSink(const MatchSink&) = delete;
+    MatchSink& operator=(const MatchSink&) = delete;
+
+    void push(uint32_t rule, uint64_t start, uint64_t end);
+
+    /* delivers the spilled records and waits for the consumer */
+    void close();
+
+    const SinkStats& stats() const { return sink_stats; }
+    const std::vector<uint64_t>& perRule() const { return per_rule; }
+
+private:
+    bool tryPush(const MatchRecord& record);
+    bool flushSpill();
+    void consume();
+
+    SinkPolicy policy;
+    std::vector<MatchRecord> records;
+    size_t mask;
+
+    /* the consumer's and the producer's fields are padded onto separate cache lines */
+    std::atomic<uint64_t> head;                 /* next record of the consumer */
+    char head_pad[64];
+    std::atomic<uint64_t> tail;                 /* next free record of the producer */
+    uint64_t head_cache = 0;                    /* the producer's last view of head */
+    std::vector<MatchRecord> spill;
+    size_t spill_pos = 0;
+    SinkStats sink_stats;                       /* the producer's until the consumer is joined */
+    char tail_pad[64];
+    std::atomic<bool> closed;
+
+    std::vector<uint64_t> per_rule;             /* consumer */
+    std::vector<uint64_t> latencies;            /* consumer, ns */
+    std::thread consumer;
+};
+
+const char * sink_policy_name(SinkPolicy policy);
+
+struct SinkOptions {
+    size_t capacity = 1 << 16;      /* records */
+    bool policies[SINK_SPILL + 1] = {true, true, true};
+};
+
+struct SinkResult {
+    std::string mode;       /* count, vector (string copies in the scan) or a sink policy */
+    double scan = 0;        /* ms until the scan returned */
+    double total = 0;       /* ms until every match was delivered */
+    uint64_t bytes = 0;
+    uint64_t matches = 0;
+    SinkStats stats;
+};
+
+/* parses "capacity=64K,policy=all" (block, drop, spill, all) */
+bool sink_parse_options(const char * spec, SinkOptions * opts);
+
+/* one multi-pattern Hyperscan database, the baselines and every selected policy */
+bool sink_run(const std::vector<std::string>& rules, const char * data, size_t len, int repeat, const SinkOptions& opts,
+              std::vector<SinkResult> * results);
+
+#endif // MATCH_SINK_HPP
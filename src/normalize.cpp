@@ -0,0 +1,503 @@
+#include <ctype.h>
+#include <string.h>
+
+#include <unordered_map>
+
+#include "normalize.hpp"
+
+namespace {
+
+struct Token {
+    enum Kind {
+        LITERAL,    /* plain or escaped character, value holds it */
+        CASE_PAIR,  /* [aA] or [Aa], value holds the lower case letter */
+        CLASS,      /* any other [...] */
+        ESCAPE,     /* \d, \b, \1, \p{..} and other escapes that are not a character */
+        DOT,
+        ANCHOR,     /* ^ or $ */
+        OPEN,       /* ( (?: or a special group such as (?= or (?<name> */
+        CLOSE,
+        ALT,
+        QUANT,      /* *, +, ?, {n,m} with an optional lazy or possessive suffix */
+        FLAGS,      /* (?i) and other inline flags */
+    };
+
+    Token(Kind kind, const std::string& text) : kind(kind), text(text) {}
+
+    Kind kind;
+    std::string text;
+    char value = 0;
+    bool letters = false;   /* the matched set changes under (?i) */
+    bool plain = false;     /* ( or (?:, a group without side effects */
+};
+
+/* printable characters without a meaning in a pattern or a class, \xHH of these is unescaped */
+static bool plain_char(int c)
+{
+    return isalnum(c) || (c != 0 && strchr("%&,:;=@_~!\"'<>/", c) != NULL);
+}
+
+static int hex_value(int c)
+{
+    return isdigit(c) ? c - '0' : tolower(c) - 'a' + 10;
+}
+
+/* length of the escape at pattern[pos] including the backslash */
+static size_t escape_len(const std::string& pattern, size_t pos)
+{
+    size_t const len = pattern.size();
+
+    if (pos + 1 >= len) {
+        return 1;
+    }
+
+    char const c = pattern[pos + 1];
+    if ((c == 'x' || c == 'p' || c == 'P') && pos + 2 < len && pattern[pos + 2] == '{') {
+        size_t const end = pattern.find('}', pos + 2);
+        return end == std::string::npos ? len - pos : end - pos + 1;
+    }
+    if (c == 'x') {
+        size_t digits = 0;
+        while (digits < 2 && pos + 2 + digits < len && isxdigit((unsigned char)pattern[pos + 2 + digits])) {
+            digits++;
+        }
+        return 2 + digits;
+    }
+    if (c == 'c' && pos + 2 < len) {
+        return 3;
+    }
+    return 2;
+}
+
+static Token escape_token(const std::string& text)
+{
+    Token token = {Token::ESCAPE, text};
+
+    if (text.size() == 4 && text[1] == 'x') {
+        token.kind = Token::LITERAL;
+        token.value = (char)(hex_value((unsigned char)text[2]) * 16 + hex_value((unsigned char)text[3]));
+    } else if (text.size() == 2 && !isalnum((unsigned char)text[1])) {
+        token.kind = Token::LITERAL;
+        token.value = text[1];
+    }
+    return token;
+}
+
+/* escapes that match the same set with and without (?i), any other escape (\1, \p{Lu}, \x{41}, \k<name>) may not */
+static bool caseless_escape(const Token& token)
+{
+    return token.text.size() == 2 && strchr("dDsSwWbBAzZGnrtfvae", token.text[1]) != NULL;
+}
+
+/* the byte of a class member, -1 for an escape that is not one byte such as \d, \101 or \p{Lu} */
+static int class_byte(const std::string& pattern, size_t pos, size_t * len)
+{
+    if (pattern[pos] != '\\') {
+        *len = 1;
+        return (unsigned char)pattern[pos];
+    }
+
+    *len = escape_len(pattern, pos);
+    Token const token = escape_token(pattern.substr(pos, *len));
+    return token.kind == Token::LITERAL ? (unsigned char)token.value : -1;
+}
+
+/* a range is checked byte by byte, [!-Z] or [0-z] holds letters without naming one */
+static bool range_letters(int first, int last)
+{
+    if (first < 0 || last < 0) {
+        return true;
+    }
+    for (int c = first; c <= last; c++) {
+        if (isalpha(c)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static size_t class_end(const std::string& pattern, size_t pos, bool * letters)
+{
+    size_t iter = pos + 1;
+
+    if (iter < pattern.size() && pattern[iter] == '^') {
+        iter++;
+    }
+    if (iter < pattern.size() && pattern[iter] == ']') {
+        iter++;
+    }
+
+    while (iter < pattern.size() && pattern[iter] != ']') {
+        if (pattern[iter] == '[' && iter + 1 < pattern.size() && pattern[iter + 1] == ':') {
+            size_t const end = pattern.find(":]", iter + 2);
+            *letters = true;
+            iter = (end == std::string::npos) ? pattern.size() : end + 2;
+            continue;
+        }
+
+        size_t len;
+        int const first = class_byte(pattern, iter, &len);
+
+        if (iter + len + 1 < pattern.size() && pattern[iter + len] == '-' && pattern[iter + len + 1] != ']') {
+            size_t last_len;
+            int const last = class_byte(pattern, iter + len + 1, &last_len);
+
+            *letters |= range_letters(first, last);
+            iter += len + 1 + last_len;
+        } else if (first < 0) {
+            *letters |= !caseless_escape(Token(Token::ESCAPE, pattern.substr(iter, len)));
+            iter += len;
+        } else {
+            *letters |= isalpha(first) != 0;
+            iter += len;
+        }
+    }
+    return iter < pattern.size() ? iter + 1 : pattern.size();
+}
+
+static bool is_bound(const std::string& pattern, size_t pos, size_t * end)
+{
+    size_t iter = pos + 1;
+    bool digits = false;
+
+    while (iter < pattern.size() && (isdigit((unsigned char)pattern[iter]) || pattern[iter] == ',')) {
+        digits |= pattern[iter] != ',';
+        iter++;
+    }
+    if (!digits || iter >= pattern.size() || pattern[iter] != '}' || pattern[pos + 1] == ',') {
+        return false;
+    }
+    *end = iter + 1;
+    return true;
+}
+
+static std::vector<Token> tokenize(const std::string& pattern)
+{
+    std::vector<Token> tokens;
+    size_t pos = 0;
+
+    while (pos < pattern.size()) {
+        char const c = pattern[pos];
+        size_t end = pos + 1;
+        Token token = {Token::LITERAL, ""};
+
+        switch (c) {
+            case '\\':
+                end = pos + escape_len(pattern, pos);
+                token = escape_token(pattern.substr(pos, end - pos));
+                break;
+
+            case '[': {
+                bool letters = false;
+                end = class_end(pattern, pos, &letters);
+                token.kind = Token::CLASS;
+                token.letters = letters;
+                if (end - pos == 4 && isalpha((unsigned char)pattern[pos + 1])
+                    && pattern[pos + 1] != pattern[pos + 2]
+                    && tolower((unsigned char)pattern[pos + 1]) == tolower((unsigned char)pattern[pos + 2])) {
+                    token.kind = Token::CASE_PAIR;
+                    token.value = (char)tolower((unsigned char)pattern[pos + 1]);
+                }
+                break;
+            }
+
+            case '(':
+                token.kind = Token::OPEN;
+                token.plain = true;
+                if (pos + 1 < pattern.size() && pattern[pos + 1] == '?') {
+                    end = pattern.find_first_of(":=!>)", pos + 2);
+                    end = (end == std::string::npos) ? pattern.size() : end + 1;
+                    token.kind = (pattern[end - 1] == ')') ? Token::FLAGS : Token::OPEN;
+                    token.plain = end - pos == 3 && pattern[end - 1] == ':';
+                }
+                break;
+
+            case ')':
+                token.kind = Token::CLOSE;
+                break;
+
+            case '|':
+                token.kind = Token::ALT;
+                break;
+
+            case '.':
+                token.kind = Token::DOT;
+                break;
+
+            case '^':
+            case '$':
+                token.kind = Token::ANCHOR;
+                break;
+
+            case '*':
+            case '+':
+            case '?':
+                token.kind = Token::QUANT;
+                break;
+
+            case '{':
+                if (is_bound(pattern, pos, &end)) {
+                    token.kind = Token::QUANT;
+                }
+                break;
+
+            default:
+                break;
+        }
+
+        if (token.kind == Token::QUANT && end < pattern.size() && (pattern[end] == '?' || pattern[end] == '+')) {
+            end++;
+        }
+        if (token.text.empty()) {
+            token.text = pattern.substr(pos, end - pos);
+        }
+        if (token.kind == Token::LITERAL && token.text.size() == 1) {
+            token.value = c;
+        }
+
+        tokens.push_back(token);
+        pos = end;
+    }
+
+    return tokens;
+}
+
+static std::string join(const std::vector<Token>& tokens, size_t begin, size_t end)
+{
+    std::string out;
+
+    for (size_t iter = begin; iter < end; iter++) {
+        out += tokens[iter].text;
+    }
+    return out;
+}
+
+static bool quantified(const std::vector<Token>& tokens, size_t pos)
+{
+    return pos + 1 < tokens.size() && tokens[pos + 1].kind == Token::QUANT;
+}
+
+static bool unescape(std::vector<Token> * tokens)
+{
+    bool changed = false;
+
+    for (auto& token : *tokens) {
+        if (token.kind == Token::LITERAL && token.text.size() > 1 && token.text[1] == 'x'
+            && plain_char((unsigned char)token.value)) {
+            token.text.assign(1, token.value);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+/* leading inline flags such as (?i) apply to the whole rule */
+static size_t skip_flags(const std::vector<Token>& tokens)
+{
+    size_t pos = 0;
+
+    while (pos < tokens.size() && tokens[pos].kind == Token::FLAGS) {
+        pos++;
+    }
+    return pos;
+}
+
+/* ^ $ \b \B \A \z \Z \G match an empty string only */
+static bool assertion(const Token& token)
+{
+    return token.kind == Token::ANCHOR
+        || (token.kind == Token::ESCAPE && token.text.size() == 2 && strchr("bBAzZG", token.text[1]) != NULL);
+}
+
+/* .* .*? .? .{0,n} in front of an unanchored rule can always match nothing */
+static bool strip_prefix(std::vector<Token> * tokens)
+{
+    size_t const pos = skip_flags(*tokens);
+    bool changed = false;
+
+    while (pos + 2 < tokens->size() && (*tokens)[pos].kind == Token::DOT && (*tokens)[pos + 1].kind == Token::QUANT) {
+        const std::string& quant = (*tokens)[pos + 1].text;
+        Token::Kind const next = (*tokens)[pos + 2].kind;
+        bool only_assertions = true;
+
+        for (size_t iter = pos + 2; iter < tokens->size() && only_assertions; iter++) {
+            only_assertions = assertion((*tokens)[iter]);
+        }
+
+        /* a possessive .*+ never gives back, it is not redundant, and .*$ must not become an empty match $ */
+        if ((quant[0] != '*' && quant[0] != '?' && quant.compare(0, 3, "{0,") != 0)
+            || (quant.size() > 1 && quant.back() == '+') || next == Token::ALT || next == Token::QUANT
+            || only_assertions) {
+            break;
+        }
+        tokens->erase(tokens->begin() + pos, tokens->begin() + pos + 2);
+        changed = true;
+    }
+    return changed;
+}
+
+static bool case_sensitive(const Token& token)
+{
+    return (token.kind == Token::LITERAL && isalpha((unsigned char)token.value))
+        || (token.kind == Token::CLASS && token.letters)
+        || (token.kind == Token::ESCAPE && !caseless_escape(token))
+        || token.kind == Token::FLAGS
+        || (token.kind == Token::OPEN && !token.plain);
+}
+
+/* (?-i) or (?s:...) after the leading flags */
+static bool later_flags(const std::vector<Token>& tokens, size_t start)
+{
+    for (size_t iter = start; iter < tokens.size(); iter++) {
+        const Token& token = tokens[iter];
+
+        if (token.kind == Token::FLAGS || (token.kind == Token::OPEN && !token.plain && token.text.back() == ':')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool rewrite_case_pairs(std::vector<Token> * tokens)
+{
+    size_t const start = skip_flags(*tokens);
+    bool const leading_i = start > 0 && (*tokens)[0].text == "(?i)";
+    bool whole = true;
+    size_t pairs = 0;
+
+    for (size_t iter = 0; iter < tokens->size(); iter++) {
+        const Token& token = (*tokens)[iter];
+
+        pairs += token.kind == Token::CASE_PAIR;
+        if (iter >= start && case_sensitive(token)) {
+            whole = false;
+        }
+    }
+
+    if (pairs == 0 || (leading_i && later_flags(*tokens, start))) {
+        return false;
+    }
+
+    /*
+     * Only a rule that is case insensitive as a whole is rewritten, the classes
+     * become plain letters behind a leading (?i). (?i:...) groups around parts of
+     * a rule are not supported by cppstd, regress and YARA, such rules keep their
+     * classes.
+     */
+    if (!leading_i && !(whole && start == 0)) {
+        return false;
+    }
+    for (auto& token : *tokens) {
+        if (token.kind == Token::CASE_PAIR) {
+            token.kind = Token::LITERAL;
+            token.text.assign(1, token.value);
+        }
+    }
+    if (!leading_i) {
+        Token flags = {Token::FLAGS, "(?i)"};
+        tokens->insert(tokens->begin(), flags);
+    }
+    return true;
+}
+
+/* a|ab|ac with a common prefix p becomes p(?:...), the alternatives must not become empty */
+static bool factor_prefix(std::vector<Token> * tokens)
+{
+    size_t const start = skip_flags(*tokens);
+    std::vector<size_t> branches = {start};
+    int depth = 0;
+
+    for (size_t iter = start; iter < tokens->size(); iter++) {
+        Token::Kind const kind = (*tokens)[iter].kind;
+
+        if (kind == Token::OPEN) {
+            depth++;
+        } else if (kind == Token::CLOSE) {
+            depth--;
+        } else if (kind == Token::ALT && depth == 0) {
+            branches.push_back(iter + 1);
+        } else if (kind == Token::FLAGS) {
+            return false;
+        }
+    }
+    if (branches.size() < 2) {
+        return false;
+    }
+    branches.push_back(tokens->size() + 1);
+
+    size_t prefix = 0;
+    bool common = true;
+    while (common) {
+        for (size_t branch = 0; branch + 1 < branches.size() && common; branch++) {
+            size_t const pos = branches[branch] + prefix;
+            size_t const branch_end = branches[branch + 1] - 1;
+            Token::Kind const kind = (pos < branch_end) ? (*tokens)[pos].kind : Token::ALT;
+
+            /* one token has to stay in every alternative */
+            common = pos + 1 < branch_end
+                     && kind != Token::OPEN && kind != Token::CLOSE && kind != Token::QUANT && kind != Token::ALT
+                     && !quantified(*tokens, pos)
+                     && (*tokens)[pos].text == (*tokens)[branches[0] + prefix].text;
+        }
+        if (common) {
+            prefix++;
+        }
+    }
+    if (prefix == 0) {
+        return false;
+    }
+
+    std::vector<Token> factored(tokens->begin(), tokens->begin() + start + prefix);
+    std::string alternatives = "(?:";
+    for (size_t branch = 0; branch + 1 < branches.size(); branch++) {
+        if (branch > 0) {
+            alternatives += "|";
+        }
+        alternatives += join(*tokens, branches[branch] + prefix, branches[branch + 1] - 1);
+    }
+    alternatives += ")";
+
+    Token group = {Token::ESCAPE, alternatives};
+    factored.push_back(group);
+    tokens->swap(factored);
+    return true;
+}
+
+}  // namespace
+
+std::string normalize_rule(const std::string& rule, NormalizeStats * stats)
+{
+    std::vector<Token> tokens = tokenize(rule);
+
+    stats->unescaped += unescape(&tokens);
+    stats->stripped += strip_prefix(&tokens);
+    stats->caseless += rewrite_case_pairs(&tokens);
+    stats->factored += factor_prefix(&tokens);
+
+    return join(tokens, 0, tokens.size());
+}
+
+NormalizedRules normalize_rules(const std::vector<std::string>& rules, NormalizeStats * stats)
+{
+    NormalizedRules out;
+    std::unordered_map<std::string, size_t> seen;
+
+    *stats = NormalizeStats();
+
+    for (size_t iter = 0; iter < rules.size(); iter++) {
+        std::string const rule = normalize_rule(rules[iter], stats);
+        auto it = seen.find(rule);
+
+        if (it != seen.end()) {
+            out.ids[it->second].push_back(iter + 1);
+            stats->duplicates++;
+            continue;
+        }
+
+        seen.emplace(rule, out.rules.size());
+        out.rules.push_back(rule);
+        out.ids.push_back({iter + 1});
+    }
+
+    return out;
+}
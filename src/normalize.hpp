@@ -0,0 +1,37 @@
+#ifndef NORMALIZE_HPP
+#define NORMALIZE_HPP
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+/*
+ * Textual clean-up of a rule set before it is compiled by the engines. The
+ * rules keep their syntax, only these rewrites are applied:
+ *  - \xHH escapes of plain characters are replaced by the character,
+ *  - a redundant leading .* .*? .? or .{0,n} of an unanchored rule is removed,
+ *  - [aA] style classes become plain letters behind a leading (?i) if no
+ *    other letter or escape of the rule is case sensitive,
+ *  - a common prefix of all top level alternatives is factored out,
+ *  - identical rules are merged, ids keeps the input rules behind each rule.
+ * The normalized rules match the same places, but a removed .* or .{0,n} can
+ * change the match boundaries and with them the number of reported matches.
+ */
+struct NormalizeStats {
+    size_t unescaped = 0;
+    size_t stripped = 0;
+    size_t caseless = 0;
+    size_t factored = 0;
+    size_t duplicates = 0;
+};
+
+struct NormalizedRules {
+    std::vector<std::string> rules;
+    std::vector<std::vector<size_t>> ids;   /* 1-based ids of the input rules */
+};
+
+std::string normalize_rule(const std::string& rule, NormalizeStats * stats);
+
+NormalizedRules normalize_rules(const std::vector<std::string>& rules, NormalizeStats * stats);
+
+#endif // NORMALIZE_HPP
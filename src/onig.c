@@ -5,13 +5,16 @@
 
 #include <oniguruma.h>
 
-int onig_find_all(char* pattern, char* subject, int subject_len, int repeat, struct result * result)
+int onig_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * result)
 {
 	regex_t* reg;
 	OnigRegion *region;
 	TIME_TYPE start, end;
 	unsigned char *ptr;
-	int res, len, found = 0;
+	int res;
+	size_t len;
+	uint64_t found = 0;
+	uint64_t captures = 0;
 	
 	double pre_times = 0;
 	GET_TIME(start);
@@ -36,24 +39,34 @@ int onig_find_all(char* pattern, char* subject, int subject_len, int repeat, str
 
 	do {
 		found = 0;
+		captures = 0;
 		ptr = (unsigned char *)subject;
 		len = subject_len;
 
-		GET_TIME(start);
+		START_SCAN_TIME(start);
 		while (1) {
 			res = onig_search(reg, ptr, ptr + len, ptr, ptr + len, region, ONIG_OPTION_NONE);
 			if (res < 0)
 				break;
 			// printf("match: %d %d\n", (ptr - (unsigned char *)subject) + region->beg[0], (ptr - (unsigned char *)subject) + region->end[0]);
+			/* the region always holds the groups, --captures only reads them */
+			if (regex_captures) {
+				for (int group = 1; group < region->num_regs; group++) {
+					captures += region->beg[group] != ONIG_REGION_NOTPOS;
+				}
+			}
 			ptr += region->end[0];
 			len -= region->end[0];
 			found++;
+			if (regex_is_match)
+				break;
 		}
-		GET_TIME(end);
+		STOP_SCAN_TIME(end);
         times[repeat - 1] = TIME_DIFF_IN_MS(start, end);
 	} while (--repeat > 0);
 
 	result->matches = found;
+	result->captures = captures;
     get_mean_and_derivation(pre_times, times, times_len, result);
 
 	onig_region_free(region, 1);
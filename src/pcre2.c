@@ -7,26 +7,164 @@
 
 static int work_space[4096];
 
-int pcre2_find_all(const char* pattern, const char* subject, int subject_len, int repeat, int mode, struct result * res)
+/* capture groups set in the ovector of a match, pairs is the return value of pcre2_match() */
+static uint64_t pcre2_groups(const PCRE2_SIZE *ovector, int pairs)
+{
+    uint64_t groups = 0;
+
+    for (int iter = 1; iter < pairs; iter++) {
+        groups += ovector[2 * iter] != PCRE2_UNSET;
+    }
+    return groups;
+}
+
+/* captures is NULL unless the groups are extracted, the match data then only holds the match bounds */
+static uint64_t pcre2_scan(pcre2_code *re, int mode, const char* subject, size_t subject_len,
+                           pcre2_match_data *match_data, pcre2_match_context *match_ctx, uint64_t *captures)
+{
+    PCRE2_SIZE *ovector = pcre2_get_ovector_pointer(match_data);
+    const char *ptr = subject;
+    PCRE2_SIZE len = subject_len;
+    int err_code;
+    uint64_t found = 0;
+
+    /* --is-match: one call per input, the DFA matcher stops at the shortest match */
+    if (regex_is_match) {
+        switch (mode) {
+        case 0:
+            err_code = pcre2_match(re, (PCRE2_SPTR8) subject, subject_len, 0, 0, match_data, match_ctx);
+            break;
+        case 1:
+            err_code = pcre2_dfa_match(re, (PCRE2_SPTR8) subject, subject_len, 0, PCRE2_DFA_SHORTEST,
+                                       match_data, match_ctx, work_space, 4096);
+            break;
+        default:
+            err_code = pcre2_jit_match(re, (PCRE2_SPTR8) subject, subject_len, 0, 0, match_data, match_ctx);
+            break;
+        }
+
+        if (err_code < 0 && err_code != PCRE2_ERROR_NOMATCH)
+            printf("PCRE pcre_exec failed with: %d\n", err_code);
+        return err_code >= 0;
+    }
+
+    switch (mode) {
+    case 0:
+        while (1) {
+            err_code = pcre2_match(
+                re,            /* the compiled pattern */
+                (PCRE2_SPTR8) ptr,    /* the subject string */
+                len,            /* the length of the subject */
+                0,            /* start at offset 0 in the subject */
+                0,            /* default options */
+                match_data,        /* match data */
+                match_ctx);        /* match context */
+
+            /* 0: the match data is too small for the groups, the match bounds are set */
+            if (err_code < 0) {
+                if (err_code == PCRE2_ERROR_NOMATCH)
+                    break;
+                printf("PCRE pcre_exec failed with: %d\n", err_code);
+                break;
+            }
+
+            // printf("match: %d %d\n", (ptr - subject) + match[0], (ptr - subject) + match[1]);
+            if (captures)
+                *captures += pcre2_groups(ovector, err_code);
+            ptr += ovector[1];
+            len -= ovector[1];
+            found++;
+        }
+        break;
+
+    case 1:
+        while (1) {
+            err_code = pcre2_dfa_match(
+                re,            /* the compiled pattern */
+                (PCRE2_SPTR8) ptr,    /* the subject string */
+                len,            /* the length of the subject */
+                0,            /* start at offset 0 in the subject */
+                0,            /* default options */
+                match_data,        /* match data */
+                match_ctx,        /* match context */
+                work_space,        /* work space */
+                4096);            /* number of elements (NOT size in bytes) */
+
+            if (err_code <= 0) {
+                if (err_code == PCRE2_ERROR_NOMATCH)
+                    break;
+                printf("PCRE pcre_exec failed with: %d\n", err_code);
+                break;
+            }
+
+            // printf("match: %d %d\n", (ptr - subject) + match[0], (ptr - subject) + match[1]);
+            ptr += ovector[1];
+            len -= ovector[1];
+            found++;
+        }
+        break;
+
+    case 2:
+        while (1) {
+            err_code = pcre2_jit_match(
+                re,            /* the compiled pattern */
+                (PCRE2_SPTR8) ptr,    /* the subject string */
+                len,            /* the length of the subject */
+                0,            /* start at offset 0 in the subject */
+                0,            /* default options */
+                match_data,        /* match data */
+                match_ctx);        /* match context */
+
+            /* 0: the match data is too small for the groups, the match bounds are set */
+            if (err_code < 0) {
+                if (err_code == PCRE2_ERROR_NOMATCH)
+                    break;
+                printf("PCRE pcre_exec failed with: %d\n", err_code);
+                break;
+            }
+
+            // printf("match: %d %d\n", (ptr - subject) + match[0], (ptr - subject) + match[1]);
+            if (captures)
+                *captures += pcre2_groups(ovector, err_code);
+            ptr += ovector[1];
+            len -= ovector[1];
+            found++;
+        }
+        break;
+    }
+
+    return found;
+}
+
+static int pcre2_find_all(const char* pattern, const char* subject, size_t subject_len, const struct blocks * blocks,
+                          int repeat, int mode, struct result * res)
 {
     pcre2_code *re;
+    pcre2_general_context *gen_ctx;
     pcre2_compile_context *comp_ctx;
     pcre2_match_data *match_data;
     pcre2_match_context *match_ctx;
     int err_code;
     PCRE2_SIZE err_offset;
     pcre2_jit_stack *stack = NULL;
-    PCRE2_SIZE *ovector;
-    const char *ptr;
-    int len;
     TIME_TYPE start = 0, end = 0;
-    int found = 0;
+    uint64_t found = 0;
+    uint64_t captures = 0;
+    /* the DFA matcher has no capture groups */
+    uint64_t * const groups = (regex_captures && mode != 1) ? &captures : NULL;
 
     double pre_times = 0;
 
     GET_TIME(start);
 
-    comp_ctx = pcre2_compile_context_create(NULL);
+    /* compiled code, contexts, match data and JIT stacks come from the allocator of --allocator */
+    gen_ctx = pcre2_general_context_create(alloc_pcre2_malloc, alloc_pcre2_free, NULL);
+    if (!gen_ctx) {
+        printf("PCRE2 cannot allocate general context\n");
+        return -1;
+    }
+
+    comp_ctx = pcre2_compile_context_create(gen_ctx);
     if (!comp_ctx) {
         printf("PCRE2 cannot allocate compile context\n");
         return -1;
@@ -34,10 +172,14 @@ int pcre2_find_all(const char* pattern, const char* subject, int subject_len, in
 
     pcre2_set_newline(comp_ctx, PCRE2_NEWLINE_ANYCRLF);
 
+    /* invalid UTF-8 in the input does not abort the match, it just never matches */
+    uint32_t const utf = (regex_encoding == ENC_UTF8) ? PCRE2_UTF | PCRE2_UCP | PCRE2_MATCH_INVALID_UTF : 0;
+    uint32_t const caseless = (regex_caseless == CASE_NATIVE) ? PCRE2_CASELESS : 0;
+
     re = pcre2_compile(
         (PCRE2_SPTR8) pattern,    /* the pattern */
         PCRE2_ZERO_TERMINATED,    /* length */
-        PCRE2_MULTILINE,    /* options */
+        PCRE2_MULTILINE | utf | caseless,    /* options */
         &err_code,        /* for error code */
         &err_offset,        /* for error offset */
         comp_ctx);        /* use default character tables */
@@ -49,7 +191,7 @@ int pcre2_find_all(const char* pattern, const char* subject, int subject_len, in
 
     pcre2_compile_context_free(comp_ctx);
 
-    match_ctx = pcre2_match_context_create(NULL);
+    match_ctx = pcre2_match_context_create(gen_ctx);
     if (!match_ctx) {
         printf("PCRE JIT cannot allocate match context\n");
         return -1;
@@ -63,7 +205,7 @@ int pcre2_find_all(const char* pattern, const char* subject, int subject_len, in
             printf("PCRE JIT compilation failed\n");
             return -1;
         }
-        stack = pcre2_jit_stack_create(65536, 65536, NULL);
+        stack = pcre2_jit_stack_create(65536, 65536, gen_ctx);
         if (!stack) {
             printf("PCRE JIT cannot allocate JIT stack\n");
             return -1;
@@ -72,135 +214,77 @@ int pcre2_find_all(const char* pattern, const char* subject, int subject_len, in
     }
 
     if (mode == 1)
-        match_data = pcre2_match_data_create(32, NULL);
+        match_data = pcre2_match_data_create(32, gen_ctx);
+    else if (regex_captures)
+        match_data = pcre2_match_data_create_from_pattern(re, gen_ctx);
     else
-        match_data = pcre2_match_data_create_from_pattern(re, NULL);
+        match_data = pcre2_match_data_create(1, gen_ctx);
 
     if (!match_data) {
         printf("PCRE2 cannot allocate match data\n");
         return -1;
     }
 
-    ovector = pcre2_get_ovector_pointer(match_data);
-
     double * times = calloc(repeat, sizeof(double));
     int const times_len = repeat;
 
     do {
-        found = 0;
-        ptr = subject;
-        len = subject_len;
-        switch (mode) {
-        case 0:
-            GET_TIME(start);
-            while (1) {
-                err_code = pcre2_match(
-                    re,            /* the compiled pattern */
-                    (PCRE2_SPTR8) ptr,    /* the subject string */
-                    len,            /* the length of the subject */
-                    0,            /* start at offset 0 in the subject */
-                    0,            /* default options */
-                    match_data,        /* match data */
-                    match_ctx);        /* match context */
-
-                if (err_code <= 0) {
-                    if (err_code == PCRE2_ERROR_NOMATCH)
-                        break;
-                    printf("PCRE pcre_exec failed with: %d\n", err_code);
-                    break;
-                }
-
-                // printf("match: %d %d\n", (ptr - subject) + match[0], (ptr - subject) + match[1]);
-                ptr += ovector[1];
-                len -= ovector[1];
-                found++;
-            }
-            GET_TIME(end);
-            break;
-
-        case 1:
-            GET_TIME(start);
-            while (1) {
-                err_code = pcre2_dfa_match(
-                    re,            /* the compiled pattern */
-                    (PCRE2_SPTR8) ptr,    /* the subject string */
-                    len,            /* the length of the subject */
-                    0,            /* start at offset 0 in the subject */
-                    0,            /* default options */
-                    match_data,        /* match data */
-                    match_ctx,        /* match context */
-                    work_space,        /* work space */
-                    4096);            /* number of elements (NOT size in bytes) */
-
-                if (err_code <= 0) {
-                    if (err_code == PCRE2_ERROR_NOMATCH)
-                        break;
-                    printf("PCRE pcre_exec failed with: %d\n", err_code);
-                    break;
-                }
-
-                // printf("match: %d %d\n", (ptr - subject) + match[0], (ptr - subject) + match[1]);
-                ptr += ovector[1];
-                len -= ovector[1];
-                found++;
-            }
-            GET_TIME(end);
-            break;
-
-        case 2:
-            GET_TIME(start);
-            while (1) {
-                err_code = pcre2_jit_match(
-                    re,            /* the compiled pattern */
-                    (PCRE2_SPTR8) ptr,    /* the subject string */
-                    len,            /* the length of the subject */
-                    0,            /* start at offset 0 in the subject */
-                    0,            /* default options */
-                    match_data,        /* match data */
-                    match_ctx);        /* match context */
-
-                if (err_code <= 0) {
-                    if (err_code == PCRE2_ERROR_NOMATCH)
-                        break;
-                    printf("PCRE pcre_exec failed with: %d\n", err_code);
-                    break;
-                }
-
-                // printf("match: %d %d\n", (ptr - subject) + match[0], (ptr - subject) + match[1]);
-                ptr += ovector[1];
-                len -= ovector[1];
-                found++;
+        START_SCAN_TIME(start);
+        captures = 0;
+        if (blocks) {
+            found = 0;
+            for (size_t iter = 0; iter < blocks->count; iter++) {
+                found += pcre2_scan(re, mode, blocks->data[iter], blocks->len[iter], match_data, match_ctx, groups);
             }
-            GET_TIME(end);
-            break;
+        } else {
+            found = pcre2_scan(re, mode, subject, subject_len, match_data, match_ctx, groups);
         }
+        STOP_SCAN_TIME(end);
 
         times[repeat - 1] = TIME_DIFF_IN_MS(start, end);
     } while (--repeat > 0);
 
     res->matches = found;
+    res->captures = captures;
     get_mean_and_derivation(pre_times, times, times_len, res);
 
     if (stack)
         pcre2_jit_stack_free(stack);
+    pcre2_match_data_free(match_data);
     pcre2_match_context_free(match_ctx);
     pcre2_code_free(re);
+    pcre2_general_context_free(gen_ctx);
     free(times);
 
     return 0;
 }
 
-int pcre2_std_find_all(const char* pattern, const char* subject, int subject_len, int repeat, struct result * res)
+int pcre2_std_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res)
+{
+    return pcre2_find_all(pattern, subject, subject_len, NULL, repeat, 0, res);
+}
+
+int pcre2_dfa_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res)
+{
+    return pcre2_find_all(pattern, subject, subject_len, NULL, repeat, 1, res);
+}
+
+int pcre2_jit_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res)
+{
+    return pcre2_find_all(pattern, subject, subject_len, NULL, repeat, 2, res);
+}
+
+int pcre2_std_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res)
 {
-    return pcre2_find_all(pattern, subject, subject_len, repeat, 0, res);
+    return pcre2_find_all(pattern, NULL, 0, blocks, repeat, 0, res);
 }
 
-int pcre2_dfa_find_all(const char* pattern, const char* subject, int subject_len, int repeat, struct result * res)
+int pcre2_dfa_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res)
 {
-    return pcre2_find_all(pattern, subject, subject_len, repeat, 1, res);
+    return pcre2_find_all(pattern, NULL, 0, blocks, repeat, 1, res);
 }
 
-int pcre2_jit_find_all(const char* pattern, const char* subject, int subject_len, int repeat, struct result * res)
+int pcre2_jit_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res)
 {
-    return pcre2_find_all(pattern, subject, subject_len, repeat, 2, res);
+    return pcre2_find_all(pattern, NULL, 0, blocks, repeat, 2, res);
 }
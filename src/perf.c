@@ -0,0 +1,181 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "main.h"
+
+/*
+ * The counters are split into two groups: most PMUs cannot schedule all seven events at once
+ * (especially with SMT enabled), a group that does not fit would never count. The kernel
+ * multiplexes both groups, the values are scaled by time_enabled / time_running.
+ */
+enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_BRANCHES,
+    PERF_BRANCH_MISSES,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_DTLB_MISSES,
+    PERF_EVENTS
+};
+
+#define CACHE_READ_MISS(cache) \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static struct {
+    const char * name;
+    uint32_t type;
+    uint64_t config;
+    int group;
+} const events[PERF_EVENTS] = {
+    {"cycles",          PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES,                   0},
+    {"instructions",    PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS,                 0},
+    {"branches",        PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS,          0},
+    {"branch-misses",   PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES,                0},
+    {"L1d-misses",      PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D),   1},
+    {"LLC-misses",      PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_LL),    1},
+    {"dTLB-misses",     PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB),  1},
+};
+
+static int fds[PERF_EVENTS] = {-1, -1, -1, -1, -1, -1, -1};
+static int leaders[2] = {-1, -1};
+
+static int perf_event_open(struct perf_event_attr * attr, int group_fd)
+{
+    return syscall(__NR_perf_event_open, attr, 0, -1, group_fd, 0);
+}
+
+int perf_open(void)
+{
+    int opened = 0;
+
+    for (int iter = 0; iter < PERF_EVENTS; iter++) {
+        struct perf_event_attr attr;
+        int group = events[iter].group;
+
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = events[iter].type;
+        attr.config = events[iter].config;
+        attr.disabled = (leaders[group] == -1);
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        fds[iter] = perf_event_open(&attr, leaders[group]);
+        if (fds[iter] == -1) {
+            fprintf(stderr, "WARNING: perf event '%s' not available\n", events[iter].name);
+            continue;
+        }
+
+        if (leaders[group] == -1) {
+            leaders[group] = fds[iter];
+        }
+        opened++;
+    }
+
+    if (opened == 0) {
+        perror("perf_event_open");
+        return -1;
+    }
+
+    return 0;
+}
+
+void perf_close(void)
+{
+    for (int iter = 0; iter < PERF_EVENTS; iter++) {
+        if (fds[iter] != -1) {
+            close(fds[iter]);
+            fds[iter] = -1;
+        }
+    }
+    leaders[0] = leaders[1] = -1;
+}
+
+void perf_reset(void)
+{
+    for (int group = 0; group < 2; group++) {
+        if (leaders[group] != -1) {
+            ioctl(leaders[group], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        }
+    }
+}
+
+void perf_enable(void)
+{
+    for (int group = 0; group < 2; group++) {
+        if (leaders[group] != -1) {
+            ioctl(leaders[group], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+    }
+}
+
+void perf_disable(void)
+{
+    for (int group = 0; group < 2; group++) {
+        if (leaders[group] != -1) {
+            ioctl(leaders[group], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        }
+    }
+}
+
+static uint64_t perf_read_event(int iter)
+{
+    uint64_t values[3] = {0};
+
+    if (fds[iter] == -1 || read(fds[iter], values, sizeof(values)) != sizeof(values)) {
+        return 0;
+    }
+
+    /* value, time_enabled, time_running */
+    if (values[2] == 0) {
+        return 0;
+    }
+    return (uint64_t)((double)values[0] * values[1] / values[2]);
+}
+
+void perf_read(struct perf_counters * counters)
+{
+    counters->cycles += perf_read_event(PERF_CYCLES);
+    counters->instructions += perf_read_event(PERF_INSTRUCTIONS);
+    counters->branches += perf_read_event(PERF_BRANCHES);
+    counters->branch_misses += perf_read_event(PERF_BRANCH_MISSES);
+    counters->l1d_misses += perf_read_event(PERF_L1D_MISSES);
+    counters->llc_misses += perf_read_event(PERF_LLC_MISSES);
+    counters->dtlb_misses += perf_read_event(PERF_DTLB_MISSES);
+}
+
+void perf_add(struct perf_counters * sum, const struct perf_counters * counters)
+{
+    sum->cycles += counters->cycles;
+    sum->instructions += counters->instructions;
+    sum->branches += counters->branches;
+    sum->branch_misses += counters->branch_misses;
+    sum->l1d_misses += counters->l1d_misses;
+    sum->llc_misses += counters->llc_misses;
+    sum->dtlb_misses += counters->dtlb_misses;
+    sum->scanned_kb += counters->scanned_kb;
+}
+
+void perf_get_metrics(const struct perf_counters * counters, struct perf_metrics * metrics)
+{
+    memset(metrics, 0, sizeof(*metrics));
+
+    if (counters->cycles) {
+        metrics->ipc = (double)counters->instructions / counters->cycles;
+    }
+    if (counters->branches) {
+        metrics->branch_miss_rate = (double)counters->branch_misses * 100 / counters->branches;
+    }
+    if (counters->scanned_kb > 0) {
+        metrics->l1d_per_kb = counters->l1d_misses / counters->scanned_kb;
+        metrics->llc_per_kb = counters->llc_misses / counters->scanned_kb;
+        metrics->dtlb_per_kb = counters->dtlb_misses / counters->scanned_kb;
+    }
+}
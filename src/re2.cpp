@@ -3,14 +3,37 @@
 
 #include "main.h"
 
+#include <iostream>
+#include <vector>
 #include <re2/re2.h>
 #include <re2/stringpiece.h>
 
-static void * get_re2_object(char* pattern)
+enum Re2Search {
+    RE2_CONSUME,    /* RE2::FindAndConsume() */
+    RE2_MATCH,      /* RE2::Match() from explicit start positions, only the match bounds */
+    RE2_LONGEST,    /* RE2::Match() with longest_match, leftmost-longest semantics */
+};
+
+/* 0 keeps the RE2 default budget */
+static int64_t re2_max_mem = 0;
+
+extern "C" void re2_set_max_mem(int64_t max_mem)
 {
+    re2_max_mem = max_mem;
+}
+
+static void * get_re2_object(const char* pattern, Re2Search search)
+{
+    RE2::Options options(regex_encoding == ENC_UTF8 ? RE2::DefaultOptions : RE2::Latin1);
     RE2 * obj;
 
-    obj = new RE2(pattern, RE2::Latin1);
+    options.set_longest_match(search == RE2_LONGEST);
+    options.set_case_sensitive(regex_caseless != CASE_NATIVE);
+    if (re2_max_mem > 0) {
+        options.set_max_mem(re2_max_mem);
+    }
+
+    obj = new RE2(pattern, options);
     if (!obj->ok()) {
         printf("pattern error!\n");
         delete obj;
@@ -24,11 +47,40 @@ static void free_re2_object(void* obj)
     delete (RE2*)obj;
 }
 
-static int search_all_re2(void* obj, char* subject, int subject_len)
+/* capture groups that took part in a match, unset groups have no data */
+static uint64_t count_groups(const re2::StringPiece * groups, int count)
+{
+    uint64_t set = 0;
+
+    for (int iter = 0; iter < count; iter++) {
+        set += groups[iter].data() != NULL;
+    }
+    return set;
+}
+
+/* captures is NULL unless the groups are extracted, FindAndConsumeN() then gets one argument per group */
+static uint64_t search_all_re2(void* obj, const char* subject, size_t subject_len, uint64_t * captures)
 {
     re2::StringPiece input(subject, subject_len);
     //re2::StringPiece result;
-    int found = 0;
+    uint64_t found = 0;
+
+    if (captures) {
+        int const count = ((RE2*)obj)->NumberOfCapturingGroups();
+        std::vector<re2::StringPiece> groups(count);
+        std::vector<RE2::Arg> args(count);
+        std::vector<const RE2::Arg *> arg_ptrs(count);
+
+        for (int iter = 0; iter < count; iter++) {
+            args[iter] = &groups[iter];
+            arg_ptrs[iter] = &args[iter];
+        }
+        while (RE2::FindAndConsumeN(&input, *(RE2*)obj, arg_ptrs.data(), count)) {
+            *captures += count_groups(groups.data(), count);
+            found++;
+        }
+        return found;
+    }
 
     while (RE2::FindAndConsume(&input, *(RE2*)obj)) {
         // printf("match: %d %d @%d\n", result.data() - subject, result.size(), input.data() - subject);
@@ -37,15 +89,57 @@ static int search_all_re2(void* obj, char* subject, int subject_len)
     return found;
 }
 
-extern "C" int re2_find_all(char* pattern, char* subject, int subject_len, int repeat, struct result * res)
+/* the whole subject stays the context of every search, so \b and ^ see the bytes before the start position */
+static uint64_t match_all_re2(void* obj, const char* subject, size_t subject_len, uint64_t * captures)
+{
+    re2::StringPiece input(subject, subject_len);
+    int const submatches = captures ? 1 + ((RE2*)obj)->NumberOfCapturingGroups() : 1;
+    std::vector<re2::StringPiece> match(submatches);
+    size_t pos = 0;
+    uint64_t found = 0;
+
+    while (pos <= subject_len && ((RE2*)obj)->Match(input, pos, subject_len, RE2::UNANCHORED, match.data(), submatches)) {
+        size_t const match_end = (match[0].data() - subject) + match[0].size();
+
+        if (captures) {
+            *captures += count_groups(match.data() + 1, submatches - 1);
+        }
+        found++;
+        pos = match[0].empty() ? match_end + 1 : match_end;
+    }
+    return found;
+}
+
+/* --is-match, RE2 stops at the first match without looking for its bounds */
+static uint64_t partial_match_re2(void* obj, const char* subject, size_t subject_len, UNUSED uint64_t * captures)
+{
+    return RE2::PartialMatch(re2::StringPiece(subject, subject_len), *(RE2*)obj);
+}
+
+/*
+ * RE2 falls back to the NFA when a DFA exceeds its share of max_mem. The
+ * search failure hook is called for every such fallback, it is process wide
+ * and the engines run one at a time.
+ */
+static uint64_t dfa_failures = 0;
+
+static void count_dfa_failure(UNUSED const re2::hooks::DFASearchFailure& failure)
+{
+    dfa_failures++;
+}
+
+static int re2_find_all_common(const char* name, const char* pattern, const char* subject, size_t subject_len,
+                               const struct blocks * blocks, Re2Search search, int repeat, struct result * res)
 {
     TIME_TYPE start, end = 0;
     double pre_times = 0;
     GET_TIME(start);
 
-    void * obj = get_re2_object(pattern);
-    
-    int found = 0;
+    void * obj = get_re2_object(pattern, search);
+
+    uint64_t found = 0;
+    uint64_t captures = 0;
+    uint64_t * const groups = regex_captures ? &captures : NULL;
 
     if (!obj) {
         printf("RE2 compilation failed\n");
@@ -55,19 +149,41 @@ extern "C" int re2_find_all(char* pattern, char* subject, int subject_len, int r
     GET_TIME(end);
     pre_times = TIME_DIFF_IN_MS(start, end);
 
+    uint64_t (*search_all)(void*, const char*, size_t, uint64_t*) = (search == RE2_CONSUME) ? search_all_re2 : match_all_re2;
+    if (regex_is_match) {
+        search_all = partial_match_re2;
+    }
     double * times = (double*) std::calloc(repeat, sizeof(double));
     int const times_len = repeat;
 
+    re2::hooks::DFASearchFailureCallback * const previous_hook = re2::hooks::GetDFASearchFailureHook();
+    dfa_failures = 0;
+    re2::hooks::SetDFASearchFailureHook(count_dfa_failure);
+
     do {
-        GET_TIME(start);
-        found = search_all_re2(obj, subject, subject_len);
-        GET_TIME(end);
+        START_SCAN_TIME(start);
+        captures = 0;
+        if (blocks) {
+            found = 0;
+            for (size_t iter = 0; iter < blocks->count; iter++) {
+                found += search_all(obj, blocks->data[iter], blocks->len[iter], groups);
+            }
+        } else {
+            found = search_all(obj, subject, subject_len, groups);
+        }
+        STOP_SCAN_TIME(end);
         times[repeat - 1] = TIME_DIFF_IN_MS(start, end);
 
     } while (--repeat > 0);
 
+    re2::hooks::SetDFASearchFailureHook(previous_hook);
+    if (dfa_failures > 0) {
+        fprintf(stdout, "[%10s] DFA out of memory in %" PRIu64 " searches per run, fell back to the NFA (max_mem: %" PRId64 ")\n",
+                name, (dfa_failures + times_len - 1) / times_len, ((RE2*)obj)->options().max_mem());
+    }
 
     res->matches = found;
+    res->captures = captures;
     get_mean_and_derivation(pre_times, times, times_len, res);
 
     free_re2_object(obj);
@@ -75,3 +191,33 @@ extern "C" int re2_find_all(char* pattern, char* subject, int subject_len, int r
 
     return 0;
 }
+
+extern "C" int re2_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res)
+{
+    return re2_find_all_common("re2", pattern, subject, subject_len, NULL, RE2_CONSUME, repeat, res);
+}
+
+extern "C" int re2_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res)
+{
+    return re2_find_all_common("re2", pattern, NULL, 0, blocks, RE2_CONSUME, repeat, res);
+}
+
+extern "C" int re2_match_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res)
+{
+    return re2_find_all_common("re2-match", pattern, subject, subject_len, NULL, RE2_MATCH, repeat, res);
+}
+
+extern "C" int re2_match_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res)
+{
+    return re2_find_all_common("re2-match", pattern, NULL, 0, blocks, RE2_MATCH, repeat, res);
+}
+
+extern "C" int re2_longest_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res)
+{
+    return re2_find_all_common("re2-longst", pattern, subject, subject_len, NULL, RE2_LONGEST, repeat, res);
+}
+
+extern "C" int re2_longest_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res)
+{
+    return re2_find_all_common("re2-longst", pattern, NULL, 0, blocks, RE2_LONGEST, repeat, res);
+}
@@ -0,0 +1,1004 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#include "regex_parser.hpp"
+
+namespace {
+
+class Parser {
+ public:
+    explicit Parser(const std::string& pat) : pattern(pat) {}
+
+    bool parse(RegexNode * root, std::string * error);
+
+ private:
+    bool parseAlternation(RegexNode * node);
+    bool parseConcat(RegexNode * node);
+    bool parseAtom(RegexNode * node, bool * has_node);
+    bool parseGroup(RegexNode * node, bool * has_node);
+    bool parseQuantifier(RegexNode * node);
+    bool parseBound(int * min, int * max);
+    bool parseClass(RegexNode * node);
+    bool parseEscape(std::bitset<256> * chars, bool in_class, char * assertion);
+    void applyCaseless(std::bitset<256> * chars) const;
+    bool fail(const char * message);
+
+    bool eof() const { return pos >= pattern.size(); }
+    char peek() const { return pattern[pos]; }
+
+    const std::string& pattern;
+    size_t pos = 0;
+    bool caseless = false;
+    std::string err;
+};
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static void set_range(std::bitset<256> * chars, int first, int last)
+{
+    for (int c = first; c <= last; c++) {
+        chars->set(c);
+    }
+}
+
+static void set_word(std::bitset<256> * chars)
+{
+    set_range(chars, 'a', 'z');
+    set_range(chars, 'A', 'Z');
+    set_range(chars, '0', '9');
+    chars->set('_');
+}
+
+static void set_space(std::bitset<256> * chars)
+{
+    chars->set(' ');
+    set_range(chars, '\t', '\r');
+}
+
+static bool set_posix_class(std::bitset<256> * chars, const std::string& name)
+{
+    for (int c = 0; c < 128; c++) {
+        bool member;
+
+        if (name == "alpha")        member = isalpha(c);
+        else if (name == "digit")   member = isdigit(c);
+        else if (name == "alnum")   member = isalnum(c);
+        else if (name == "upper")   member = isupper(c);
+        else if (name == "lower")   member = islower(c);
+        else if (name == "space")   member = isspace(c);
+        else if (name == "punct")   member = ispunct(c);
+        else if (name == "xdigit")  member = isxdigit(c);
+        else if (name == "print")   member = isprint(c);
+        else if (name == "cntrl")   member = iscntrl(c);
+        else if (name == "word")    member = isalnum(c) || c == '_';
+        else return false;
+
+        if (member) {
+            chars->set(c);
+        }
+    }
+    return true;
+}
+
+bool Parser::fail(const char * message)
+{
+    if (err.empty()) {
+        err = std::string(message) + " at offset " + std::to_string(pos);
+    }
+    return false;
+}
+
+void Parser::applyCaseless(std::bitset<256> * chars) const
+{
+    if (!caseless) {
+        return;
+    }
+
+    for (int c = 'a'; c <= 'z'; c++) {
+        if (chars->test(c) || chars->test(c - 'a' + 'A')) {
+            chars->set(c);
+            chars->set(c - 'a' + 'A');
+        }
+    }
+}
+
+bool Parser::parse(RegexNode * root, std::string * error)
+{
+    if (!parseAlternation(root) || (!eof() && !fail("unmatched ')'"))) {
+        if (error) {
+            *error = err;
+        }
+        return false;
+    }
+    return true;
+}
+
+bool Parser::parseAlternation(RegexNode * node)
+{
+    RegexNode branch;
+
+    if (!parseConcat(&branch)) {
+        return false;
+    }
+
+    if (eof() || peek() != '|') {
+        *node = std::move(branch);
+        return true;
+    }
+
+    node->type = RegexNode::ALTERNATION;
+    node->children.push_back(std::move(branch));
+
+    while (!eof() && peek() == '|') {
+        pos++;
+        RegexNode next;
+        if (!parseConcat(&next)) {
+            return false;
+        }
+        node->children.push_back(std::move(next));
+    }
+
+    return true;
+}
+
+bool Parser::parseConcat(RegexNode * node)
+{
+    node->type = RegexNode::CONCAT;
+
+    while (!eof() && peek() != '|' && peek() != ')') {
+        RegexNode atom;
+        bool has_node = true;
+
+        if (!parseAtom(&atom, &has_node)) {
+            return false;
+        }
+        if (!has_node) {
+            continue;
+        }
+        if (!parseQuantifier(&atom)) {
+            return false;
+        }
+        node->children.push_back(std::move(atom));
+    }
+
+    if (node->children.empty()) {
+        node->type = RegexNode::EMPTY;
+    } else if (node->children.size() == 1) {
+        RegexNode single = std::move(node->children[0]);
+        *node = std::move(single);
+    }
+
+    return true;
+}
+
+bool Parser::parseGroup(RegexNode * node, bool * has_node)
+{
+    bool const saved_caseless = caseless;
+
+    /* pos is behind '(' */
+    if (!eof() && peek() == '?') {
+        pos++;
+        if (eof()) {
+            return fail("incomplete group");
+        }
+
+        char c = peek();
+        if (c == '=' || c == '!' || (c == '<' && pos + 1 < pattern.size() &&
+                                     (pattern[pos + 1] == '=' || pattern[pos + 1] == '!'))) {
+            return fail("lookaround not supported");
+        }
+
+        if (c == ':' || c == '>' || c == '|') {
+            if (c == '|') {
+                return fail("branch reset not supported");
+            }
+            pos++;
+        } else if (c == '<' || c == '\'' || (c == 'P' && pos + 1 < pattern.size() && pattern[pos + 1] == '<')) {
+            /* named capture group */
+            size_t end = pattern.find_first_of(">'", pos + 1);
+            if (end == std::string::npos) {
+                return fail("incomplete group name");
+            }
+            pos = end + 1;
+        } else {
+            /* inline flags: (?i) (?-i) (?i:...) */
+            bool negate = false;
+
+            while (!eof() && peek() != ')' && peek() != ':') {
+                switch (peek()) {
+                    case '-': negate = true; break;
+                    case 'i': caseless = !negate; break;
+                    case 'm': case 's': case 'x': case 'U': break;
+                    default: return fail("unsupported group");
+                }
+                pos++;
+            }
+
+            if (eof()) {
+                return fail("incomplete group");
+            }
+
+            if (peek() == ')') {
+                /* flags stay active until the end of the enclosing group */
+                pos++;
+                *has_node = false;
+                return true;
+            }
+            pos++;
+        }
+    }
+
+    if (!parseAlternation(node)) {
+        return false;
+    }
+
+    if (eof() || peek() != ')') {
+        return fail("missing ')'");
+    }
+    pos++;
+
+    caseless = saved_caseless;
+    return true;
+}
+
+bool Parser::parseAtom(RegexNode * node, bool * has_node)
+{
+    char c = peek();
+    pos++;
+
+    switch (c) {
+        case '(':
+            return parseGroup(node, has_node);
+        case '[':
+            return parseClass(node);
+        case '.':
+            node->type = RegexNode::CLASS;
+            node->chars.set();
+            node->chars.reset('\n');
+            return true;
+        case '^':
+        case '$':
+            node->type = RegexNode::ASSERT;
+            node->assertion = c;
+            return true;
+        case '*':
+        case '+':
+        case '?':
+            return fail("nothing to repeat");
+        case '\\': {
+            char assertion = 0;
+
+            if (!parseEscape(&node->chars, false, &assertion)) {
+                return false;
+            }
+            if (assertion) {
+                node->type = RegexNode::ASSERT;
+                node->assertion = assertion;
+            } else {
+                node->type = RegexNode::CLASS;
+                applyCaseless(&node->chars);
+            }
+            return true;
+        }
+        default:
+            node->type = RegexNode::CLASS;
+            node->chars.set((unsigned char)c);
+            applyCaseless(&node->chars);
+            return true;
+    }
+}
+
+bool Parser::parseEscape(std::bitset<256> * chars, bool in_class, char * assertion)
+{
+    if (eof()) {
+        return fail("trailing '\\'");
+    }
+
+    char c = peek();
+    pos++;
+
+    switch (c) {
+        case 'd': set_range(chars, '0', '9'); return true;
+        case 'D': set_range(chars, '0', '9'); chars->flip(); return true;
+        case 'w': set_word(chars); return true;
+        case 'W': set_word(chars); chars->flip(); return true;
+        case 's': set_space(chars); return true;
+        case 'S': set_space(chars); chars->flip(); return true;
+        case 'h': chars->set(' '); chars->set('\t'); return true;
+        case 't': chars->set('\t'); return true;
+        case 'n': chars->set('\n'); return true;
+        case 'r': chars->set('\r'); return true;
+        case 'f': chars->set('\f'); return true;
+        case 'v': chars->set('\v'); return true;
+        case 'e': chars->set(0x1b); return true;
+        case 'a': chars->set(0x07); return true;
+        case 'x': {
+            int value = 0;
+
+            if (!eof() && peek() == '{') {
+                size_t end = pattern.find('}', pos);
+                if (end == std::string::npos) {
+                    return fail("incomplete \\x{}");
+                }
+                for (size_t iter = pos + 1; iter < end; iter++) {
+                    if (hex_value(pattern[iter]) < 0) {
+                        return fail("invalid \\x{}");
+                    }
+                    value = value * 16 + hex_value(pattern[iter]);
+                }
+                pos = end + 1;
+            } else {
+                for (int digits = 0; digits < 2 && !eof() && hex_value(peek()) >= 0; digits++) {
+                    value = value * 16 + hex_value(peek());
+                    pos++;
+                }
+            }
+
+            if (value > 255) {
+                return fail("code point above 0xff not supported");
+            }
+            chars->set(value);
+            return true;
+        }
+        case '0': {
+            int value = 0;
+            for (int digits = 0; digits < 2 && !eof() && peek() >= '0' && peek() <= '7'; digits++) {
+                value = value * 8 + (peek() - '0');
+                pos++;
+            }
+            chars->set(value);
+            return true;
+        }
+        case 'c':
+            if (eof()) {
+                return fail("incomplete \\c");
+            }
+            chars->set(toupper(peek()) ^ 0x40);
+            pos++;
+            return true;
+        case 'b':
+            if (in_class) {
+                chars->set('\b');
+                return true;
+            }
+            *assertion = 'b';
+            return true;
+        case 'B':
+        case 'A':
+        case 'z':
+        case 'Z':
+        case 'G':
+            if (in_class) {
+                return fail("invalid escape in class");
+            }
+            *assertion = (c == 'B') ? 'B' : (c == 'A' || c == 'G') ? '^' : '$';
+            return true;
+        default:
+            if (isalnum((unsigned char)c)) {
+                /* backreferences, \p{..}, \Q..\E, \K, ... */
+                pos--;
+                return fail("unsupported escape");
+            }
+            chars->set((unsigned char)c);
+            return true;
+    }
+}
+
+bool Parser::parseClass(RegexNode * node)
+{
+    bool negate = false;
+    bool first = true;
+
+    node->type = RegexNode::CLASS;
+
+    if (!eof() && peek() == '^') {
+        negate = true;
+        pos++;
+    }
+
+    while (!eof() && (peek() != ']' || first)) {
+        std::bitset<256> item;
+        int low = -1;
+
+        first = false;
+
+        if (peek() == '[' && pos + 1 < pattern.size() && pattern[pos + 1] == ':') {
+            size_t end = pattern.find(":]", pos + 2);
+            if (end == std::string::npos || !set_posix_class(&item, pattern.substr(pos + 2, end - pos - 2))) {
+                return fail("unsupported posix class");
+            }
+            pos = end + 2;
+        } else if (peek() == '\\') {
+            pos++;
+            if (!parseEscape(&item, true, NULL)) {
+                return false;
+            }
+        } else {
+            item.set((unsigned char)peek());
+            pos++;
+        }
+
+        if (item.count() == 1) {
+            for (int c = 0; c < 256; c++) {
+                if (item.test(c)) {
+                    low = c;
+                    break;
+                }
+            }
+        }
+
+        /* range a-z, a '-' in front of ']' is a literal */
+        if (low >= 0 && pos + 1 < pattern.size() && peek() == '-' && pattern[pos + 1] != ']') {
+            std::bitset<256> upper;
+            int high = -1;
+
+            pos++;
+            if (peek() == '\\') {
+                pos++;
+                if (!parseEscape(&upper, true, NULL)) {
+                    return false;
+                }
+            } else {
+                upper.set((unsigned char)peek());
+                pos++;
+            }
+
+            for (int c = 255; c >= 0; c--) {
+                if (upper.test(c)) {
+                    high = c;
+                    break;
+                }
+            }
+
+            if (upper.count() != 1 || high < low) {
+                return fail("invalid range in class");
+            }
+            set_range(&item, low, high);
+        }
+
+        node->chars |= item;
+    }
+
+    if (eof()) {
+        return fail("missing ']'");
+    }
+    pos++;
+
+    applyCaseless(&node->chars);
+    if (negate) {
+        node->chars.flip();
+    }
+
+    return true;
+}
+
+bool Parser::parseBound(int * min, int * max)
+{
+    size_t end = pattern.find('}', pos);
+    if (end == std::string::npos) {
+        return false;
+    }
+
+    std::string bound = pattern.substr(pos + 1, end - pos - 1);
+    size_t comma = bound.find(',');
+    std::string low = bound.substr(0, comma);
+
+    if (low.empty() || low.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    *min = atoi(low.c_str());
+    *max = *min;
+
+    if (comma != std::string::npos) {
+        std::string high = bound.substr(comma + 1);
+        if (high.find_first_not_of("0123456789") != std::string::npos) {
+            return false;
+        }
+        *max = high.empty() ? -1 : atoi(high.c_str());
+        if (*max != -1 && *max < *min) {
+            return false;
+        }
+    }
+
+    pos = end + 1;
+    return true;
+}
+
+bool Parser::parseQuantifier(RegexNode * node)
+{
+    while (!eof()) {
+        int min, max;
+        char c = peek();
+
+        if (c == '*') {
+            min = 0; max = -1; pos++;
+        } else if (c == '+') {
+            min = 1; max = -1; pos++;
+        } else if (c == '?') {
+            min = 0; max = 1; pos++;
+        } else if (c == '{' && parseBound(&min, &max)) {
+            /* parseBound consumed the quantifier, a malformed one is a literal '{' */
+        } else {
+            break;
+        }
+
+        if (node->type == RegexNode::ASSERT) {
+            return fail("quantifier on assertion");
+        }
+
+        RegexNode repeat;
+        repeat.type = RegexNode::REPEAT;
+        repeat.min = min;
+        repeat.max = max;
+        repeat.children.push_back(std::move(*node));
+        *node = std::move(repeat);
+
+        /* lazy and possessive modifiers do not change the language */
+        if (!eof() && (peek() == '?' || peek() == '+')) {
+            pos++;
+        }
+    }
+
+    return true;
+}
+
+/* appends the bytes of a fixed string, letters that match both cases are stored in lower case */
+static bool append_literal(const RegexNode& node, std::string * literal, int * caseless, int * exact)
+{
+    switch (node.type) {
+        case RegexNode::EMPTY:
+            return true;
+
+        case RegexNode::CLASS: {
+            size_t const count = node.chars.count();
+            int c = 0;
+
+            /* an empty class like [^\s\S] never matches */
+            if (count == 0) {
+                return false;
+            }
+            while (!node.chars.test(c)) {
+                c++;
+            }
+            if (count == 1) {
+                if (isalpha(c)) {
+                    (*exact)++;
+                }
+                literal->push_back((char)c);
+                return true;
+            }
+            if (count == 2 && isupper(c) && node.chars.test(tolower(c))) {
+                (*caseless)++;
+                literal->push_back((char)tolower(c));
+                return true;
+            }
+            return false;
+        }
+
+        case RegexNode::CONCAT:
+            for (const auto& child : node.children) {
+                if (!append_literal(child, literal, caseless, exact)) {
+                    return false;
+                }
+            }
+            return true;
+
+        case RegexNode::ALTERNATION:
+            return node.children.size() == 1 && append_literal(node.children[0], literal, caseless, exact);
+
+        case RegexNode::REPEAT:
+            if (node.min != node.max) {
+                return false;
+            }
+            for (int iter = 0; iter < node.min; iter++) {
+                if (!append_literal(node.children[0], literal, caseless, exact)) {
+                    return false;
+                }
+            }
+            return true;
+
+        case RegexNode::ASSERT:
+            return false;
+    }
+
+    return false;
+}
+
+/*
+ * Case folding of the pattern text for lowercased input: only literal letters
+ * and class members are lowered, escapes, group syntax, flags and verbs are
+ * copied as written, so every other construct keeps its meaning.
+ */
+class Folder {
+public:
+    explicit Folder(const std::string& pattern) : pattern(pattern) {}
+
+    bool fold(std::string * out, std::string * error);
+
+private:
+    bool escape(std::string * out, int * value, bool lower);
+    bool groupHeader(std::string * out);
+    bool cls(std::string * out);
+    bool atom(std::string * text, int * value);
+    bool copyTo(char closer, std::string * out);
+
+    const std::string& pattern;
+    size_t pos = 0;
+    std::string err;
+};
+
+/* copies up to and including closer */
+bool Folder::copyTo(char closer, std::string * out)
+{
+    size_t const end = pattern.find(closer, pos);
+
+    if (end == std::string::npos) {
+        err = std::string("missing '") + closer + "'";
+        return false;
+    }
+    out->append(pattern, pos, end + 1 - pos);
+    pos = end + 1;
+    return true;
+}
+
+/*
+ * pos is on the backslash. Escapes are copied as written, except \xHH and
+ * \x{HH} of an upper case letter when lower is set. value is the byte of a
+ * single character escape (for class ranges), -1 otherwise.
+ */
+bool Folder::escape(std::string * out, int * value, bool lower)
+{
+    *value = -1;
+    if (pos + 1 >= pattern.size()) {
+        err = "trailing backslash";
+        return false;
+    }
+
+    char const c = pattern[pos + 1];
+    if (c == 'x') {
+        size_t start = pos + 2;
+        size_t end = start;
+        bool const braces = start < pattern.size() && pattern[start] == '{';
+
+        if (braces) {
+            end = pattern.find('}', start);
+            if (end == std::string::npos) {
+                err = "missing '}'";
+                return false;
+            }
+            start++;
+        } else {
+            while (end < pattern.size() && end < start + 2 && hex_value(pattern[end]) >= 0) {
+                end++;
+            }
+        }
+
+        int byte = 0;
+        for (size_t iter = start; iter < end; iter++) {
+            if (hex_value(pattern[iter]) < 0 || byte > 0xff) {
+                err = "invalid \\x escape";
+                return false;
+            }
+            byte = byte * 16 + hex_value(pattern[iter]);
+        }
+        if (byte > 0xff) {
+            err = "invalid \\x escape";
+            return false;
+        }
+        pos = braces ? end + 1 : end;
+        if (lower && byte >= 'A' && byte <= 'Z') {
+            byte = tolower(byte);
+        }
+
+        char hex[8];
+        snprintf(hex, sizeof(hex), "\\x%02x", byte);
+        out->append(hex);
+        *value = byte;
+        return true;
+    }
+
+    static const char controls[] = "t\tn\nr\rf\fv\va\ae\x1b";
+    out->append(pattern, pos, 2);
+    pos += 2;
+    if (strchr("pPgkNo", c) && pos < pattern.size()) {
+        /* \p{..} \pL \g{..} \g1 \k<..> \N{..} \o{..} */
+        char const next = pattern[pos];
+        if (next == '{') {
+            return copyTo('}', out);
+        } else if (next == '<') {
+            return copyTo('>', out);
+        } else if (next == '\'') {
+            pos++;
+            out->push_back(next);
+            return copyTo('\'', out);
+        } else if (c == 'p' || c == 'P') {
+            out->push_back(next);
+            pos++;
+        }
+    } else if (c == 'c' && pos < pattern.size()) {
+        out->push_back(pattern[pos++]);
+    } else if (!isalnum((unsigned char)c)) {
+        *value = (unsigned char)c;
+    } else if (const char * control = strchr(controls, c)) {
+        if ((control - controls) % 2 == 0) {
+            *value = (unsigned char)control[1];
+        }
+    }
+    return true;
+}
+
+/* pos is behind "(?", copies the group syntax up to its body */
+bool Folder::groupHeader(std::string * out)
+{
+    if (pos >= pattern.size()) {
+        err = "incomplete group";
+        return false;
+    }
+
+    char const c = pattern[pos];
+    char const next = (pos + 1 < pattern.size()) ? pattern[pos + 1] : 0;
+
+    if (strchr("=!:>|", c)) {
+        out->push_back(c);
+        pos++;
+    } else if (c == '<' && (next == '=' || next == '!')) {
+        out->append(pattern, pos, 2);
+        pos += 2;
+    } else if (c == '<' || (c == 'P' && next == '<')) {
+        return copyTo('>', out);
+    } else if (c == '\'') {
+        out->push_back(c);
+        pos++;
+        return copyTo('\'', out);
+    } else if (c == '#' || c == 'P' || c == '&' || c == 'R' || c == 'C' || c == '+' || isdigit((unsigned char)c)
+               || (c == '-' && isdigit((unsigned char)next))) {
+        /* comments, back references, recursion and callouts */
+        return copyTo(')', out);
+    } else {
+        /* flags, (?i) (?-i) (?i:...) */
+        while (pos < pattern.size() && pattern[pos] != ':' && pattern[pos] != ')') {
+            out->push_back(pattern[pos++]);
+        }
+        if (pos >= pattern.size()) {
+            err = "incomplete group";
+            return false;
+        }
+        out->push_back(pattern[pos++]);
+    }
+    return true;
+}
+
+/*
+ * pos is behind '['. Letters are lowered, a range over upper case letters
+ * gets the lower case part added, e.g. [0-Z] becomes [0-Za-z]. A class of
+ * one letter in both cases becomes the letter, e.g. [sS] becomes s.
+ */
+bool Folder::cls(std::string * out)
+{
+    std::string body;
+    bool const negate = pos < pattern.size() && pattern[pos] == '^';
+    bool single = true;         /* body only holds one letter */
+    int letter = -1;
+
+    if (negate) {
+        pos++;
+    }
+
+    for (bool first = true; ; first = false) {
+        if (pos >= pattern.size()) {
+            err = "missing ']'";
+            return false;
+        }
+        if (pattern[pos] == ']' && !first) {
+            pos++;
+            break;
+        }
+        if (pattern.compare(pos, 2, "[:") == 0) {
+            single = false;
+            if (!copyTo(']', &body)) {
+                return false;
+            }
+            continue;
+        }
+
+        std::string lo_text;
+        int lo;
+        if (!atom(&lo_text, &lo)) {
+            return false;
+        }
+
+        if (pos + 1 < pattern.size() && pattern[pos] == '-' && pattern[pos + 1] != ']') {
+            std::string hi_text;
+            int hi;
+
+            pos++;
+            if (!atom(&hi_text, &hi)) {
+                return false;
+            }
+            single = false;
+            body.append(lo_text).append("-").append(hi_text);
+            if (lo >= 0 && hi >= 0 && lo <= 'Z' && hi >= 'A') {
+                body.push_back((char)tolower(std::max(lo, (int)'A')));
+                body.push_back('-');
+                body.push_back((char)tolower(std::min(hi, (int)'Z')));
+            }
+            continue;
+        }
+
+        if (lo >= 'A' && lo <= 'Z') {
+            body.push_back((char)tolower(lo));
+        } else {
+            body.append(lo_text);
+        }
+        if (lo < 0 || !isalpha(lo) || (letter >= 0 && letter != tolower(lo))) {
+            single = false;
+        } else {
+            letter = tolower(lo);
+        }
+    }
+
+    if (single && !negate && letter >= 0) {
+        out->push_back((char)letter);
+    } else {
+        out->append(negate ? "[^" : "[");
+        out->append(body);
+        out->push_back(']');
+    }
+    return true;
+}
+
+/* one member of a class as written, value is its byte or -1 for \d, \p{..} and the like */
+bool Folder::atom(std::string * text, int * value)
+{
+    if (pattern[pos] == '\\') {
+        return escape(text, value, false);
+    }
+    *value = (unsigned char)pattern[pos];
+    text->push_back(pattern[pos++]);
+    return true;
+}
+
+bool Folder::fold(std::string * out, std::string * error)
+{
+    bool quoted = false;
+
+    out->clear();
+    while (pos < pattern.size()) {
+        char const c = pattern[pos];
+
+        if (quoted) {
+            if (pattern.compare(pos, 2, "\\E") == 0) {
+                out->append("\\E");
+                pos += 2;
+                quoted = false;
+            } else {
+                out->push_back((char)tolower((unsigned char)c));
+                pos++;
+            }
+            continue;
+        }
+
+        bool ok = true;
+        int value;
+        if (c == '\\') {
+            quoted = pattern.compare(pos, 2, "\\Q") == 0;
+            ok = escape(out, &value, true);
+        } else if (c == '[') {
+            pos++;
+            ok = cls(out);
+        } else if (pattern.compare(pos, 2, "(?") == 0) {
+            out->append("(?");
+            pos += 2;
+            ok = groupHeader(out);
+        } else if (pattern.compare(pos, 2, "(*") == 0) {
+            /* verbs like (*UTF) */
+            ok = copyTo(')', out);
+        } else {
+            out->push_back((char)tolower((unsigned char)c));
+            pos++;
+        }
+
+        if (!ok) {
+            if (error) {
+                *error = err;
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+bool regex_fold_pattern(const std::string& pattern, std::string * folded, std::string * error)
+{
+    Folder folder(pattern);
+    return folder.fold(folded, error);
+}
+
+int regex_case_pairs(const RegexNode& root)
+{
+    int pairs = 0;
+
+    if (root.type == RegexNode::CLASS && root.chars.count() == 2) {
+        for (int c = 'A'; c <= 'Z'; c++) {
+            pairs += root.chars.test(c) && root.chars.test(tolower(c));
+        }
+    }
+
+    for (const auto& child : root.children) {
+        pairs += regex_case_pairs(child);
+    }
+    return pairs;
+}
+
+/* adds the bytes a match of node can start with to chars, returns true if node can match the empty string */
+static bool add_first_chars(const RegexNode& node, std::bitset<256> * chars)
+{
+    switch (node.type) {
+        case RegexNode::CLASS:
+            *chars |= node.chars;
+            return false;
+        case RegexNode::CONCAT:
+            for (const auto& child : node.children) {
+                if (!add_first_chars(child, chars)) {
+                    return false;
+                }
+            }
+            return true;
+        case RegexNode::ALTERNATION: {
+            bool nullable = node.children.empty();
+            for (const auto& child : node.children) {
+                nullable = add_first_chars(child, chars) || nullable;
+            }
+            return nullable;
+        }
+        case RegexNode::REPEAT:
+            if (node.max == 0) {
+                return true;
+            }
+            return add_first_chars(node.children[0], chars) || node.min == 0;
+        default:
+            return true;
+    }
+}
+
+bool regex_first_chars(const RegexNode& root, std::bitset<256> * chars)
+{
+    chars->reset();
+    return !add_first_chars(root, chars);
+}
+
+bool regex_literal(const RegexNode& root, std::string * literal, bool * caseless)
+{
+    int caseless_letters = 0;
+    int exact_letters = 0;
+
+    literal->clear();
+    if (!append_literal(root, literal, &caseless_letters, &exact_letters) || literal->empty()) {
+        return false;
+    }
+
+    /* a literal is either matched case sensitive or caseless as a whole */
+    if (caseless_letters > 0 && exact_letters > 0) {
+        return false;
+    }
+
+    *caseless = caseless_letters > 0;
+    return true;
+}
+
+bool regex_parse(const std::string& pattern, RegexNode * root, std::string * error)
+{
+    Parser parser(pattern);
+    *root = RegexNode();
+    return parser.parse(root, error);
+}
@@ -0,0 +1,57 @@
+#ifndef REGEX_PARSER_HPP
+#define REGEX_PARSER_HPP
+
+#include <bitset>
+#include <string>
+#include <vector>
+
+/*
+ * Minimal parser for the PCRE-like syntax of the rule sets. It covers literals,
+ * escapes, classes, groups, alternations, quantifiers, anchors and the (?i)
+ * flag. Backreferences, lookarounds, unicode properties and other extensions
+ * are reported as unsupported.
+ */
+struct RegexNode {
+    enum Type {
+        EMPTY,
+        CLASS,          /* one byte out of chars */
+        CONCAT,
+        ALTERNATION,
+        REPEAT,         /* children[0] {min, max}, max == -1 is unbounded */
+        ASSERT,         /* zero width: '^', '$', 'b' (word boundary), 'B' */
+    };
+
+    Type type = EMPTY;
+    std::bitset<256> chars;
+    std::vector<RegexNode> children;
+    int min = 0;
+    int max = 0;
+    char assertion = 0;
+};
+
+bool regex_parse(const std::string& pattern, RegexNode * root, std::string * error);
+
+/*
+ * Returns true if the expression matches exactly one fixed string (ignoring case
+ * if *caseless is set), e.g. abc, a\.b{2} or (?i)abc, and stores it in literal.
+ */
+bool regex_literal(const RegexNode& root, std::string * literal, bool * caseless);
+
+/*
+ * Rewrites the pattern text for input that was lowercased: literal letters,
+ * \Q...\E text and class members are lowered, ranges over upper case letters
+ * get their lower case part added. Escapes, anchors, quantifiers, group syntax
+ * and flags are copied as written. Returns false for text it cannot split.
+ */
+bool regex_fold_pattern(const std::string& pattern, std::string * folded, std::string * error);
+
+/*
+ * Stores the bytes a match can start with in chars, anchors and word boundaries
+ * are ignored. Returns false if the expression can match the empty string.
+ */
+bool regex_first_chars(const RegexNode& root, std::bitset<256> * chars);
+
+/* number of classes that only hold both cases of one letter, e.g. [sS] or a letter under (?i) */
+int regex_case_pairs(const RegexNode& root);
+
+#endif // REGEX_PARSER_HPP
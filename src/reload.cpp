@@ -0,0 +1,281 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <thread>
+
+#include "hyperscan_new.hpp"
+#include "reload.hpp"
+#include "util.hpp"
+
+/* the scanners check for a new snapshot between two chunks */
+#define RELOAD_CHUNK        (64 * 1024)
+#define RELOAD_SAMPLE_MS    1
+
+namespace {
+
+using modsecurity::Utils::HyperscanPm;
+
+/* one cache line per scanner thread */
+struct Counter {
+    std::atomic<uint64_t> bytes;
+    char pad[64 - sizeof(std::atomic<uint64_t>)];
+};
+
+static void scanLoop(HyperscanPm * pm, const char * data, size_t len, Counter * counter,
+                     const std::atomic<bool> * stop, std::atomic<bool> * failed)
+{
+    HyperscanPm::Reader reader(pm);
+
+    for (size_t pos = 0; !stop->load(std::memory_order_relaxed); ) {
+        size_t const chunk = std::min((size_t)RELOAD_CHUNK, len - pos);
+
+        if (reader.search(data + pos, chunk, NULL, NULL) < 0) {
+            failed->store(true);
+            break;
+        }
+        counter->bytes.fetch_add(chunk, std::memory_order_relaxed);
+        pos += chunk;
+        if (pos >= len) {
+            pos = 0;
+        }
+    }
+}
+
+static void sampleLoop(const Counter * counters, unsigned int threads, const Clock::time_point& start,
+                       const std::atomic<bool> * stop, std::vector<ReloadSample> * samples)
+{
+    while (!stop->load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(RELOAD_SAMPLE_MS));
+
+        uint64_t bytes = 0;
+        for (unsigned int iter = 0; iter < threads; iter++) {
+            bytes += counters[iter].bytes.load(std::memory_order_relaxed);
+        }
+        samples->push_back({since(start), bytes});
+    }
+}
+
+static bool compileAll(const std::vector<std::string>& rules, HyperscanPm * pm, unsigned int partitions, double * time)
+{
+    std::string error;
+    unsigned int id;
+
+    for (const auto& rule : rules) {
+        if (!pm->addPattern(rule.c_str(), rule.size(), &id, &error)) {
+            fprintf(stderr, "ERROR: %s\n", error.c_str());
+            return false;
+        }
+    }
+
+    Clock::time_point const start = Clock::now();
+    if (!pm->compile(&error, partitions)) {
+        fprintf(stderr, "ERROR: Unable to compile patterns: '%s'\n", error.c_str());
+        return false;
+    }
+    *time = since(start);
+    return true;
+}
+
+/* throughput of the samples overlapping [from, to], the samples are marked busy */
+static double rateDuring(const std::vector<ReloadSample>& samples, double from, double to, std::vector<bool> * busy)
+{
+    uint64_t bytes = 0;
+    double time = 0;
+
+    for (size_t iter = 1; iter < samples.size(); iter++) {
+        if (samples[iter].time < from || samples[iter - 1].time > to) {
+            continue;
+        }
+        bytes += samples[iter].bytes - samples[iter - 1].bytes;
+        time += samples[iter].time - samples[iter - 1].time;
+        (*busy)[iter] = true;
+    }
+    return time > 0 ? bytes / (time * 1000.0) : 0;
+}
+
+}  // namespace
+
+bool reload_parse_options(const char * spec, ReloadOptions * opts)
+{
+    return parse_options(spec, [opts](const std::string& key, const std::string& value) {
+        if (key == "threads") {
+            opts->threads = atoi(value.c_str());
+            if (opts->threads == 0 || opts->threads >= HyperscanPm::kMaxReaders) {
+                fprintf(stderr, "Invalid number of scanner threads '%s'\n", value.c_str());
+                return false;
+            }
+        } else if (key == "partitions") {
+            opts->partitions = atoi(value.c_str());
+            if (opts->partitions == 0) {
+                fprintf(stderr, "Invalid number of partitions '%s'\n", value.c_str());
+                return false;
+            }
+        } else if (key == "updates") {
+            opts->updates = atoi(value.c_str());
+        } else if (key == "interval") {
+            opts->interval = atof(value.c_str());
+        } else if (key == "seed") {
+            opts->seed = strtoull(value.c_str(), NULL, 0);
+        } else {
+            fprintf(stderr, "Unknown reload option '%s'\n", key.c_str());
+            return false;
+        }
+        return true;
+    });
+}
+
+const char * reload_op_name(ReloadUpdate::Op op)
+{
+    switch (op) {
+        case ReloadUpdate::REMOVE:  return "remove";
+        case ReloadUpdate::ADD:     return "add";
+        default:                    return "modify";
+    }
+}
+
+bool reload_run(const std::vector<std::string>& rules, const char * data, size_t len, const ReloadOptions& opts,
+                ReloadResult * result)
+{
+    *result = ReloadResult();
+    if (rules.empty() || len == 0) {
+        return false;
+    }
+
+    /* the reference: every update recompiles all rules */
+    {
+        HyperscanPm full;
+        if (!compileAll(rules, &full, 1, &result->full_compile)) {
+            return false;
+        }
+    }
+
+    HyperscanPm pm;
+    if (!compileAll(rules, &pm, opts.partitions, &result->partitioned_compile)) {
+        return false;
+    }
+
+    std::unique_ptr<Counter[]> counters(new Counter[opts.threads]);
+    std::vector<std::thread> scanners;
+    std::atomic<bool> stop(false);
+    std::atomic<bool> stop_sampler(false);
+    std::atomic<bool> failed(false);
+
+    for (unsigned int iter = 0; iter < opts.threads; iter++) {
+        counters[iter].bytes.store(0);
+    }
+
+    Clock::time_point const start = Clock::now();
+    result->samples.push_back({0, 0});
+    for (unsigned int iter = 0; iter < opts.threads; iter++) {
+        scanners.emplace_back(scanLoop, &pm, data, len, &counters[iter], &stop, &failed);
+    }
+    std::thread sampler(sampleLoop, counters.get(), opts.threads, start, &stop_sampler, &result->samples);
+
+    /* remove a rule, add it back under a new id, modify another rule with its own text */
+    std::mt19937_64 rng(opts.seed);
+    std::vector<unsigned int> pattern_id(rules.size());
+    std::vector<bool> live(rules.size(), true);
+    size_t removed = rules.size();
+
+    for (size_t iter = 0; iter < rules.size(); iter++) {
+        pattern_id[iter] = iter;
+    }
+
+    for (unsigned int iter = 0; iter < opts.updates && !failed; iter++) {
+        std::this_thread::sleep_until(start + std::chrono::duration<double, std::milli>(opts.interval * (iter + 1)));
+
+        ReloadUpdate update = {};
+        std::string error;
+
+        /* at most one rule is removed at a time */
+        update.op = (ReloadUpdate::Op)(iter % 3);
+        if (removed != rules.size()) {
+            update.op = ReloadUpdate::ADD;
+        } else if (update.op == ReloadUpdate::ADD) {
+            update.op = ReloadUpdate::MODIFY;
+        }
+        if (update.op == ReloadUpdate::ADD) {
+            update.rule = removed;
+        } else {
+            do {
+                update.rule = rng() % rules.size();
+            } while (!live[update.rule]);
+        }
+
+        const std::string& rule = rules[update.rule];
+        update.partition = pm.partitionOf(pattern_id[update.rule]);
+        update.start = since(start);
+        switch (update.op) {
+            case ReloadUpdate::REMOVE:
+                update.ok = pm.removePattern(pattern_id[update.rule], &error);
+                if (update.ok) {
+                    live[update.rule] = false;
+                    removed = update.rule;
+                }
+                break;
+            case ReloadUpdate::ADD:
+                update.ok = pm.addPattern(rule.c_str(), rule.size(), &pattern_id[update.rule], &error);
+                if (update.ok) {
+                    live[update.rule] = true;
+                    removed = rules.size();
+                    update.partition = pm.partitionOf(pattern_id[update.rule]);
+                }
+                break;
+            case ReloadUpdate::MODIFY:
+                update.ok = pm.modifyPattern(pattern_id[update.rule], rule.c_str(), rule.size(), &error);
+                break;
+        }
+        update.latency = since(start) - update.start;
+        if (!update.ok) {
+            fprintf(stderr, "ERROR: Update of rule %zu failed: %s\n", update.rule + 1, error.c_str());
+        }
+        result->updates.push_back(update);
+    }
+
+    /* a quiet tail after the last update */
+    std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(opts.interval));
+    stop_sampler = true;
+    sampler.join();
+    stop = true;
+    for (auto& scanner : scanners) {
+        scanner.join();
+    }
+    result->total = since(start);
+    for (unsigned int iter = 0; iter < opts.threads; iter++) {
+        result->bytes += counters[iter].bytes.load();
+    }
+
+    if (failed) {
+        fprintf(stderr, "ERROR: Unable to scan input buffer.\n");
+        return false;
+    }
+
+    const std::vector<ReloadSample>& samples = result->samples;
+    std::vector<bool> busy(samples.size(), false);
+    for (auto& update : result->updates) {
+        update.rate = rateDuring(samples, update.start, update.start + update.latency, &busy);
+    }
+
+    std::vector<double> quiet;
+    result->min_rate = -1;
+    for (size_t iter = 1; iter < samples.size(); iter++) {
+        double const time = samples[iter].time - samples[iter - 1].time;
+        double const rate = time > 0 ? (samples[iter].bytes - samples[iter - 1].bytes) / (time * 1000.0) : 0;
+
+        if (!busy[iter]) {
+            quiet.push_back(rate);
+        } else if (result->min_rate < 0 || rate < result->min_rate) {
+            result->min_rate = rate;
+        }
+    }
+    if (!quiet.empty()) {
+        std::sort(quiet.begin(), quiet.end());
+        result->quiet_rate = quiet[quiet.size() / 2];
+    }
+
+    return true;
+}
@@ -0,0 +1,63 @@
+#ifndef RELOAD_HPP
+#define RELOAD_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/*
+ * Hot rule reload: scanner threads scan the input in a loop with
+ * HyperscanPm::Reader while the main thread removes, adds back and modifies
+ * rules. Every update recompiles one partition and publishes a new snapshot,
+ * the scanners pick it up on their next chunk without waiting.
+ */
+struct ReloadOptions {
+    unsigned int threads = 4;
+    unsigned int partitions = 16;
+    unsigned int updates = 100;
+    double interval = 20;       /* ms between two updates */
+    uint64_t seed = 1;
+};
+
+struct ReloadUpdate {
+    enum Op {
+        REMOVE,
+        ADD,
+        MODIFY,
+    };
+
+    Op op;
+    size_t rule;                /* index into the rules */
+    unsigned int partition;
+    double start;               /* ms since the scanners started */
+    double latency;             /* ms until the new snapshot was published */
+    double rate;                /* MB/s of the samples overlapping the update */
+    bool ok;
+};
+
+struct ReloadSample {
+    double time;                /* ms since the scanners started */
+    uint64_t bytes;             /* scanned by all threads so far */
+};
+
+struct ReloadResult {
+    double full_compile = 0;    /* ms, all rules in one database */
+    double partitioned_compile = 0;
+    double total = 0;
+    uint64_t bytes = 0;
+    double quiet_rate = 0;      /* MB/s, median of the samples without an update */
+    double min_rate = 0;        /* MB/s, worst sample with an update */
+    std::vector<ReloadUpdate> updates;
+    std::vector<ReloadSample> samples;
+};
+
+/* parses "threads=8,partitions=32,updates=200,interval=10,seed=3" */
+bool reload_parse_options(const char * spec, ReloadOptions * opts);
+
+bool reload_run(const std::vector<std::string>& rules, const char * data, size_t len, const ReloadOptions& opts,
+                ReloadResult * result);
+
+const char * reload_op_name(ReloadUpdate::Op op);
+
+#endif // RELOAD_HPP
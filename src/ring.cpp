@@ -0,0 +1,126 @@
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <new>
+
+#include "ring.hpp"
+#include "util.hpp"
+
+namespace {
+
+static size_t alignUp(size_t size)
+{
+    return (size + RING_ALIGN - 1) & ~(RING_ALIGN - 1);
+}
+
+}  // namespace
+
+Ring::Ring(size_t chunk, size_t overlap, unsigned int buffers)
+    : chunk_size(alignUp(chunk)), overlap_size(overlap), slots(buffers)
+{
+    size_t const prefix = alignUp(overlap);
+
+    for (auto& slot : slots) {
+        void * mem = NULL;
+        if (posix_memalign(&mem, RING_ALIGN, prefix + chunk_size) != 0) {
+            throw std::bad_alloc();
+        }
+        slot.buffer = static_cast<char *>(mem);
+        slot.fresh = slot.buffer + prefix;
+        slot.overlap = 0;
+        slot.len = 0;
+        free_slots.push_back(&slot);
+    }
+}
+
+Ring::~Ring()
+{
+    for (auto& slot : slots) {
+        free(slot.buffer);
+    }
+}
+
+Slot * Ring::acquire(double * wait)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    Clock::time_point const start = Clock::now();
+
+    not_full.wait(guard, [this] { return !free_slots.empty() || stopped; });
+    *wait += since(start);
+    if (stopped) {
+        return NULL;
+    }
+    Slot * const slot = free_slots.back();
+    free_slots.pop_back();
+    return slot;
+}
+
+Slot * Ring::tryAcquire()
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (free_slots.empty() || stopped) {
+        return NULL;
+    }
+    Slot * const slot = free_slots.back();
+    free_slots.pop_back();
+    return slot;
+}
+
+void Ring::push(Slot * slot, size_t fresh_len)
+{
+    memcpy(slot->fresh - tail.size(), tail.data(), tail.size());
+    slot->overlap = tail.size();
+    slot->len = slot->overlap + fresh_len;
+
+    size_t const keep = std::min(overlap_size, slot->len);
+    tail.assign(slot->data() + slot->len - keep, slot->data() + slot->len);
+
+    std::lock_guard<std::mutex> guard(lock);
+    full.push_back(slot);
+    not_empty.notify_one();
+}
+
+Slot * Ring::pop(double * wait)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    Clock::time_point const start = Clock::now();
+
+    not_empty.wait(guard, [this] { return !full.empty() || finished || stopped; });
+    *wait += since(start);
+    if (full.empty() || stopped) {
+        return NULL;
+    }
+    Slot * const slot = full.front();
+    full.pop_front();
+    return slot;
+}
+
+void Ring::release(Slot * slot)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    free_slots.push_back(slot);
+    not_full.notify_one();
+}
+
+void Ring::finish()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    finished = true;
+    not_empty.notify_all();
+}
+
+void Ring::abort()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    stopped = true;
+    not_empty.notify_all();
+    not_full.notify_all();
+}
+
+bool Ring::aborted()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return stopped;
+}
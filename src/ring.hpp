@@ -0,0 +1,72 @@
+#ifndef RING_HPP
+#define RING_HPP
+
+#include <stddef.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+/* O_DIRECT needs the buffers, lengths and file offsets aligned to the logical block size */
+#define RING_ALIGN      ((size_t)4096)
+
+/*
+ * Bounded ring of reusable chunk buffers between the producer of an input
+ * pipeline and its scanners, see compress.hpp. The producer takes a free
+ * buffer, fills the new bytes and queues it, the scanners take the queued
+ * buffers in order and give them back. Both sides account the time they are
+ * blocked on the other one.
+ */
+struct Slot {
+    char * buffer;      /* RING_ALIGN aligned storage */
+    char * fresh;       /* RING_ALIGN aligned start of the new bytes */
+    size_t overlap;     /* tail of the previous chunk in front of the new bytes */
+    size_t len;         /* overlap and new bytes */
+
+    const char * data() const { return fresh - overlap; }
+};
+
+class Ring {
+public:
+    /* the chunk size is rounded up to RING_ALIGN */
+    Ring(size_t chunk, size_t overlap, unsigned int buffers);
+    ~Ring();
+
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+
+    size_t chunk() const { return chunk_size; }
+    size_t size() const { return slots.size(); }
+
+    /* NULL once aborted */
+    Slot * acquire(double * wait);
+
+    /* NULL if no buffer is free */
+    Slot * tryAcquire();
+
+    /* queues fresh_len new bytes, puts the tail of the previous chunk in front of them */
+    void push(Slot * slot, size_t fresh_len);
+
+    /* NULL once the producer finished and the queue is drained */
+    Slot * pop(double * wait);
+
+    void release(Slot * slot);
+    void finish();
+    void abort();
+    bool aborted();
+
+private:
+    size_t chunk_size;
+    size_t overlap_size;
+    std::vector<Slot> slots;
+    std::vector<Slot *> free_slots;
+    std::deque<Slot *> full;
+    std::vector<char> tail;     /* producer only */
+    std::mutex lock;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    bool finished = false;
+    bool stopped = false;
+};
+
+#endif // RING_HPP
@@ -1,18 +1,49 @@
 #include <stdio.h>
+#include <string.h>
 
 #include "main.h"
 
 #include <rregex.h>
 
-int rust_find_all(const char* pattern, const char* subject, int subject_len, int repeat, struct result * res)
+/* is_match() for --is-match, captures_iter() for --captures, find_iter() otherwise */
+static uint64_t rust_scan(struct Regex const * regex_hdl, const char* subject, size_t subject_len, uint64_t * captures)
+{
+    uint64_t groups = 0;
+    uint64_t found;
+
+    if (regex_is_match) {
+        return regex_matches_any(regex_hdl, (uint8_t*) subject, subject_len);
+    }
+    if (!regex_captures) {
+        return regex_matches(regex_hdl, (uint8_t*) subject, subject_len);
+    }
+
+    found = regex_match_captures(regex_hdl, (uint8_t*) subject, subject_len, &groups);
+    *captures += groups;
+    return found;
+}
+
+static int rust_find_all_common(const char* pattern, const char* subject, size_t subject_len, const struct blocks * blocks,
+                                int repeat, struct result * res)
 {
     TIME_TYPE start, end;
-    int found = 0;
+    uint64_t found = 0;
+    uint64_t captures = 0;
 
     double pre_times = 0;
     GET_TIME(start);
 
-    struct Regex const * regex_hdl = regex_new(pattern);
+    struct Regex const * regex_hdl;
+    if (regex_encoding == ENC_BYTES || regex_caseless == CASE_NATIVE) {
+        /* Unicode classes are on by default, even for regex::bytes */
+        char * flagged_pattern = malloc(strlen(pattern) + sizeof("(?i-u)"));
+        sprintf(flagged_pattern, "(?%s%s)%s", regex_caseless == CASE_NATIVE ? "i" : "",
+                regex_encoding == ENC_BYTES ? "-u" : "", pattern);
+        regex_hdl = regex_new(flagged_pattern);
+        free(flagged_pattern);
+    } else {
+        regex_hdl = regex_new(pattern);
+    }
     if (regex_hdl == NULL) {
         fprintf(stderr, "ERROR: Unable to compile pattern \"%s\"\n", pattern);
         return -1;
@@ -25,15 +56,24 @@ int rust_find_all(const char* pattern, const char* subject, int subject_len, int
     int const times_len = repeat;
 
     do {
-        GET_TIME(start);
-        found = regex_matches(regex_hdl, (uint8_t*) subject, subject_len);
-        GET_TIME(end);
+        START_SCAN_TIME(start);
+        captures = 0;
+        if (blocks) {
+            found = 0;
+            for (size_t iter = 0; iter < blocks->count; iter++) {
+                found += rust_scan(regex_hdl, blocks->data[iter], blocks->len[iter], &captures);
+            }
+        } else {
+            found = rust_scan(regex_hdl, subject, subject_len, &captures);
+        }
+        STOP_SCAN_TIME(end);
 
         times[repeat - 1] = TIME_DIFF_IN_MS(start, end);
 
     } while (--repeat > 0);
 
     res->matches = found;
+    res->captures = captures;
     get_mean_and_derivation(pre_times, times, times_len, res);
 
     regex_free(regex_hdl);
@@ -42,12 +82,31 @@ int rust_find_all(const char* pattern, const char* subject, int subject_len, int
     return 0;
 }
 
-int regress_find_all(const char* pattern, const char* subject, int subject_len, int repeat, struct result *res)
+int rust_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res)
+{
+    return rust_find_all_common(pattern, subject, subject_len, NULL, repeat, res);
+}
+
+int rust_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res)
+{
+    return rust_find_all_common(pattern, NULL, 0, blocks, repeat, res);
+}
+
+int regress_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result *res)
 {
     TIME_TYPE start, end;
-    int found = 0;
+    uint64_t found = 0;
 
-    struct Regress const *regex_hdl = regress_new(pattern);
+    struct Regress const *regex_hdl;
+    if (regex_caseless == CASE_NATIVE && strncmp(pattern, "(?i)", 4) != 0) {
+        /* regress only knows a leading "(?i)", see regress_new() */
+        char * caseless_pattern = malloc(strlen(pattern) + sizeof("(?i)"));
+        sprintf(caseless_pattern, "(?i)%s", pattern);
+        regex_hdl = regress_new(caseless_pattern);
+        free(caseless_pattern);
+    } else {
+        regex_hdl = regress_new(pattern);
+    }
     if (regex_hdl == NULL)
     {
         fprintf(stderr, "ERROR: Unable to compile pattern \"%s\"\n", pattern);
@@ -59,9 +118,22 @@ int regress_find_all(const char* pattern, const char* subject, int subject_len,
 
     do
     {
-        GET_TIME(start);
-        found = regress_matches(regex_hdl, (uint8_t *)subject, subject_len);
-        GET_TIME(end);
+        START_SCAN_TIME(start);
+        if (regex_is_match) {
+            found = regress_matches_any(regex_hdl, (uint8_t *)subject, subject_len, regex_encoding == ENC_UTF8);
+        } else if (regex_encoding == ENC_UTF8) {
+            found = regress_matches_utf8(regex_hdl, (uint8_t *)subject, subject_len);
+        } else {
+            found = regress_matches(regex_hdl, (uint8_t *)subject, subject_len);
+        }
+        STOP_SCAN_TIME(end);
+
+        if (found == UINT64_MAX) {
+            fprintf(stderr, "ERROR: regress needs valid UTF-8 input\n");
+            regress_free(regex_hdl);
+            free(times);
+            return -1;
+        }
 
         times[repeat - 1] = TIME_DIFF_IN_MS(start, end);
 
@@ -75,3 +147,273 @@ int regress_find_all(const char* pattern, const char* subject, int subject_len,
 
     return 0;
 }
+
+#define RA_PATH_LEN 4096
+
+static const char * ra_cache_dir = "/tmp";
+static uint64_t ra_size_limit = 0;
+
+void rust_set_cache_dir(const char * dir)
+{
+    ra_cache_dir = dir;
+}
+
+void rust_set_size_limit(uint64_t limit)
+{
+    ra_size_limit = limit;
+}
+
+bool rust_ra_verify(const char * pattern)
+{
+    return ra_verify(pattern, regex_encoding == ENC_UTF8, regex_caseless == CASE_NATIVE);
+}
+
+/* the cache file name depends on the patterns, the automaton kind, the size limit and the syntax flags */
+static void ra_cache_path(const char ** pattern, int pattern_num, int kind, char * path, size_t path_len)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (int iter = 0; iter < pattern_num; iter++) {
+        /* the terminating zero separates the patterns */
+        for (const char * p = pattern[iter]; ; p++) {
+            hash = (hash ^ (unsigned char)*p) * 0x100000001b3ULL;
+            if (*p == '\0') {
+                break;
+            }
+        }
+    }
+    hash = (hash ^ ra_size_limit) * 0x100000001b3ULL;
+    hash = (hash ^ (uint64_t)regex_encoding) * 0x100000001b3ULL;
+    hash = (hash ^ (uint64_t)regex_caseless) * 0x100000001b3ULL;
+
+    snprintf(path, path_len, "%s/ra-%s-%016" PRIx64 ".dfa", ra_cache_dir, kind == RA_SPARSE_MMAP ? "sparse" : "dense", hash);
+}
+
+/*
+ * Builds the automaton, or for the mmap kinds loads the serialized DFA from the
+ * cache directory. A missing or unusable cache file is rebuilt and saved first,
+ * outside of the measured time, so pre_time is the pure load time of the DFA.
+ */
+static struct RaEngine * ra_prepare(const char ** pattern, int pattern_num, int kind, struct build_stats * stats)
+{
+    TIME_TYPE start, end;
+    struct RaEngine * engine;
+
+    if (kind != RA_DENSE_MMAP && kind != RA_SPARSE_MMAP) {
+        GET_TIME(start);
+        engine = ra_new(pattern, pattern_num, kind, regex_encoding == ENC_UTF8, regex_caseless == CASE_NATIVE, ra_size_limit);
+        GET_TIME(end);
+
+        if (engine) {
+            stats->build_time = TIME_DIFF_IN_MS(start, end);
+            stats->size = ra_memory_usage(engine);
+        }
+        return engine;
+    }
+
+    uint32_t const base = (kind == RA_SPARSE_MMAP) ? RA_SPARSE : RA_DENSE;
+    char path[RA_PATH_LEN];
+    ra_cache_path(pattern, pattern_num, kind, path, sizeof(path));
+
+    FILE * cached = fopen(path, "rb");
+    if (cached) {
+        fclose(cached);
+
+        GET_TIME(start);
+        engine = ra_load(path, base);
+        GET_TIME(end);
+
+        if (engine) {
+            stats->load_time = TIME_DIFF_IN_MS(start, end);
+            stats->size = ra_memory_usage(engine);
+            return engine;
+        }
+        fprintf(stderr, "WARNING: Ignoring unusable DFA cache '%s'\n", path);
+    }
+
+    GET_TIME(start);
+    engine = ra_new(pattern, pattern_num, base, regex_encoding == ENC_UTF8, regex_caseless == CASE_NATIVE, ra_size_limit);
+    GET_TIME(end);
+    if (engine == NULL) {
+        return NULL;
+    }
+    stats->build_time = TIME_DIFF_IN_MS(start, end);
+
+    int64_t const saved = ra_save(engine, path);
+    ra_free(engine);
+    if (saved < 0) {
+        fprintf(stderr, "ERROR: Unable to write DFA cache '%s'\n", path);
+        return NULL;
+    }
+
+    GET_TIME(start);
+    engine = ra_load(path, base);
+    GET_TIME(end);
+    if (engine == NULL) {
+        fprintf(stderr, "ERROR: Unable to load DFA cache '%s'\n", path);
+        return NULL;
+    }
+    stats->load_time = TIME_DIFF_IN_MS(start, end);
+    stats->size = (uint64_t)saved;
+
+    return engine;
+}
+
+/* --is-match stops at the first match state */
+static uint64_t ra_scan(struct RaEngine const * engine, const char * subject, size_t subject_len)
+{
+    if (regex_is_match) {
+        return ra_matches_any(engine, (uint8_t*) subject, subject_len);
+    }
+    return ra_matches(engine, (uint8_t*) subject, subject_len);
+}
+
+static int ra_find_all_common(const char ** pattern, int pattern_num, const char * subject, size_t subject_len,
+                              const struct blocks * blocks, int kind, int repeat, struct result * res, struct build_stats * stats)
+{
+    TIME_TYPE start, end;
+    uint64_t found = 0;
+
+    *stats = (struct build_stats){};
+
+    struct RaEngine * engine = ra_prepare(pattern, pattern_num, kind, stats);
+    if (engine == NULL) {
+        if (pattern_num == 1) {
+            fprintf(stderr, "ERROR: Unable to compile pattern \"%s\"\n", pattern[0]);
+        } else {
+            fprintf(stderr, "ERROR: Unable to compile patterns\n");
+        }
+        return -1;
+    }
+
+    double * times = calloc(repeat, sizeof(double));
+    int const times_len = repeat;
+
+    do {
+        START_SCAN_TIME(start);
+        if (blocks) {
+            found = 0;
+            for (size_t iter = 0; iter < blocks->count; iter++) {
+                found += ra_scan(engine, blocks->data[iter], blocks->len[iter]);
+            }
+        } else {
+            found = ra_scan(engine, subject, subject_len);
+        }
+        STOP_SCAN_TIME(end);
+
+        times[repeat - 1] = TIME_DIFF_IN_MS(start, end);
+
+    } while (--repeat > 0);
+
+    res->matches = found;
+    /* a precompiled DFA is only loaded, building it is not part of the startup */
+    get_mean_and_derivation((kind == RA_DENSE_MMAP || kind == RA_SPARSE_MMAP) ? stats->load_time : stats->build_time,
+                            times, times_len, res);
+
+    ra_free(engine);
+    free(times);
+
+    return 0;
+}
+
+int ra_dense_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res)
+{
+    struct build_stats stats;
+    return ra_find_all_common(&pattern, 1, subject, subject_len, NULL, RA_DENSE, repeat, res, &stats);
+}
+
+int ra_dense_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res)
+{
+    struct build_stats stats;
+    return ra_find_all_common(&pattern, 1, NULL, 0, blocks, RA_DENSE, repeat, res, &stats);
+}
+
+int ra_sparse_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res)
+{
+    struct build_stats stats;
+    return ra_find_all_common(&pattern, 1, subject, subject_len, NULL, RA_SPARSE, repeat, res, &stats);
+}
+
+int ra_sparse_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res)
+{
+    struct build_stats stats;
+    return ra_find_all_common(&pattern, 1, NULL, 0, blocks, RA_SPARSE, repeat, res, &stats);
+}
+
+int ra_meta_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res)
+{
+    struct build_stats stats;
+    return ra_find_all_common(&pattern, 1, subject, subject_len, NULL, RA_META, repeat, res, &stats);
+}
+
+int ra_meta_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res)
+{
+    struct build_stats stats;
+    return ra_find_all_common(&pattern, 1, NULL, 0, blocks, RA_META, repeat, res, &stats);
+}
+
+int ra_dense_mm_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res)
+{
+    struct build_stats stats;
+    return ra_find_all_common(&pattern, 1, subject, subject_len, NULL, RA_DENSE_MMAP, repeat, res, &stats);
+}
+
+int ra_dense_mm_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res)
+{
+    struct build_stats stats;
+    return ra_find_all_common(&pattern, 1, NULL, 0, blocks, RA_DENSE_MMAP, repeat, res, &stats);
+}
+
+int ra_sparse_mm_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res)
+{
+    struct build_stats stats;
+    return ra_find_all_common(&pattern, 1, subject, subject_len, NULL, RA_SPARSE_MMAP, repeat, res, &stats);
+}
+
+int ra_sparse_mm_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res)
+{
+    struct build_stats stats;
+    return ra_find_all_common(&pattern, 1, NULL, 0, blocks, RA_SPARSE_MMAP, repeat, res, &stats);
+}
+
+/* best scan time in ms of repeat runs over the rule set, like hs_multi_scan_time() */
+double rust_ra_multi_scan_time(const char ** pattern, int pattern_num, const char * subject, size_t subject_len, int kind,
+                               int repeat)
+{
+    TIME_TYPE start, end;
+    struct build_stats stats = {0};
+    double best = -1;
+
+    struct RaEngine * engine = ra_prepare(pattern, pattern_num, kind, &stats);
+    if (engine == NULL) {
+        fprintf(stderr, "ERROR: Unable to compile patterns\n");
+        return -1;
+    }
+
+    do {
+        START_SCAN_TIME(start);
+        ra_scan(engine, subject, subject_len);
+        STOP_SCAN_TIME(end);
+
+        double const time = TIME_DIFF_IN_MS(start, end);
+        if (best < 0 || time < best) {
+            best = time;
+        }
+    } while (--repeat > 0);
+
+    ra_free(engine);
+
+    return best;
+}
+
+int rust_ra_multi_find_all(const char ** pattern, int pattern_num, const char * subject, size_t subject_len, int kind,
+                           int repeat, struct result * res, struct build_stats * stats)
+{
+    return ra_find_all_common(pattern, pattern_num, subject, subject_len, NULL, kind, repeat, res, stats);
+}
+
+int rust_ra_multi_find_all_blocks(const char ** pattern, int pattern_num, const struct blocks * blocks, int kind,
+                                  int repeat, struct result * res, struct build_stats * stats)
+{
+    return ra_find_all_common(pattern, pattern_num, NULL, 0, blocks, kind, repeat, res, stats);
+}
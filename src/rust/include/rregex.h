@@ -1,13 +1,30 @@
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 struct Regex;
 
 extern struct Regex const * regex_new(const char * const regex);
 extern uint64_t regex_matches(struct Regex const * const exp, uint8_t * const str, uint64_t str_len);
+extern bool regex_matches_any(struct Regex const * const exp, uint8_t * const str, uint64_t str_len);
+extern uint64_t regex_match_captures(struct Regex const * const exp, uint8_t * const str, uint64_t str_len, uint64_t * captures);
 extern void regex_free(struct Regex const * const exp);
 
 struct Regress;
 
 extern struct Regress const *regress_new(const char * const regress);
 extern uint64_t regress_matches(struct Regress const * const exp, uint8_t * const str, uint64_t str_len);
+extern uint64_t regress_matches_utf8(struct Regress const * const exp, uint8_t * const str, uint64_t str_len);
+extern uint64_t regress_matches_any(struct Regress const * const exp, uint8_t * const str, uint64_t str_len, bool utf8);
 extern void regress_free(struct Regress const * const exp);
+
+struct RaEngine;
+
+extern bool ra_verify(const char * const regex, bool unicode, bool caseless);
+extern struct RaEngine * ra_new(const char * const * patterns, size_t count, uint32_t kind, bool unicode, bool caseless, uint64_t size_limit);
+extern int64_t ra_save(struct RaEngine const * const engine, const char * const path);
+extern struct RaEngine * ra_load(const char * const path, uint32_t kind);
+extern uint64_t ra_matches(struct RaEngine const * const engine, uint8_t * const str, uint64_t str_len);
+extern bool ra_matches_any(struct RaEngine const * const engine, uint8_t * const str, uint64_t str_len);
+extern uint64_t ra_memory_usage(struct RaEngine const * const engine);
+extern void ra_free(struct RaEngine * const engine);
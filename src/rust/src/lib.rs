@@ -1,12 +1,19 @@
 extern crate regex;
+extern crate regex_automata;
 extern crate regress;
 extern crate libc;
 
 use regex::bytes::Regex;
+use regex_automata::dfa::{dense, sparse, Automaton};
+use regex_automata::util::iter::Searcher;
+use regex_automata::util::syntax;
+use regex_automata::{meta, Input};
 use regress::Regex as Regress;
-use libc::c_char;
+use libc::{c_char, c_void};
 use std::boxed::Box;
 use std::ffi::CStr;
+use std::fs::File;
+use std::io::Write;
 use std::slice;
 use std::ptr;
 
@@ -14,7 +21,12 @@ use std::ptr;
 pub extern fn regex_new(c_buf: *const c_char) -> *const Regex {
     let c_str: &CStr = unsafe { CStr::from_ptr(c_buf) };
     
-    let exp = match Regex::new(c_str.to_str().unwrap()) {
+    // Patterns that are not valid UTF-8 cannot be compiled, report them as errors.
+    let pat = match c_str.to_str() {
+        Ok(val) => val,
+        Err(_) => return ptr::null(),
+    };
+    let exp = match Regex::new(pat) {
        Ok(val) => Box::into_raw(Box::new(val)),
        Err(_) => ptr::null()
     };
@@ -32,6 +44,32 @@ pub extern fn regex_matches(raw_exp: *mut Regex, p: *const u8, len: u64) -> u64
     findings as u64
 }
 
+// Stops at the first match, see --is-match.
+#[no_mangle]
+pub extern fn regex_matches_any(raw_exp: *const Regex, p: *const u8, len: u64) -> bool {
+    let exp = unsafe { &*raw_exp };
+    let s = unsafe { slice::from_raw_parts(p, len as usize) };
+
+    exp.is_match(s)
+}
+
+// Like regex_matches(), but every match goes through captures_iter(). captures gets the
+// number of capture groups that took part in the matches.
+#[no_mangle]
+pub extern fn regex_match_captures(raw_exp: *const Regex, p: *const u8, len: u64, captures: *mut u64) -> u64 {
+    let exp = unsafe { &*raw_exp };
+    let s = unsafe { slice::from_raw_parts(p, len as usize) };
+    let mut findings = 0u64;
+    let mut groups = 0u64;
+
+    for caps in exp.captures_iter(s) {
+        findings += 1;
+        groups += caps.iter().skip(1).filter(|group| group.is_some()).count() as u64;
+    }
+    unsafe { *captures = groups; }
+    findings
+}
+
 #[no_mangle]
 pub extern fn regex_free(raw_exp: *mut Regex) {
     unsafe { let _ = Box::from_raw(raw_exp); };
@@ -42,7 +80,10 @@ pub extern fn regress_new(c_buf: *const c_char) -> *const Regress {
     let c_str: &CStr = unsafe { CStr::from_ptr(c_buf) };
 
     // Pretend regress supports the "(?i)" syntax.
-    let mut pat = c_str.to_str().unwrap();
+    let mut pat = match c_str.to_str() {
+        Ok(val) => val,
+        Err(_) => return ptr::null(),
+    };
     let mut flags = regress::Flags::default();
     if pat.starts_with("(?i)") {
         flags.icase = true;
@@ -69,7 +110,273 @@ pub extern fn regress_matches(raw_exp: *mut Regress, p: *const u8, len: u64) ->
     findings as u64
 }
 
+// Code point semantics, the subject has to be valid UTF-8. Returns u64::MAX otherwise.
+#[no_mangle]
+pub extern fn regress_matches_utf8(raw_exp: *const Regress, p: *const u8, len: u64) -> u64 {
+    let exp = unsafe { &*raw_exp };
+    let s = match std::str::from_utf8(unsafe { slice::from_raw_parts(p, len as usize) }) {
+        Ok(val) => val,
+        Err(_) => return u64::MAX,
+    };
+
+    exp.find_iter(s).count() as u64
+}
+
+// 1 if there is a match, 0 if not. With utf8 the subject has to be valid UTF-8, returns u64::MAX otherwise.
+#[no_mangle]
+pub extern fn regress_matches_any(raw_exp: *const Regress, p: *const u8, len: u64, utf8: bool) -> u64 {
+    let exp = unsafe { &*raw_exp };
+    let sl = unsafe { slice::from_raw_parts(p, len as usize) };
+
+    if !utf8 {
+        let s = unsafe { std::str::from_utf8_unchecked(sl) };
+        return exp.find_iter_ascii(s).next().is_some() as u64;
+    }
+    match std::str::from_utf8(sl) {
+        Ok(s) => exp.find(s).is_some() as u64,
+        Err(_) => u64::MAX,
+    }
+}
+
 #[no_mangle]
 pub extern fn regress_free(raw_exp: *mut Regress) {
     unsafe { let _ = Box::from_raw(raw_exp); };
 }
+
+// Engine kinds, see RA_* in main.h.
+const RA_DENSE: u32 = 0;
+const RA_SPARSE: u32 = 1;
+const RA_META: u32 = 2;
+
+// A read-only file mapping, the deserialized DFAs borrow from it.
+pub struct Mapping {
+    addr: *mut c_void,
+    len: usize,
+}
+
+impl Mapping {
+    fn open(path: &CStr) -> Option<Mapping> {
+        unsafe {
+            let fd = libc::open(path.as_ptr(), libc::O_RDONLY);
+            if fd < 0 {
+                return None;
+            }
+            let mut st: libc::stat = std::mem::zeroed();
+            if libc::fstat(fd, &mut st) != 0 || st.st_size <= 0 {
+                libc::close(fd);
+                return None;
+            }
+            let len = st.st_size as usize;
+            let addr = libc::mmap(ptr::null_mut(), len, libc::PROT_READ, libc::MAP_PRIVATE, fd, 0);
+            libc::close(fd);
+            if addr == libc::MAP_FAILED {
+                return None;
+            }
+            Some(Mapping { addr, len })
+        }
+    }
+
+    // The slice lives as long as the mapping, the engine drops the DFA first.
+    fn bytes(&self) -> &'static [u8] {
+        unsafe { slice::from_raw_parts(self.addr as *const u8, self.len) }
+    }
+}
+
+impl Drop for Mapping {
+    fn drop(&mut self) {
+        unsafe { libc::munmap(self.addr, self.len); }
+    }
+}
+
+pub enum RaEngine {
+    Dense(dense::DFA<Vec<u32>>),
+    Sparse(sparse::DFA<Vec<u8>>),
+    Meta(meta::Regex),
+    // Declared before the mapping, so the DFA is dropped before the memory is unmapped.
+    DenseMapped(dense::DFA<&'static [u32]>, Mapping),
+    SparseMapped(sparse::DFA<&'static [u8]>, Mapping),
+}
+
+// Byte oriented semantics by default: ASCII classes and \b, no UTF-8 requirement.
+// With unicode the classes follow Unicode, the haystack may still contain invalid UTF-8.
+fn ra_syntax(unicode: bool, caseless: bool) -> syntax::Config {
+    syntax::Config::new().unicode(unicode).utf8(false).case_insensitive(caseless)
+}
+
+fn ra_build(patterns: &[&str], kind: u32, unicode: bool, caseless: bool, size_limit: Option<usize>) -> Result<RaEngine, String> {
+    if kind == RA_META {
+        let config = meta::Config::new()
+            .utf8_empty(false)
+            .nfa_size_limit(size_limit)
+            .onepass_size_limit(size_limit)
+            .dfa_size_limit(size_limit);
+        return meta::Builder::new()
+            .syntax(ra_syntax(unicode, caseless))
+            .configure(config)
+            .build_many(patterns)
+            .map(RaEngine::Meta)
+            .map_err(|e| e.to_string());
+    }
+
+    let dfa = dense::Builder::new()
+        .syntax(ra_syntax(unicode, caseless))
+        .thompson(regex_automata::nfa::thompson::Config::new().utf8(false))
+        .configure(dense::Config::new().dfa_size_limit(size_limit).determinize_size_limit(size_limit))
+        .build_many(patterns)
+        .map_err(|e| e.to_string())?;
+
+    if kind == RA_SPARSE {
+        dfa.to_sparse().map(RaEngine::Sparse).map_err(|e| e.to_string())
+    } else {
+        Ok(RaEngine::Dense(dfa))
+    }
+}
+
+// Counts the non-overlapping leftmost-first matches. Only the end offsets are
+// needed, so the forward DFA is enough.
+fn ra_count<A: Automaton>(dfa: &A, haystack: &[u8]) -> u64 {
+    let mut searcher = Searcher::new(Input::new(haystack));
+    let mut count = 0;
+
+    while let Ok(Some(_)) = searcher.try_advance_half(|input| dfa.try_search_fwd(input)) {
+        count += 1;
+    }
+    count
+}
+
+// Only parses the pattern, much cheaper than building an automaton.
+#[no_mangle]
+pub extern fn ra_verify(c_buf: *const c_char, unicode: bool, caseless: bool) -> bool {
+    match unsafe { CStr::from_ptr(c_buf) }.to_str() {
+        Ok(pat) => syntax::parse_with(pat, &ra_syntax(unicode, caseless)).is_ok(),
+        Err(_) => false,
+    }
+}
+
+#[no_mangle]
+pub extern fn ra_new(c_patterns: *const *const c_char, count: usize, kind: u32, unicode: bool, caseless: bool, size_limit: u64) -> *mut RaEngine {
+    let c_patterns = unsafe { slice::from_raw_parts(c_patterns, count) };
+    let mut patterns = Vec::with_capacity(count);
+
+    for &c_buf in c_patterns {
+        match unsafe { CStr::from_ptr(c_buf) }.to_str() {
+            Ok(val) => patterns.push(val),
+            Err(_) => {
+                eprintln!("ERROR: Pattern is not valid UTF-8");
+                return ptr::null_mut();
+            }
+        }
+    }
+
+    let limit = if size_limit == 0 { None } else { Some(size_limit as usize) };
+    match ra_build(&patterns, kind, unicode, caseless, limit) {
+        Ok(engine) => Box::into_raw(Box::new(engine)),
+        Err(err) => {
+            eprintln!("ERROR: regex-automata: {}", err);
+            ptr::null_mut()
+        }
+    }
+}
+
+// Writes the DFA in native endianness, returns the number of bytes or -1.
+#[no_mangle]
+pub extern fn ra_save(engine: *const RaEngine, path: *const c_char) -> i64 {
+    let engine = unsafe { &*engine };
+    let path = unsafe { CStr::from_ptr(path) };
+
+    let bytes = match engine {
+        RaEngine::Dense(dfa) => {
+            let (buf, pad) = dfa.to_bytes_native_endian();
+            buf[pad..].to_vec()
+        }
+        RaEngine::Sparse(dfa) => dfa.to_bytes_native_endian(),
+        _ => return -1,
+    };
+
+    let written = path.to_str().ok()
+        .and_then(|path| File::create(path).ok())
+        .and_then(|mut file| file.write_all(&bytes).ok());
+    match written {
+        Some(_) => bytes.len() as i64,
+        None => -1,
+    }
+}
+
+// Maps a file written by ra_save() and deserializes the DFA without copying it.
+#[no_mangle]
+pub extern fn ra_load(path: *const c_char, kind: u32) -> *mut RaEngine {
+    let path = unsafe { CStr::from_ptr(path) };
+    let mapping = match Mapping::open(path) {
+        Some(mapping) => mapping,
+        None => return ptr::null_mut(),
+    };
+
+    // from_bytes() validates the automaton, a stale or foreign file is rejected
+    let engine = match kind {
+        RA_DENSE => match dense::DFA::from_bytes(mapping.bytes()) {
+            Ok((dfa, _)) => RaEngine::DenseMapped(dfa, mapping),
+            Err(_) => return ptr::null_mut(),
+        },
+        RA_SPARSE => match sparse::DFA::from_bytes(mapping.bytes()) {
+            Ok((dfa, _)) => RaEngine::SparseMapped(dfa, mapping),
+            Err(_) => return ptr::null_mut(),
+        },
+        _ => return ptr::null_mut(),
+    };
+
+    Box::into_raw(Box::new(engine))
+}
+
+#[no_mangle]
+pub extern fn ra_matches(engine: *const RaEngine, p: *const u8, len: u64) -> u64 {
+    let engine = unsafe { &*engine };
+    let s = unsafe { slice::from_raw_parts(p, len as usize) };
+
+    match engine {
+        RaEngine::Dense(dfa) => ra_count(dfa, s),
+        RaEngine::Sparse(dfa) => ra_count(dfa, s),
+        RaEngine::DenseMapped(dfa, _) => ra_count(dfa, s),
+        RaEngine::SparseMapped(dfa, _) => ra_count(dfa, s),
+        RaEngine::Meta(re) => re.find_iter(s).count() as u64,
+    }
+}
+
+// Stops at the first match state the DFA reaches, see --is-match.
+fn ra_any<A: Automaton>(dfa: &A, haystack: &[u8]) -> bool {
+    matches!(dfa.try_search_fwd(&Input::new(haystack).earliest(true)), Ok(Some(_)))
+}
+
+#[no_mangle]
+pub extern fn ra_matches_any(engine: *const RaEngine, p: *const u8, len: u64) -> bool {
+    let engine = unsafe { &*engine };
+    let s = unsafe { slice::from_raw_parts(p, len as usize) };
+
+    match engine {
+        RaEngine::Dense(dfa) => ra_any(dfa, s),
+        RaEngine::Sparse(dfa) => ra_any(dfa, s),
+        RaEngine::DenseMapped(dfa, _) => ra_any(dfa, s),
+        RaEngine::SparseMapped(dfa, _) => ra_any(dfa, s),
+        RaEngine::Meta(re) => re.is_match(s),
+    }
+}
+
+// Heap memory of the automaton, the mapped DFAs report the size of the file.
+#[no_mangle]
+pub extern fn ra_memory_usage(engine: *const RaEngine) -> u64 {
+    let engine = unsafe { &*engine };
+
+    (match engine {
+        RaEngine::Dense(dfa) => dfa.memory_usage(),
+        RaEngine::Sparse(dfa) => dfa.memory_usage(),
+        RaEngine::Meta(re) => re.memory_usage(),
+        RaEngine::DenseMapped(_, mapping) => mapping.len,
+        RaEngine::SparseMapped(_, mapping) => mapping.len,
+    }) as u64
+}
+
+#[no_mangle]
+pub extern fn ra_free(engine: *mut RaEngine) {
+    if !engine.is_null() {
+        unsafe { let _ = Box::from_raw(engine); };
+    }
+}
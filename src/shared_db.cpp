@@ -0,0 +1,266 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <chrono>
+
+#include "hyperscan.hpp"
+#include "main.h"
+#include "shared_db.hpp"
+#include "util.hpp"
+#include <hs/hs.h>
+
+namespace {
+
+/* the workers scan in parallel, clock() of one process is not the elapsed time */
+static int onMatch(UNUSED unsigned int id, UNUSED unsigned long long from, UNUSED unsigned long long to,
+                   UNUSED unsigned int flags, void * ctx)
+{
+    (*static_cast<uint64_t *>(ctx))++;
+    return 0;
+}
+
+/* an input above 4 GB needs a stream mode database */
+static hs_database_t * compile(const std::vector<std::string>& rules, bool chunked)
+{
+    std::vector<const char *> patterns;
+    std::vector<unsigned> flags(rules.size(), HS_FLAG_DOTALL | HS_FLAG_MULTILINE | HS_FLAG_SOM_LEFTMOST | hs_option_flags());
+    std::vector<unsigned> ids;
+    hs_database_t * database = NULL;
+    hs_compile_error_t * compile_err = NULL;
+
+    for (size_t iter = 0; iter < rules.size(); iter++) {
+        patterns.push_back(rules[iter].c_str());
+        ids.push_back(iter);
+    }
+
+    unsigned const mode = chunked ? (HS_MODE_STREAM | HS_MODE_SOM_HORIZON_LARGE) : HS_MODE_BLOCK;
+    if (hs_compile_multi(patterns.data(), flags.data(), ids.data(), patterns.size(), mode, NULL,
+                         &database, &compile_err) != HS_SUCCESS) {
+        fprintf(stderr, "ERROR: Unable to compile patterns: '%s'\n", compile_err->message);
+        hs_free_compile_error(compile_err);
+        return NULL;
+    }
+    return database;
+}
+
+/* the memfd holds a database that can be used in place */
+static int exportDatabase(const std::vector<std::string>& rules, bool chunked, SharedDbResult * result)
+{
+    Clock::time_point const start = Clock::now();
+    hs_database_t * database = compile(rules, chunked);
+    if (!database) {
+        return -1;
+    }
+    result->compile = since(start);
+
+    char * bytes = NULL;
+    size_t length = 0;
+    int fd = -1;
+    if (hs_serialize_database(database, &bytes, &length) != HS_SUCCESS
+            || hs_serialized_database_size(bytes, length, &result->db_size) != HS_SUCCESS) {
+        fprintf(stderr, "ERROR: Unable to serialize the database.\n");
+    } else if ((fd = memfd_create("regex-perf-hs", MFD_CLOEXEC)) < 0 || ftruncate(fd, result->db_size) != 0) {
+        perror("memfd");
+    } else {
+        void * mem = mmap(NULL, result->db_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mem == MAP_FAILED) {
+            perror("mmap");
+        } else {
+            hs_error_t const err = hs_deserialize_database_at(bytes, length, (hs_database_t *)mem);
+            munmap(mem, result->db_size);
+            if (err == HS_SUCCESS) {
+                free(bytes);
+                hs_free_database(database);
+                return fd;
+            }
+            fprintf(stderr, "ERROR: Unable to deserialize the database.\n");
+        }
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+    free(bytes);
+    hs_free_database(database);
+    return -1;
+}
+
+static void readMemory(SharedDbWorker * worker)
+{
+    FILE * f = fopen("/proc/self/smaps_rollup", "r");
+    char line[256];
+
+    if (!f) {
+        return;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long long kb;
+        if (sscanf(line, "Rss: %llu kB", &kb) == 1) {
+            worker->rss = kb;
+        } else if (sscanf(line, "Pss: %llu kB", &kb) == 1) {
+            worker->pss = kb;
+        }
+    }
+    fclose(f);
+}
+
+/* blocks until the parent closes the write end */
+static void waitClosed(int fd)
+{
+    char c;
+    while (read(fd, &c, 1) > 0) {
+    }
+}
+
+static void runWorker(const std::vector<std::string>& rules, const char * data, size_t len, int repeat, int db_fd,
+                      size_t db_size, SharedDbWorker * worker)
+{
+    Clock::time_point start = Clock::now();
+    hs_database_t * database = NULL;
+    hs_scratch_t * scratch = NULL;
+    bool const chunked = len > HS_MAX_SCAN_LEN;
+
+    if (db_fd >= 0) {
+        void * mem = mmap(NULL, db_size, PROT_READ, MAP_SHARED, db_fd, 0);
+        database = (mem == MAP_FAILED) ? NULL : (hs_database_t *)mem;
+    } else {
+        database = compile(rules, chunked);
+    }
+    if (!database || hs_alloc_scratch(database, &scratch) != HS_SUCCESS) {
+        fprintf(stderr, "ERROR: Worker %d has no database or scratch.\n", (int)getpid());
+        return;
+    }
+    worker->setup = since(start);
+
+    start = Clock::now();
+    for (int iter = 0; iter < repeat; iter++) {
+        hs_error_t const err = chunked ? hs_scan_chunked(database, data, len, scratch, onMatch, &worker->matches)
+                                       : hs_scan(database, data, len, 0, scratch, onMatch, &worker->matches);
+        if (err != HS_SUCCESS) {
+            fprintf(stderr, "ERROR: Unable to scan input buffer.\n");
+            return;
+        }
+        worker->bytes += len;
+    }
+    worker->scan = since(start);
+    worker->ok = 1;
+}
+
+}  // namespace
+
+bool shared_db_parse_options(const char * spec, SharedDbOptions * opts)
+{
+    return parse_options(spec, [opts](const std::string& key, const std::string& value) {
+        if (key == "workers") {
+            opts->workers = atoi(value.c_str());
+            if (opts->workers == 0) {
+                fprintf(stderr, "Invalid number of workers '%s'\n", value.c_str());
+                return false;
+            }
+        } else if (key == "mode") {
+            if (value == "shared" || value == "private" || value == "both") {
+                opts->shared = value != "private";
+                opts->private_db = value != "shared";
+            } else {
+                fprintf(stderr, "Unknown shared database mode '%s' (shared, private, both)\n", value.c_str());
+                return false;
+            }
+        } else {
+            fprintf(stderr, "Unknown shared database option '%s'\n", key.c_str());
+            return false;
+        }
+        return true;
+    });
+}
+
+bool shared_db_run(const std::vector<std::string>& rules, const char * data, size_t len, int repeat, bool shared,
+                   unsigned int workers, SharedDbResult * result)
+{
+    *result = SharedDbResult();
+    if (rules.empty()) {
+        fprintf(stderr, "ERROR: No rules.\n");
+        return false;
+    }
+
+    int db_fd = -1;
+    if (shared && (db_fd = exportDatabase(rules, len > HS_MAX_SCAN_LEN, result)) < 0) {
+        return false;
+    }
+
+    /*
+     * ready: the workers are set up and have scanned; measure (closed by the
+     * parent): all workers read their memory while every worker is alive;
+     * report: the results; done (closed by the parent): the workers exit.
+     */
+    int ready[2], measure[2], report[2], done[2];
+    if (pipe(ready) != 0 || pipe(measure) != 0 || pipe(report) != 0 || pipe(done) != 0) {
+        perror("pipe");
+        return false;
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    std::vector<pid_t> pids;
+    for (unsigned int iter = 0; iter < workers; iter++) {
+        pid_t const pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            break;
+        }
+        if (pid == 0) {
+            SharedDbWorker worker = {};
+            char c = 0;
+
+            close(ready[0]);
+            close(measure[1]);
+            close(report[0]);
+            close(done[1]);
+
+            runWorker(rules, data, len, repeat, db_fd, result->db_size, &worker);
+            if (write(ready[1], &c, 1) != 1) {
+                _exit(EXIT_FAILURE);
+            }
+            waitClosed(measure[0]);
+            readMemory(&worker);
+            if (write(report[1], &worker, sizeof(worker)) != sizeof(worker)) {
+                _exit(EXIT_FAILURE);
+            }
+            waitClosed(done[0]);
+            _exit(EXIT_SUCCESS);
+        }
+        pids.push_back(pid);
+    }
+
+    close(ready[1]);
+    close(measure[0]);
+    close(report[1]);
+    close(done[0]);
+
+    for (size_t iter = 0; iter < pids.size(); iter++) {
+        char c;
+        if (read(ready[0], &c, 1) != 1) {
+            break;
+        }
+    }
+    close(measure[1]);
+
+    SharedDbWorker worker;
+    while (result->workers.size() < pids.size() && read(report[0], &worker, sizeof(worker)) == sizeof(worker)) {
+        result->workers.push_back(worker);
+    }
+    close(done[1]);
+
+    for (pid_t pid : pids) {
+        waitpid(pid, NULL, 0);
+    }
+    close(ready[0]);
+    close(report[0]);
+    if (db_fd >= 0) {
+        close(db_fd);
+    }
+
+    return result->workers.size() == workers;
+}
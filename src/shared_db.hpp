@@ -0,0 +1,43 @@
+#ifndef SHARED_DB_HPP
+#define SHARED_DB_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/*
+ * One Hyperscan database for many scanner processes. The parent compiles the
+ * rules and deserializes the database once into a memfd, the forked workers
+ * map it read-only and use it in place, only the scratch is per process. The
+ * baseline is a worker that compiles its own database like hs_multi_find_all.
+ */
+struct SharedDbOptions {
+    unsigned int workers = 4;
+    bool shared = true;         /* measure workers mapping the memfd */
+    bool private_db = true;     /* measure workers compiling their own database */
+};
+
+struct SharedDbWorker {
+    int ok;
+    double setup;               /* ms, compile or map, and allocate the scratch */
+    double scan;                /* ms */
+    uint64_t bytes;
+    uint64_t matches;
+    uint64_t rss;               /* kB, /proc/self/smaps_rollup while all workers are alive */
+    uint64_t pss;               /* kB */
+};
+
+struct SharedDbResult {
+    double compile = 0;         /* ms in the parent, shared mode only */
+    size_t db_size = 0;         /* bytes of the deserialized database */
+    std::vector<SharedDbWorker> workers;
+};
+
+/* parses "workers=8,mode=both" (shared, private, both) */
+bool shared_db_parse_options(const char * spec, SharedDbOptions * opts);
+
+bool shared_db_run(const std::vector<std::string>& rules, const char * data, size_t len, int repeat, bool shared,
+                   unsigned int workers, SharedDbResult * result);
+
+#endif // SHARED_DB_HPP
@@ -0,0 +1,330 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "main.h"
+#include "regex_parser.hpp"
+#include "byte_class.hpp"
+
+/*
+ * Bit-parallel Glushkov automaton (Shift-And generalized to any follow sets)
+ * for short patterns. Every class of the pattern is one position, a state
+ * word holds one bit per position. Positions whose only successor is the next
+ * position move with a shift, the others OR in their follow masks. Stretches
+ * of the input where the automaton is idle are skipped with a pshufb lookup
+ * of the first classes, 64 (AVX-512BW) or 32 (AVX2) bytes per step.
+ *
+ * Like hscan-nsom, every end offset of a match is counted once.
+ */
+#define SHIFTAND_MAX_POSITIONS  512
+/* the skip loop does not pay off when most bytes start a match */
+#define SHIFTAND_MAX_SKIP_CLASS 128
+
+namespace {
+
+struct Glushkov {
+    std::vector<std::bitset<256> > classes;
+    std::vector<std::vector<int> > follow;
+    std::vector<int> first;
+    std::vector<int> last;
+};
+
+struct Fragment {
+    std::vector<int> first;
+    std::vector<int> last;
+    bool nullable;
+};
+
+static void concat(Glushkov * g, Fragment * frag, const Fragment& next)
+{
+    for (int pos : frag->last) {
+        g->follow[pos].insert(g->follow[pos].end(), next.first.begin(), next.first.end());
+    }
+    if (frag->nullable) {
+        frag->first.insert(frag->first.end(), next.first.begin(), next.first.end());
+    }
+    if (next.nullable) {
+        frag->last.insert(frag->last.end(), next.last.begin(), next.last.end());
+    } else {
+        frag->last = next.last;
+    }
+    frag->nullable = frag->nullable && next.nullable;
+}
+
+static void loop(Glushkov * g, const Fragment& frag)
+{
+    for (int pos : frag.last) {
+        g->follow[pos].insert(g->follow[pos].end(), frag.first.begin(), frag.first.end());
+    }
+}
+
+/* every repetition gets its own positions: x{2,4} is x x x? x?, x{2,} is x x+ */
+static bool build(const RegexNode& node, Glushkov * g, Fragment * frag, std::string * error)
+{
+    frag->first.clear();
+    frag->last.clear();
+    frag->nullable = true;
+
+    switch (node.type) {
+        case RegexNode::EMPTY:
+            return true;
+        case RegexNode::CLASS: {
+            if (g->classes.size() >= SHIFTAND_MAX_POSITIONS) {
+                *error = "more than " + std::to_string(SHIFTAND_MAX_POSITIONS) + " positions";
+                return false;
+            }
+
+            int const pos = g->classes.size();
+            g->classes.push_back(node.chars);
+            g->follow.push_back(std::vector<int>());
+            frag->first.push_back(pos);
+            frag->last.push_back(pos);
+            frag->nullable = false;
+            return true;
+        }
+        case RegexNode::CONCAT:
+            for (const RegexNode& child : node.children) {
+                Fragment next;
+                if (!build(child, g, &next, error)) {
+                    return false;
+                }
+                concat(g, frag, next);
+            }
+            return true;
+        case RegexNode::ALTERNATION:
+            frag->nullable = node.children.empty();
+            for (const RegexNode& child : node.children) {
+                Fragment next;
+                if (!build(child, g, &next, error)) {
+                    return false;
+                }
+                frag->first.insert(frag->first.end(), next.first.begin(), next.first.end());
+                frag->last.insert(frag->last.end(), next.last.begin(), next.last.end());
+                frag->nullable = frag->nullable || next.nullable;
+            }
+            return true;
+        case RegexNode::REPEAT: {
+            int const optional = (node.max < 0) ? (node.min == 0) : node.max - node.min;
+
+            for (int iter = 0; iter < node.min + optional; iter++) {
+                Fragment next;
+                if (!build(node.children[0], g, &next, error)) {
+                    return false;
+                }
+                if (node.max < 0 && iter == node.min + optional - 1) {
+                    loop(g, next);
+                }
+                next.nullable = next.nullable || iter >= node.min;
+                concat(g, frag, next);
+            }
+            return true;
+        }
+        case RegexNode::ASSERT:
+            *error = "assertions are not supported";
+            return false;
+    }
+    return false;
+}
+
+static bool compile(const char * pattern, Glushkov * g, std::string * error)
+{
+    RegexNode root;
+    Fragment frag;
+
+    /* the parser folds the classes before negating them, (?i)[^a-z] excludes A-Z as well */
+    std::string const source = (regex_caseless == CASE_NATIVE) ? std::string("(?i)") + pattern : std::string(pattern);
+    if (!regex_parse(source, &root, error) || !build(root, g, &frag, error)) {
+        return false;
+    }
+    if (frag.nullable) {
+        *error = "the pattern matches the empty string";
+        return false;
+    }
+    for (std::vector<int>& follow : g->follow) {
+        std::sort(follow.begin(), follow.end());
+        follow.erase(std::unique(follow.begin(), follow.end()), follow.end());
+    }
+    g->first = frag.first;
+    g->last = frag.last;
+    return true;
+}
+
+/* W 64 bit words of state, one bit per position */
+template <int W>
+struct ShiftAnd {
+    uint64_t classes[256][W];   /* positions that accept a byte */
+    uint64_t first[W];
+    uint64_t last[W];
+    uint64_t shift[W];          /* positions followed by the next position only */
+    uint64_t jump[W];           /* positions with other follow sets */
+    std::vector<uint64_t> follow;   /* W words per position */
+    ByteClass start;            /* bytes of the first classes */
+    bool skip;
+
+    void init(const Glushkov& g)
+    {
+        std::bitset<256> first_chars;
+
+        memset(classes, 0, sizeof(classes));
+        memset(first, 0, sizeof(first));
+        memset(last, 0, sizeof(last));
+        memset(shift, 0, sizeof(shift));
+        memset(jump, 0, sizeof(jump));
+        follow.assign(g.classes.size() * W, 0);
+
+        for (size_t pos = 0; pos < g.classes.size(); pos++) {
+            uint64_t const bit = (uint64_t)1 << (pos % 64);
+
+            for (int c = 0; c < 256; c++) {
+                if (g.classes[pos][c]) {
+                    classes[c][pos / 64] |= bit;
+                }
+            }
+            if (g.follow[pos].size() == 1 && g.follow[pos][0] == (int)pos + 1) {
+                shift[pos / 64] |= bit;
+            } else if (!g.follow[pos].empty()) {
+                jump[pos / 64] |= bit;
+                for (int next : g.follow[pos]) {
+                    follow[pos * W + next / 64] |= (uint64_t)1 << (next % 64);
+                }
+            }
+        }
+        for (int pos : g.first) {
+            first[pos / 64] |= (uint64_t)1 << (pos % 64);
+            first_chars |= g.classes[pos];
+        }
+        for (int pos : g.last) {
+            last[pos / 64] |= (uint64_t)1 << (pos % 64);
+        }
+        start.init(first_chars);
+        skip = first_chars.count() <= SHIFTAND_MAX_SKIP_CLASS;
+    }
+
+    uint64_t scan(const uint8_t * data, size_t len) const
+    {
+        uint64_t state[W] = {0};
+        uint64_t found = 0;
+        bool active = false;
+
+        for (size_t pos = 0; pos < len; pos++) {
+            /* an idle automaton only starts again at a byte of the first classes */
+            if (!active && skip && !start.table[data[pos]]) {
+                pos = start.find(data, pos + 1, len);
+                if (pos == len) {
+                    break;
+                }
+            }
+
+            uint64_t next[W];
+            uint64_t carry = 0;
+            for (int word = 0; word < W; word++) {
+                uint64_t const moved = state[word] & shift[word];
+                next[word] = (moved << 1) | carry | first[word];
+                carry = moved >> 63;
+            }
+            for (int word = 0; word < W; word++) {
+                for (uint64_t jumps = state[word] & jump[word]; jumps; jumps &= jumps - 1) {
+                    const uint64_t * const targets = &follow[(word * 64 + __builtin_ctzll(jumps)) * W];
+                    for (int target = 0; target < W; target++) {
+                        next[target] |= targets[target];
+                    }
+                }
+            }
+
+            const uint64_t * const accept = classes[data[pos]];
+            uint64_t any = 0;
+            uint64_t match = 0;
+            for (int word = 0; word < W; word++) {
+                state[word] = next[word] & accept[word];
+                any |= state[word];
+                match |= state[word] & last[word];
+            }
+            active = any != 0;
+
+            if (match) {
+                found++;
+                if (regex_is_match) {
+                    break;
+                }
+            }
+        }
+        return found;
+    }
+};
+
+template <int W>
+static int shiftand_run(const Glushkov& g, TIME_TYPE start, const char * subject, size_t subject_len,
+                        const struct blocks * blocks, int repeat, struct result * res)
+{
+    TIME_TYPE end;
+    std::unique_ptr<ShiftAnd<W> > automaton(new ShiftAnd<W>);
+    uint64_t found = 0;
+
+    automaton->init(g);
+    GET_TIME(end);
+    double const pre_times = TIME_DIFF_IN_MS(start, end);
+
+    double * times = (double*) std::calloc(repeat, sizeof(double));
+    int const times_len = repeat;
+
+    do {
+        START_SCAN_TIME(start);
+        if (blocks) {
+            found = 0;
+            for (size_t iter = 0; iter < blocks->count; iter++) {
+                found += automaton->scan((const uint8_t *)blocks->data[iter], blocks->len[iter]);
+            }
+        } else {
+            found = automaton->scan((const uint8_t *)subject, subject_len);
+        }
+        STOP_SCAN_TIME(end);
+        times[repeat - 1] = TIME_DIFF_IN_MS(start, end);
+
+    } while (--repeat > 0);
+
+    res->matches = found;
+    get_mean_and_derivation(pre_times, times, times_len, res);
+
+    free(times);
+
+    return 0;
+}
+
+static int shiftand_find_all_common(const char* pattern, const char* subject, size_t subject_len,
+                                    const struct blocks * blocks, int repeat, struct result * res)
+{
+    TIME_TYPE start;
+    Glushkov g;
+    std::string error;
+
+    GET_TIME(start);
+    if (!compile(pattern, &g, &error)) {
+        fprintf(stderr, "ERROR: shiftand cannot compile '%s': %s\n", pattern, error.c_str());
+        return -1;
+    }
+
+    size_t const positions = g.classes.size();
+    if (positions <= 64) {
+        return shiftand_run<1>(g, start, subject, subject_len, blocks, repeat, res);
+    } else if (positions <= 128) {
+        return shiftand_run<2>(g, start, subject, subject_len, blocks, repeat, res);
+    } else if (positions <= 256) {
+        return shiftand_run<4>(g, start, subject, subject_len, blocks, repeat, res);
+    }
+    return shiftand_run<8>(g, start, subject, subject_len, blocks, repeat, res);
+}
+
+}  // namespace
+
+extern "C" int shiftand_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res)
+{
+    return shiftand_find_all_common(pattern, subject, subject_len, NULL, repeat, res);
+}
+
+extern "C" int shiftand_find_all_blocks(const char* pattern, const struct blocks * blocks, int repeat, struct result * res)
+{
+    return shiftand_find_all_common(pattern, NULL, 0, blocks, repeat, res);
+}
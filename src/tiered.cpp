@@ -0,0 +1,295 @@
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include "hyperscan.hpp"
+#include "tiered.hpp"
+#include "util.hpp"
+#include <hs/hs.h>
+
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include <pcre2.h>
+
+/* the timeline gets a sample at every tier change and at most every few ms otherwise */
+#define TIERED_SAMPLE_MS    5.0
+
+namespace {
+
+/* the rules accepted by the database are no longer scanned by PCRE2 */
+struct HsTier {
+    hs_database_t * database = nullptr;
+    hs_scratch_t * scratch = nullptr;
+    std::vector<bool> covered;
+
+    ~HsTier()
+    {
+        hs_free_scratch(scratch);
+        hs_free_database(database);
+    }
+};
+
+struct Shared {
+    const std::vector<std::string> * rules;
+    const std::vector<pcre2_code *> * interp;
+    Clock::time_point start;
+    bool chunked = false;           /* blocks above 4 GB need a stream mode database */
+    std::unique_ptr<std::atomic<pcre2_code *>[]> jit;
+    std::vector<double> jit_time;   /* written by the JIT thread */
+    double hs_time = -1;            /* written by the Hyperscan thread before it publishes the database */
+    std::atomic<HsTier *> hs{nullptr};
+    std::atomic<bool> stop{false};
+};
+
+/* the scanning thread keeps using the interpreter code, a copy gets the JIT code */
+static void jitTier(Shared * shared)
+{
+    const std::vector<pcre2_code *>& interp = *shared->interp;
+
+    for (size_t iter = 0; iter < interp.size() && !shared->stop; iter++) {
+        HsTier * const hs = shared->hs.load(std::memory_order_acquire);
+        if (!interp[iter] || (hs && hs->covered[iter])) {
+            continue;
+        }
+
+        pcre2_code * code = pcre2_code_copy(interp[iter]);
+        if (!code || pcre2_jit_compile(code, PCRE2_JIT_COMPLETE) != 0) {
+            pcre2_code_free(code);
+            continue;
+        }
+        shared->jit_time[iter] = since(shared->start);
+        shared->jit[iter].store(code, std::memory_order_release);
+    }
+}
+
+static void hsTier(Shared * shared)
+{
+    const std::vector<std::string>& rules = *shared->rules;
+    unsigned const flags = HS_FLAG_DOTALL | HS_FLAG_MULTILINE | HS_FLAG_SOM_LEFTMOST | hs_option_flags();
+    std::unique_ptr<HsTier> hs(new HsTier);
+    std::vector<const char *> patterns;
+    std::vector<unsigned> all_flags;
+    std::vector<unsigned> ids;
+
+    for (size_t iter = 0; iter < rules.size() && !shared->stop; iter++) {
+        hs_expr_info_t * info = NULL;
+        hs_compile_error_t * compile_err = NULL;
+
+        if (hs_expression_info(rules[iter].c_str(), flags, &info, &compile_err) != HS_SUCCESS) {
+            hs_free_compile_error(compile_err);
+            continue;
+        }
+        free(info);
+        patterns.push_back(rules[iter].c_str());
+        all_flags.push_back(flags);
+        ids.push_back(iter);
+    }
+
+    /* the expression info misses late errors, a rejected rule is dropped and the others compiled again */
+    while (!patterns.empty() && !shared->stop) {
+        hs_compile_error_t * compile_err = NULL;
+
+        unsigned const mode = shared->chunked ? (HS_MODE_STREAM | HS_MODE_SOM_HORIZON_LARGE) : HS_MODE_BLOCK;
+        if (hs_compile_multi(patterns.data(), all_flags.data(), ids.data(), patterns.size(), mode,
+                             NULL, &hs->database, &compile_err) == HS_SUCCESS) {
+            break;
+        }
+        int const failed = compile_err ? compile_err->expression : -1;
+        hs_free_compile_error(compile_err);
+        hs->database = nullptr;
+        if (failed < 0 || (size_t)failed >= patterns.size()) {
+            return;
+        }
+        patterns.erase(patterns.begin() + failed);
+        all_flags.erase(all_flags.begin() + failed);
+        ids.erase(ids.begin() + failed);
+    }
+
+    if (!hs->database || hs_alloc_scratch(hs->database, &hs->scratch) != HS_SUCCESS) {
+        return;
+    }
+    hs->covered.assign(rules.size(), false);
+    for (unsigned id : ids) {
+        hs->covered[id] = true;
+    }
+
+    shared->hs_time = since(shared->start);
+    shared->hs.store(hs.release(), std::memory_order_release);
+}
+
+static int onMatch(UNUSED unsigned int id, UNUSED unsigned long long from, UNUSED unsigned long long to,
+                   UNUSED unsigned int flags, void * ctx)
+{
+    (*static_cast<uint64_t *>(ctx))++;
+    return 0;
+}
+
+/* counts the non-overlapping matches of a rule in one block */
+static uint64_t pcre2_count(pcre2_code * re, bool jit, const char * data, size_t len,
+                            pcre2_match_data * match_data, pcre2_match_context * match_ctx)
+{
+    PCRE2_SIZE * ovector = pcre2_get_ovector_pointer(match_data);
+    size_t start = 0;
+    uint64_t found = 0;
+
+    while (start <= len) {
+        int const rc = jit ? pcre2_jit_match(re, (PCRE2_SPTR8)data, len, start, 0, match_data, match_ctx)
+                           : pcre2_match(re, (PCRE2_SPTR8)data, len, start, 0, match_data, match_ctx);
+        if (rc < 0) {
+            break;
+        }
+        found++;
+        start = (ovector[1] > ovector[0]) ? ovector[1] : ovector[1] + 1;
+    }
+    return found;
+}
+
+}  // namespace
+
+const char * tier_name(Tier tier)
+{
+    switch (tier) {
+        case TIER_INTERP:   return "interp";
+        case TIER_JIT:      return "jit";
+        case TIER_HS:       return "hyperscan";
+        default:            return "none";
+    }
+}
+
+bool tiered_scan(const std::vector<std::string>& rules, const struct blocks * blocks, int passes, TieredResult * result)
+{
+    size_t const rule_num = rules.size();
+    std::vector<pcre2_code *> interp(rule_num, nullptr);
+    Shared shared;
+    bool ok = true;
+
+    *result = TieredResult();
+    for (size_t iter = 0; iter < blocks->count; iter++) {
+        shared.chunked |= blocks->len[iter] > HS_MAX_SCAN_LEN;
+    }
+
+    shared.rules = &rules;
+    shared.interp = &interp;
+    shared.jit.reset(new std::atomic<pcre2_code *>[rule_num]);
+    shared.jit_time.assign(rule_num, -1);
+    for (size_t iter = 0; iter < rule_num; iter++) {
+        shared.jit[iter].store(nullptr);
+    }
+
+    shared.start = Clock::now();
+    for (size_t iter = 0; iter < rule_num; iter++) {
+        int err_code;
+        PCRE2_SIZE err_offset;
+
+        interp[iter] = pcre2_compile((PCRE2_SPTR8)rules[iter].c_str(), PCRE2_ZERO_TERMINATED, pcre2_option_flags(),
+                                     &err_code, &err_offset, NULL);
+    }
+
+    pcre2_match_data * match_data = pcre2_match_data_create(1, NULL);
+    pcre2_match_context * match_ctx = pcre2_match_context_create(NULL);
+    pcre2_jit_stack * stack = pcre2_jit_stack_create(32 * 1024, 512 * 1024, NULL);
+    if (!match_data || !match_ctx || !stack) {
+        fprintf(stderr, "ERROR: Unable to allocate PCRE2 match data.\n");
+        ok = false;
+    } else {
+        pcre2_jit_stack_assign(match_ctx, NULL, stack);
+        result->first_scan = since(shared.start);
+    }
+
+    std::thread jit_thread(jitTier, &shared);
+    std::thread hs_thread(hsTier, &shared);
+
+    TieredSample last = {-TIERED_SAMPLE_MS, 0, 0, {}};
+
+    for (int pass = 0; pass < passes && ok; pass++) {
+        for (size_t block = 0; block < blocks->count && ok; block++) {
+            const char * data = blocks->data[block];
+            size_t const len = blocks->len[block];
+            HsTier * const hs = shared.hs.load(std::memory_order_acquire);
+            TieredSample sample = {};
+            uint64_t found = 0;
+
+            hs_error_t const err = !hs ? HS_SUCCESS
+                                 : shared.chunked ? hs_scan_chunked(hs->database, data, len, hs->scratch, onMatch, &found)
+                                 : hs_scan(hs->database, data, len, 0, hs->scratch, onMatch, &found);
+            if (err != HS_SUCCESS) {
+                fprintf(stderr, "ERROR: Unable to scan input buffer.\n");
+                ok = false;
+                break;
+            }
+
+            for (size_t iter = 0; iter < rule_num; iter++) {
+                pcre2_code * const jit = shared.jit[iter].load(std::memory_order_acquire);
+
+                if (hs && hs->covered[iter]) {
+                    sample.rules[TIER_HS]++;
+                } else if (jit) {
+                    found += pcre2_count(jit, true, data, len, match_data, match_ctx);
+                    sample.rules[TIER_JIT]++;
+                } else if (interp[iter]) {
+                    found += pcre2_count(interp[iter], false, data, len, match_data, match_ctx);
+                    sample.rules[TIER_INTERP]++;
+                } else {
+                    sample.rules[TIER_NONE]++;
+                }
+            }
+
+            result->bytes += len;
+            result->matches += found;
+            sample.time = since(shared.start);
+            sample.bytes = result->bytes;
+            sample.matches = result->matches;
+            if (found > 0 && result->first_match < 0) {
+                result->first_match = sample.time;
+            }
+
+            bool const changed = sample.rules[TIER_JIT] != last.rules[TIER_JIT] || sample.rules[TIER_HS] != last.rules[TIER_HS];
+            if (changed || sample.time - last.time >= TIERED_SAMPLE_MS) {
+                result->timeline.push_back(sample);
+                last = sample;
+            }
+        }
+    }
+    result->total = since(shared.start);
+    if (!result->timeline.empty() && result->timeline.back().bytes != result->bytes) {
+        TieredSample sample = last;
+        sample.time = result->total;
+        sample.bytes = result->bytes;
+        sample.matches = result->matches;
+        result->timeline.push_back(sample);
+    }
+
+    /* tiers that are not ready at the end of the scan are abandoned */
+    shared.stop = true;
+    jit_thread.join();
+    hs_thread.join();
+
+    HsTier * const hs = shared.hs.load();
+    result->hs_ready = hs ? shared.hs_time : -1;
+    result->final_tier.assign(rule_num, TIER_NONE);
+    result->final_time.assign(rule_num, -1);
+    for (size_t iter = 0; iter < rule_num; iter++) {
+        if (hs && hs->covered[iter]) {
+            result->final_tier[iter] = TIER_HS;
+            result->final_time[iter] = shared.hs_time;
+        } else if (shared.jit[iter].load()) {
+            result->final_tier[iter] = TIER_JIT;
+            result->final_time[iter] = shared.jit_time[iter];
+        } else if (interp[iter]) {
+            result->final_tier[iter] = TIER_INTERP;
+            result->final_time[iter] = result->first_scan;
+        }
+    }
+
+    delete hs;
+    for (size_t iter = 0; iter < rule_num; iter++) {
+        pcre2_code_free(shared.jit[iter].load());
+        pcre2_code_free(interp[iter]);
+    }
+    pcre2_jit_stack_free(stack);
+    pcre2_match_context_free(match_ctx);
+    pcre2_match_data_free(match_data);
+
+    return ok;
+}
@@ -0,0 +1,51 @@
+#ifndef TIERED_HPP
+#define TIERED_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "main.h"
+
+/*
+ * Tiered compilation of a rule set: scanning starts as soon as every rule is
+ * compiled for the PCRE2 interpreter. Background threads JIT compile copies of
+ * the rules and build one Hyperscan database of the rules it supports, each
+ * result is swapped in atomically between two blocks of the input. A rule ends
+ * at the Hyperscan tier if the database accepts it, at the JIT tier otherwise.
+ * Hyperscan reports every end of a match, the match counts of a rule change
+ * when it moves to the database.
+ */
+enum Tier {
+    TIER_NONE,      /* not compiled by any tier */
+    TIER_INTERP,    /* PCRE2 interpreter */
+    TIER_JIT,       /* PCRE2-JIT */
+    TIER_HS,        /* multi-pattern Hyperscan database */
+};
+
+struct TieredSample {
+    double time;            /* ms since the start */
+    uint64_t bytes;         /* scanned so far */
+    uint64_t matches;       /* found so far */
+    size_t rules[TIER_HS + 1];  /* rules per tier */
+};
+
+struct TieredResult {
+    double first_scan = -1;     /* ms until the interpreter tier was ready */
+    double first_match = -1;    /* ms until the first match, negative without match */
+    double hs_ready = -1;       /* ms until the database was swapped in, negative if it was not built */
+    double total = 0;
+    uint64_t bytes = 0;
+    uint64_t matches = 0;
+    std::vector<TieredSample> timeline;
+    std::vector<Tier> final_tier;       /* per rule */
+    std::vector<double> final_time;     /* ms until the rule reached its final tier */
+};
+
+/* the blocks are scanned passes times back-to-back, times are wall clock */
+bool tiered_scan(const std::vector<std::string>& rules, const struct blocks * blocks, int passes, TieredResult * result);
+
+const char * tier_name(Tier tier);
+
+#endif // TIERED_HPP
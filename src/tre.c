@@ -4,15 +4,15 @@
 
 #include <tre/tre.h>
 
-int tre_find_all(char* pattern, char* subject, int subject_len, int repeat, struct result * res)
+int tre_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result * res)
 {
 	int err_val;
 	regex_t regex;
 	regmatch_t match[1];
-	char *ptr;
-	int len;
+	const char *ptr;
+	size_t len;
 	TIME_TYPE start, end;
-	int found = 0;
+	uint64_t found = 0;
 
     double pre_times = 0;
 	GET_TIME(start);
@@ -33,7 +33,7 @@ int tre_find_all(char* pattern, char* subject, int subject_len, int repeat, stru
 		found = 0;
 		ptr = subject;
 		len = subject_len;
-		GET_TIME(start);
+		START_SCAN_TIME(start);
 		while (1) {
 			err_val = tre_regnexec(&regex, ptr, len, 1, match, 0);
 			if (err_val != 0)
@@ -44,7 +44,7 @@ int tre_find_all(char* pattern, char* subject, int subject_len, int repeat, stru
 			ptr += match[0].rm_eo;
 			len -= match[0].rm_eo;
 		}
-		GET_TIME(end);
+		STOP_SCAN_TIME(end);
 
         times[repeat - 1] = TIME_DIFF_IN_MS(start, end);
 	} while (--repeat > 0);
@@ -0,0 +1,31 @@
+#include "util.hpp"
+
+double since(const Clock::time_point& start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+bool parse_options(const char * spec, const std::function<bool(const std::string& key, const std::string& value)>& option)
+{
+    std::string options(spec);
+    size_t start = 0;
+
+    while (start < options.size()) {
+        size_t end = options.find(',', start);
+        if (end == std::string::npos) {
+            end = options.size();
+        }
+
+        size_t const eq = options.find('=', start);
+        bool const has_value = eq < end;
+        std::string const key = options.substr(start, (has_value ? eq : end) - start);
+        std::string const value = has_value ? options.substr(eq + 1, end - eq - 1) : "";
+
+        if (!option(key, value)) {
+            return false;
+        }
+        start = end + 1;
+    }
+
+    return true;
+}
@@ -0,0 +1,21 @@
+#ifndef UTIL_HPP
+#define UTIL_HPP
+
+#include <chrono>
+#include <functional>
+#include <string>
+
+/* wall clock, clock() would add the cpu time of the other threads of a measurement */
+typedef std::chrono::steady_clock Clock;
+
+/* wall clock time since start in ms */
+double since(const Clock::time_point& start);
+
+/*
+ * Splits an option string such as "threads=4,seed=1" at the commas and calls
+ * option() with the key and value of each, the value is empty without '='.
+ * Stops and returns false as soon as option() returns false.
+ */
+bool parse_options(const char * spec, const std::function<bool(const std::string& key, const std::string& value)>& option);
+
+#endif // UTIL_HPP
@@ -1,9 +1,21 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <yara.h>
 
 #include "main.h"
 
+#define YARA_PATH_LEN 4096
+
+static const char * yara_cache_dir = "/tmp";
+
+
+/* matches of one scan, capped is set when a string hit YARA's limit of matches per string */
+struct scan_count
+{
+  uint64_t matches;
+  int capped;
+};
 
 static int capture_matches(
     YR_SCAN_CONTEXT* context,
@@ -11,6 +23,15 @@ static int capture_matches(
     void* message_data,
     void* user_data)
 {
+  struct scan_count* count = (struct scan_count*) user_data;
+
+  /* --is-match: the first matching rule ends the scan of the input */
+  if (message == CALLBACK_MSG_RULE_MATCHING && regex_is_match)
+  {
+    count->matches++;
+    return CALLBACK_ABORT;
+  }
+
   if (message == CALLBACK_MSG_RULE_MATCHING)
   {
     YR_RULE* rule = (YR_RULE*) message_data;
@@ -21,97 +42,346 @@ static int capture_matches(
       YR_MATCH* match;
 
       yr_string_matches_foreach(context, string, match)
-          (*(int*) user_data)++;
+          count->matches++;
     }
   }
 
-  return 0;
+  /* YARA keeps scanning, but stops recording the matches of the string */
+  if (message == CALLBACK_MSG_TOO_MANY_MATCHES)
+    count->capped = 1;
+
+  return CALLBACK_CONTINUE;
 }
 
-char * return_rule_file(char* pattern)
-{
-  if (strcmp(pattern, "Twain") == 0)
-    return "../src/yara/ruleset/twain.yar";
-  else if (strcmp(pattern, "(?i)Twain") == 0)
-    return "../src/yara/ruleset/twain_i.yar";
-  else if (strcmp(pattern, "[a-z]shing") == 0)
-    return "../src/yara/ruleset/shing.yar";
-  else if (strcmp(pattern, "Huck[a-zA-Z]+|Saw[a-zA-Z]+") == 0)
-    return "../src/yara/ruleset/huck.yar";
-  else if (strcmp(pattern, "\\b\\w+nn\\b") == 0)
-    return "../src/yara/ruleset/word.yar";
-  else if (strcmp(pattern, "[a-q][^u-z]{13}x") == 0)
-    return "../src/yara/ruleset/aax.yar";
-  else if (strcmp(pattern, "Tom|Sawyer|Huckleberry|Finn") == 0)
-    return "../src/yara/ruleset/tom.yar";
-  else if (strcmp(pattern, "(?i)Tom|Sawyer|Huckleberry|Finn") == 0)
-    return "../src/yara/ruleset/tom_i.yar";
-  else if (strcmp(pattern, ".{0,2}(Tom|Sawyer|Huckleberry|Finn)") == 0)
-    return "../src/yara/ruleset/tom2.yar";
-  else if (strcmp(pattern, ".{2,4}(Tom|Sawyer|Huckleberry|Finn)") == 0)
-    return "../src/yara/ruleset/tom4.yar";
-  else if (strcmp(pattern, "Tom.{10,25}river|river.{10,25}Tom") == 0)
-    return "../src/yara/ruleset/tom10.yar";
-  else if (strcmp(pattern, "[a-zA-Z]+ing") == 0)
-    return "../src/yara/ruleset/ing+.yar";
-  else if (strcmp(pattern, "\\s[a-zA-Z]{0,12}ing\\s") == 0)
-    return "../src/yara/ruleset/ing.yar";
-  else if (strcmp(pattern, "([A-Za-z]awyer|[A-Za-z]inn)\\s") == 0)
-    return "../src/yara/ruleset/inn.yar";
-  else if (strcmp(pattern, "[\"'][^\"']{0,30}[?!\\.][\"']") == 0)
-    return "../src/yara/ruleset/mix.yar";
-  else if (strcmp(pattern, "\u221E|\u2713") == 0)
-    return "../src/yara/ruleset/inf.yar";
-  else
-    return "";
+static void report_error(
+    int error_level,
+    const char* file_name,
+    int line_number,
+    const YR_RULE* rule,
+    const char* message,
+    void* user_data)
+{
+  (void) file_name;
+  (void) line_number;
+  (void) rule;
+
+  /* warnings like "string slows down scanning" are expected for regex rules */
+  if (error_level == YARA_ERROR_LEVEL_ERROR && *(int*) user_data)
+    fprintf(stderr, "ERROR: YARA: %s\n", message);
 }
 
-int yara_find_all(char* pattern, char* subject, int subject_len, int repeat, struct result* res)
+/*
+ * Appends one rule per pattern: "rule r<id> { strings: $re = /<pattern>/ condition: $re }".
+ * A leading "(?i)" or --caseless native becomes the nocase modifier, unescaped
+ * slashes are escaped.
+ * Returns the new length of the source or 0 if out of memory.
+ */
+static size_t append_rule(char** source, size_t len, int id, const char* pattern)
+{
+  int nocase = regex_caseless == CASE_NATIVE;
+  size_t pattern_len;
+  char* out;
+
+  if (strncmp(pattern, "(?i)", 4) == 0)
+  {
+    nocase = 1;
+    pattern += 4;
+  }
+
+  pattern_len = strlen(pattern);
+  /* worst case every character is an escaped slash */
+  out = realloc(*source, len + 2 * pattern_len + 96);
+  if (out == NULL)
+    return 0;
+  *source = out;
+
+  len += sprintf(out + len, "rule r%d\n{\n  strings:\n    $re = /", id);
+
+  for (const char* p = pattern; *p; p++)
+  {
+    if (*p == '\\' && p[1] != '\0')
+    {
+      out[len++] = *p++;
+      out[len++] = *p;
+    }
+    else if (*p == '/')
+    {
+      out[len++] = '\\';
+      out[len++] = '/';
+    }
+    else
+    {
+      out[len++] = *p;
+    }
+  }
+
+  len += sprintf(out + len, "/%s\n  condition:\n    $re\n}\n", nocase ? " nocase" : "");
+  return len;
+}
+
+static char* rule_source(const char** pattern, int pattern_num)
+{
+  char* source = NULL;
+  size_t len = 0;
+
+  for (int iter = 0; iter < pattern_num; iter++)
+  {
+    len = append_rule(&source, len, iter, pattern[iter]);
+    if (len == 0)
+    {
+      free(source);
+      return NULL;
+    }
+  }
+
+  return source;
+}
+
+/* the rules are compiled from a generated source, verbose prints the compiler errors */
+static YR_RULES* compile_rules(const char** pattern, int pattern_num, int verbose)
 {
-  TIME_TYPE start, end = 0;
   YR_COMPILER* compiler = NULL;
   YR_RULES* rules = NULL;
-  int counter = 0;
+  char* source = rule_source(pattern, pattern_num);
+
+  if (source == NULL || yr_compiler_create(&compiler) != ERROR_SUCCESS)
+  {
+    free(source);
+    return NULL;
+  }
+
+  yr_compiler_set_callback(compiler, report_error, &verbose);
+
+  if (yr_compiler_add_string(compiler, source, NULL) != 0 ||
+      yr_compiler_get_rules(compiler, &rules) != ERROR_SUCCESS)
+  {
+    rules = NULL;
+  }
+
+  yr_compiler_destroy(compiler);
+  free(source);
+
+  return rules;
+}
 
-  char * rule_file = return_rule_file(pattern);
+static void cache_path(const char** pattern, int pattern_num, char* path, size_t path_len)
+{
+  uint64_t hash = 0xcbf29ce484222325ULL;
 
-  if (strlen(rule_file) == 0)
+  for (int iter = 0; iter < pattern_num; iter++)
   {
-    res->time = 1000000;
-    res->time_sd = 0;
-    res->matches = 0;
+    /* the terminating zero separates the patterns */
+    for (const char* p = pattern[iter]; ; p++)
+    {
+      hash = (hash ^ (unsigned char) *p) * 0x100000001b3ULL;
+      if (*p == '\0')
+        break;
+    }
+  }
+
+  hash = (hash ^ (uint64_t) regex_caseless) * 0x100000001b3ULL;
+
+  snprintf(path, path_len, "%s/yara-%016" PRIx64 ".yarc", yara_cache_dir, hash);
+}
+
+/* returns ERROR_SUCCESS or the first error of yr_rules_scan_mem() */
+static int scan_rules(YR_RULES* rules, const char* subject, size_t subject_len, const struct blocks* blocks,
+                      struct scan_count* count)
+{
+  /* fast mode stops searching a string after its first match */
+  int const flags = regex_is_match ? SCAN_FLAGS_FAST_MODE : 0;
+  int err = ERROR_SUCCESS;
+
+  count->matches = 0;
+  count->capped = 0;
+
+  if (blocks)
+  {
+    for (size_t iter = 0; iter < blocks->count && err == ERROR_SUCCESS; iter++)
+      err = yr_rules_scan_mem(rules, (const uint8_t*) blocks->data[iter], blocks->len[iter], flags, capture_matches, count, 0);
   }
   else
   {
-    FILE* fh = fopen(rule_file, "r");
+    err = yr_rules_scan_mem(rules, (const uint8_t*) subject, subject_len, flags, capture_matches, count, 0);
+  }
 
-    yr_initialize();
-    yr_compiler_create(&compiler);
-    yr_compiler_add_file(compiler, fh, NULL, NULL);
-    yr_compiler_get_rules(compiler, &rules);
+  return err;
+}
 
-    double * times = calloc(repeat, sizeof(double));
-    int const times_len = repeat;
-    do
-    {
-        counter = 0;
-        GET_TIME(start);
-        yr_rules_scan_mem(rules, (const uint8_t*) subject, subject_len, 0, capture_matches, &counter, 0);
-        GET_TIME(end);
-        times[repeat - 1] = TIME_DIFF_IN_MS(start, end);
+static int scan_all(YR_RULES* rules, double pre_times, const char* subject, size_t subject_len,
+                    const struct blocks* blocks, int repeat, struct result* res)
+{
+  TIME_TYPE start, end = 0;
+  struct scan_count count = {0};
+  int err;
+
+  double * times = calloc(repeat, sizeof(double));
+  int const times_len = repeat;
+  do
+  {
+      START_SCAN_TIME(start);
+      err = scan_rules(rules, subject, subject_len, blocks, &count);
+      STOP_SCAN_TIME(end);
+      times[repeat - 1] = TIME_DIFF_IN_MS(start, end);
+
+      if (err != ERROR_SUCCESS)
+      {
+        fprintf(stderr, "ERROR: YARA scan failed with error %d\n", err);
+        free(times);
+        return -1;
+      }
+
+  } while (--repeat > 0);
 
-    } while (--repeat > 0);
+  if (count.capped)
+    fprintf(stdout, "WARNING: a YARA string reached the max string matches limit, its matches are not all counted\n");
+
+  res->matches = count.matches;
+  get_mean_and_derivation(pre_times, times, times_len, res);
+
+  free(times);
+  return 0;
+}
 
+void yara_set_cache_dir(const char* dir)
+{
+  yara_cache_dir = dir;
+}
+
+bool yara_verify_regex(const char* pattern)
+{
+  YR_RULES* rules;
+
+  yr_initialize();
+  rules = compile_rules(&pattern, 1, 0);
+  if (rules)
     yr_rules_destroy(rules);
-    yr_compiler_destroy(compiler);
-    fclose(fh);
+  yr_finalize();
+
+  return rules != NULL;
+}
 
-    res->matches = counter;
-    get_mean_and_derivation(times, times_len, res);
+static int yara_find_all_common(const char* pattern, const char* subject, size_t subject_len,
+                                const struct blocks* blocks, int repeat, struct result* res)
+{
+  TIME_TYPE start, end = 0;
+  YR_RULES* rules = NULL;
+  int ret;
+
+  yr_initialize();
+
+  GET_TIME(start);
+  rules = compile_rules(&pattern, 1, 1);
+  GET_TIME(end);
 
-    free(times);
+  if (rules == NULL)
+  {
+    fprintf(stderr, "ERROR: Unable to compile pattern \"%s\"\n", pattern);
     yr_finalize();
+    return -1;
   }
 
-  return 0;
+  ret = scan_all(rules, TIME_DIFF_IN_MS(start, end), subject, subject_len, blocks, repeat, res);
+
+  yr_rules_destroy(rules);
+  yr_finalize();
+
+  return ret;
+}
+
+int yara_find_all(const char* pattern, const char* subject, size_t subject_len, int repeat, struct result* res)
+{
+  return yara_find_all_common(pattern, subject, subject_len, NULL, repeat, res);
+}
+
+int yara_find_all_blocks(const char* pattern, const struct blocks* blocks, int repeat, struct result* res)
+{
+  return yara_find_all_common(pattern, NULL, 0, blocks, repeat, res);
+}
+
+/*
+ * All rules in one ruleset, scanned by YARA's Aho-Corasick atom matcher. The
+ * compiled rules are kept in the cache directory: a missing or unusable file
+ * is compiled and saved first, so pre_time is the yr_rules_load() time only.
+ */
+static int yara_multi_common(const char** pattern, int pattern_num, const char* subject, size_t subject_len,
+                             const struct blocks* blocks, int repeat, struct result* res, struct build_stats* stats)
+{
+  TIME_TYPE start, end = 0;
+  YR_RULES* rules = NULL;
+  char path[YARA_PATH_LEN];
+  int ret;
+
+  *stats = (struct build_stats){};
+  cache_path(pattern, pattern_num, path, sizeof(path));
+
+  yr_initialize();
+
+  GET_TIME(start);
+  int loaded = yr_rules_load(path, &rules) == ERROR_SUCCESS;
+  GET_TIME(end);
+
+  if (!loaded)
+  {
+    GET_TIME(start);
+    rules = compile_rules(pattern, pattern_num, 1);
+    GET_TIME(end);
+
+    if (rules == NULL)
+    {
+      fprintf(stderr, "ERROR: Unable to compile patterns\n");
+      yr_finalize();
+      return -1;
+    }
+    stats->build_time = TIME_DIFF_IN_MS(start, end);
+
+    int saved = yr_rules_save(rules, path) == ERROR_SUCCESS;
+    yr_rules_destroy(rules);
+    rules = NULL;
+    if (!saved)
+    {
+      fprintf(stderr, "ERROR: Unable to write YARA rules '%s'\n", path);
+      yr_finalize();
+      return -1;
+    }
+
+    GET_TIME(start);
+    loaded = yr_rules_load(path, &rules) == ERROR_SUCCESS;
+    GET_TIME(end);
+
+    if (!loaded)
+    {
+      fprintf(stderr, "ERROR: Unable to load YARA rules '%s'\n", path);
+      yr_finalize();
+      return -1;
+    }
+  }
+  stats->load_time = TIME_DIFF_IN_MS(start, end);
+
+  FILE* fh = fopen(path, "rb");
+  if (fh)
+  {
+    fseek(fh, 0, SEEK_END);
+    stats->size = ftell(fh);
+    fclose(fh);
+  }
+
+  ret = scan_all(rules, stats->load_time, subject, subject_len, blocks, repeat, res);
+
+  yr_rules_destroy(rules);
+  yr_finalize();
+
+  return ret;
+}
+
+int yara_multi_find_all(const char** pattern, int pattern_num, const char* subject, size_t subject_len,
+                        int repeat, struct result* res, struct build_stats* stats)
+{
+  return yara_multi_common(pattern, pattern_num, subject, subject_len, NULL, repeat, res, stats);
+}
+
+int yara_multi_find_all_blocks(const char** pattern, int pattern_num, const struct blocks* blocks,
+                               int repeat, struct result* res, struct build_stats* stats)
+{
+  return yara_multi_common(pattern, pattern_num, NULL, 0, blocks, repeat, res, stats);
 }